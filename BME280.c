@@ -0,0 +1,251 @@
+#include <stdint.h>
+
+#include "BME280.h"
+#include "spi.h"
+
+/* SPI transactions: bytes written with CSB low, then a burst read into the device buffers. Register writes
+use the address with bit 7 cleared (0x72 is ctrl_hum 0xF2), reads the address with bit 7 set. */
+static const unsigned char THidTx[] = {0xD0}; //Chip ID address
+static const unsigned char THcompTx[] = {0x88}; //First temperature/pressure compensation byte
+static const unsigned char THhumTx[] = {0xE1}; //First of the remaining humidity compensation bytes
+static const unsigned char THsampleTx[] = {0xF7}; //First data byte, pressure MSB
+
+/* Named acquisition profiles, all in normal mode so the sensor measures in the background and a poll is just
+the 8-byte burst read. Settings follow the data sheet's recommended modes of operation. */
+const BME280Profile BME280Weather = { //~1 sample/s, lowest current; no filter needed at this rate
+    BME280_OSRS_1X,
+    BME280_CTRL_MEAS(BME280_OSRS_1X, BME280_OSRS_1X),
+    BME280_CONFIG(BME280_STANDBY_1000MS, BME280_FILTER_OFF)
+};
+const BME280Profile BME280Indoor = { //~6 samples/s, heavy pressure oversampling and filtering for low noise
+    BME280_OSRS_1X,
+    BME280_CTRL_MEAS(BME280_OSRS_2X, BME280_OSRS_16X),
+    BME280_CONFIG(BME280_STANDBY_125MS, BME280_FILTER_16)
+};
+const BME280Profile BME280HighRate = { //~60 samples/s, filter instead of oversampling to keep noise down
+    BME280_OSRS_1X,
+    BME280_CTRL_MEAS(BME280_OSRS_1X, BME280_OSRS_4X),
+    BME280_CONFIG(BME280_STANDBY_0_5MS, BME280_FILTER_16)
+};
+
+static void THsubmit(SpiTransaction *transaction, unsigned char cs, const unsigned char *tx, unsigned char txLen,
+                     unsigned char *rx, unsigned char rxLen, SpiDoneFn done) {
+    transaction->cs = cs;
+    transaction->tx = tx;
+    transaction->txLen = txLen;
+    transaction->rx = rx;
+    transaction->rxLen = rxLen;
+    transaction->done = done;
+    spiSubmit(transaction);
+}
+
+uint8_t BME280Init(BME280 *dev, unsigned char cs, BME280Cal *cal, const BME280Profile *profile) // 0 if no sensor answers on cs
+    {
+     dev->cs = cs;
+     dev->cal = cal;
+     dev->t_fine = 0;
+     if (!ReadTHid(dev)) return 0;
+     if (cal->magic != BME280_CAL_MAGIC || cal->cs != cs) GetCompData(dev); //FRAM copy blank or for another sensor
+     BME280SetProfile(dev, profile);
+     return 1;
+    }
+
+void BME280SetProfile(BME280 *dev, const BME280Profile *profile)
+    {
+      /* Writes to config may be ignored in normal mode, so put the sensor to sleep first. ctrl_hum only takes
+      effect after a write to ctrl_meas, which also starts normal mode. Register writes use the address with
+      bit 7 cleared. */
+      dev->Tx[0] = 0x74; dev->Tx[1] = 0x00; //ctrl_meas: sleep
+      dev->Tx[2] = 0x75; dev->Tx[3] = profile->config;
+      dev->Tx[4] = 0x72; dev->Tx[5] = profile->ctrlHum;
+      dev->Tx[6] = 0x74; dev->Tx[7] = profile->ctrlMeas;
+      THsubmit(&dev->read, dev->cs, dev->Tx, sizeof dev->Tx, 0, 0, 0);
+      spiWait();
+    }
+
+uint8_t ReadTHid(BME280 *dev)  // Get the TH sensor chip ID: 0x60
+    {
+      THsubmit(&dev->read, dev->cs, THidTx, sizeof THidTx, dev->Data, 1, 0);
+      spiWait(); //Sleep in LPM0 until the byte is in
+      if (dev->Data[0] == BME280_ID) return 1;
+      return 0;
+    }
+
+void GetCompData(BME280 *dev)
+     {
+        /* Compensation data can be read in sleep mode. Use burst read
+        to get temp, pressure, and humidity compensation bytes starting at first data byte 0X88,
+        then the remaining humidity bytes starting at 0xE1. Both reads are queued together and
+        run back to back from the SPI interrupt. The result is written to the FRAM block. */
+        unsigned char *Tempbuf = dev->Data; //0x88 to 0xA1
+        unsigned char *Humbuf = dev->Humbuf; //0xE1 to 0xE8
+        BME280Cal *cal = dev->cal;
+
+        THsubmit(&dev->read, dev->cs, THcompTx, sizeof THcompTx, Tempbuf, sizeof dev->Data, 0);
+        THsubmit(&dev->humRead, dev->cs, THhumTx, sizeof THhumTx, Humbuf, sizeof dev->Humbuf, 0);
+        spiWait();
+
+        // Build the temperature compensation coefficients
+        cal->dig_T1 = ((uint16_t)(Tempbuf[1] << 8) | (uint16_t)Tempbuf[0]); //unsigned 16-bit int
+        cal->dig_T2 = (int16_t)((uint16_t)(Tempbuf[3] << 8) | (uint16_t)Tempbuf[2]); //signed 16-bit int
+        cal->dig_T3 = (int16_t)((uint16_t)(Tempbuf[5] << 8) | (uint16_t)Tempbuf[4]); //signed 16-bit int
+
+        // Build the pressure compensation coefficients
+        cal->dig_P1 = ((uint16_t)(Tempbuf[7] << 8) | (uint16_t)Tempbuf[6]); //unsigned 16-bit int
+        cal->dig_P2 = (int16_t)((uint16_t)(Tempbuf[9] << 8) | (uint16_t)Tempbuf[8]); //signed 16-bit int
+        cal->dig_P3 = (int16_t)((uint16_t)(Tempbuf[11] << 8) | (uint16_t)Tempbuf[10]); //signed 16-bit int
+        cal->dig_P4 = (int16_t)((uint16_t)(Tempbuf[13] << 8) | (uint16_t)Tempbuf[12]); //signed 16-bit int
+        cal->dig_P5 = (int16_t)((uint16_t)(Tempbuf[15] << 8) | (uint16_t)Tempbuf[14]); //signed 16-bit int
+        cal->dig_P6 = (int16_t)((uint16_t)(Tempbuf[17] << 8) | (uint16_t)Tempbuf[16]); //signed 16-bit int
+        cal->dig_P7 = (int16_t)((uint16_t)(Tempbuf[19] << 8) | (uint16_t)Tempbuf[18]); //signed 16-bit int
+        cal->dig_P8 = (int16_t)((uint16_t)(Tempbuf[21] << 8) | (uint16_t)Tempbuf[20]); //signed 16-bit int
+        cal->dig_P9 = (int16_t)((uint16_t)(Tempbuf[23] << 8) | (uint16_t)Tempbuf[22]); //signed 16-bit int
+
+         // Build the humidity compensation coefficients
+         cal->dig_H1 = (uint8_t)Tempbuf[25]; //0xA1
+         cal->dig_H2 = (int16_t)((uint16_t)(Humbuf[1] << 8) | (uint16_t)Humbuf[0]); //  0xE2/0xE1
+         cal->dig_H3 = (uint8_t)Humbuf[2];  //0xE3
+         //dig_H4 and dig_H5 use the lower and upper nibbles of 0xE5, respectively. Split up Humbuf[4] for this purpose
+         cal->dig_H4 = (int16_t)((uint16_t)(Humbuf[3] << 4) | (uint16_t)(Humbuf[4] & 0x0F)); //0xE4 / low nibble of 0xE5 (12 bits)
+         cal->dig_H5 = (int16_t)((uint16_t)(Humbuf[5] << 4) | (uint16_t)((Humbuf[4] >>4) & 0x0F)); //0xE6 / high nibble of 0xE5 (12 bits)
+         cal->dig_H6 = (int8_t)Humbuf[6]; //0xE7
+
+         cal->cs = dev->cs;
+         cal->magic = BME280_CAL_MAGIC; //Written last, a reset halfway leaves the block marked blank
+     }
+
+static void THsampleDone(SpiTransaction *transaction)
+   {
+    /*
+    Data[0]: Pressure  MSB
+    Data[1]: Pressure LSB
+    Data[2]: Pressure XLSB
+    Data[3]: Temperature  MSB
+    Data[4]: Temperature LSB
+    Data[5]: Temperature XLSB
+    Data[6]: Humidity MSB
+    Data[7]: Humidity LSB
+
+    Assemble the data bytes to make a 20-bit long integer for pressure and temperature and a 16-bit integer for humidity */
+    BME280 *dev = (BME280 *)transaction; //read is the first member of the handle
+    unsigned char *Data = dev->Data;
+
+    dev->RawPress = ((uint32_t)Data[0] << 16 | (uint32_t)Data[1] << 8 | Data[2]) >> 4; //20-bit long unsigned integer
+    dev->RawTemp = ((uint32_t)Data[3] << 16 | (uint32_t)Data[4] << 8 | Data[5]) >> 4; //20-bit long unsigned integer
+    dev->RawHumid = ((uint32_t)Data[6] << 8) | (uint32_t)Data[7]; //16-bit unsigned integer
+   }
+
+void ReadTHsensorStart(BME280 *dev)
+   {
+    /* The sensor is measuring in normal mode with the settings of its profile, so just do the
+    recommended burst mode read of 8 data registers by sending address of first byte 0XF7. The data
+    registers are shadowed during the burst, so a measurement finishing meanwhile cannot mix samples.
+    Returns right away; the raw readings are set from the SPI interrupt once spiBusy() is 0. */
+
+    THsubmit(&dev->read, dev->cs, THsampleTx, sizeof THsampleTx, dev->Data, 8, THsampleDone);
+   }
+
+void ReadTHsensor(BME280 *dev)
+   {
+    ReadTHsensorStart(dev);
+    spiWait(); //Sleep in LPM0 during the burst read
+   }
+
+/* The following functions make integer data conversions appropriate for the MSP430, using the 32-bit integer
+formulas from the BME280 spec sheet. They are pure: the inputs are the calibration block and raw readings,
+nothing is volatile or global, so the compiler can keep every intermediate in registers. */
+
+static inline int32_t compTFine(const BME280Cal *cal, int32_t rawTemp)
+{
+    int32_t var1, var2;
+    var1 = ((((rawTemp >> 3) - ((int32_t)cal->dig_T1 << 1))) * (int32_t)cal->dig_T2) >> 11;
+    var2 = ((rawTemp >> 4) - (int32_t)cal->dig_T1);
+    var2 = (((var2*var2) >> 12) * (int32_t)cal->dig_T3) >> 14;
+    return var1 + var2;
+}
+
+static inline int32_t compTemp(int32_t t_fine) //Hundredths of a degree C
+{
+    return ((t_fine * 5) + 128) >> 8;
+}
+
+static inline uint32_t compHumid(const BME280Cal *cal, int32_t t_fine, int32_t rawHumid) //%RH in Q22.10
+{
+    int32_t var3;
+    var3 = t_fine - (int32_t)76800;
+    var3 = ((((((int32_t)rawHumid << 14) - (((int32_t)cal->dig_H4) << 20) - (((int32_t)cal->dig_H5) * var3)) +
+        ((int32_t)16384)) >> 15) * (((((((var3 * ((int32_t)cal->dig_H6)) >> 10) * (((var3 *
+        ((int32_t)cal->dig_H3)) >> 11) + ((int32_t)32768))) >> 10) + ((int32_t)2097152)) *
+        ((int32_t)cal->dig_H2) + (int32_t)8192) >> 14));
+    var3 = (var3 - (((((var3 >> 15) * (var3 >> 15)) >> 7) * ((int32_t)cal->dig_H1)) >> 4));
+    var3 = var3 < 0 ? 0 : var3; //Clamps written as selects so a batch loop stays branch-free
+    var3 = var3 > 419430400 ? 419430400 : var3;
+    return (uint32_t)(var3 >> 12);
+}
+
+static inline uint32_t compPress(const BME280Cal *cal, int32_t t_fine, int32_t rawPress) //Pa
+{
+    int32_t var4, var5;
+    uint32_t p;
+    var4 = (((int32_t)t_fine)>>1) - (int32_t)0xFA00;
+    var5 = (((var4>>2) * (var4>>2)) >> 11 ) * ((int32_t)cal->dig_P6);
+    var5 = var5 + ((var4*((int32_t)cal->dig_P5))<<1);
+    var5 = (var5>>2)+(((int32_t)cal->dig_P4)<<16);
+    var4 = (((cal->dig_P3 * (((var4>>2) * (var4>>2)) >> 13 )) >> 3) + ((((int32_t)cal->dig_P2) * var4)>>1))>>18;
+    var4 = ((((0x8000+var4))*((int32_t)cal->dig_P1))>>15);
+    if (var4 == 0)
+    {
+        return 0; // Avoid exception caused by division by zero
+    }
+    p = (((uint32_t)(((int32_t)0x100000)-rawPress)-(var5>>12)))*0xC35;
+    if (p < 0x80000000)
+    {
+        p = (p << 1) / ((uint32_t)var4);
+    }
+    else
+    {
+        p = (p / (uint32_t)var4) * 2;
+    }
+    var4 = (((int32_t)cal->dig_P9) * ((int32_t)(((p>>3) * (p>>3))>>13)))>>12;
+    var5 = (((int32_t)(p>>2)) * ((int32_t)cal->dig_P8))>>13;
+    p = (uint32_t)((int32_t)p + ((var4 + var5 + cal->dig_P7) >> 4));
+    return p;
+}
+
+int32_t CalcTemp(BME280 *dev) //Also sets t_fine for CalcHumid() and CalcPress()
+{
+    dev->t_fine = compTFine(dev->cal, dev->RawTemp);
+    return compTemp(dev->t_fine);
+}
+
+uint32_t CalcHumid(BME280 *dev)
+{
+    return compHumid(dev->cal, dev->t_fine, dev->RawHumid);
+}
+
+uint32_t CalcPress(BME280 *dev)
+{
+    return compPress(dev->cal, dev->t_fine, dev->RawPress);
+}
+
+void BME280CompensateBatch(const BME280Cal *cal, const int32_t *rawTemp, const int32_t *rawPress,
+                           const int32_t *rawHumid, int32_t *temp, uint32_t *press, uint32_t *humid, uint16_t count)
+{
+    /* Compensate count readings of one sensor, same results as CalcTemp(), CalcHumid() and CalcPress() on each.
+    Arrays are structure-of-arrays and must not overlap. Temperature and humidity are only multiplies, shifts
+    and selects, so their loop can be vectorized; pressure needs a division and gets a loop of its own.
+    Each loop recomputes t_fine rather than keeping a scratch array. */
+    BME280Cal c = *cal; //Local copy, so the stores below cannot alias the coefficients
+    uint16_t k;
+
+    for (k = 0; k < count; k++)
+    {
+        int32_t t_fine = compTFine(&c, rawTemp[k]);
+        temp[k] = compTemp(t_fine);
+        humid[k] = compHumid(&c, t_fine, rawHumid[k]);
+    }
+    for (k = 0; k < count; k++)
+    {
+        press[k] = compPress(&c, compTFine(&c, rawTemp[k]), rawPress[k]);
+    }
+}
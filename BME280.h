@@ -1,221 +1,104 @@
 /*
  BME280.h
- Library of 6 functions to extract and process data from the BME280 temperature-humidity sensor using
- the SPI protocol with the UCB0 module.  Modify registers ctrl_hum, ctrl_meas, and config as needed.
+ Library of functions to extract and process data from the BME280 temperature-humidity sensor using
+ the SPI protocol with the UCB0 module. Register reads and writes are queued as spi.h transactions and run
+ from the SPI interrupt; call spiInit() first. Modify registers ctrl_hum, ctrl_meas, and config as needed.
  Consult the BME280 device data sheet.
+
+ Every sensor has its own BME280 handle with its chip select, raw readings and t_fine, so several sensors
+ (e.g. at different soil depths) can share the bus; start a read on each, then spiWait() once. The
+ compensation coefficients go in a BME280Cal block the caller keeps in FRAM, e.g.
+
+    #pragma PERSISTENT(soilCal)
+    BME280Cal soilCal = {0};
+
+ BME280Init() only reads them from the sensor when the block is blank or belongs to another chip select, so
+ GetCompData() runs once per device instead of on every boot.
+
+ The sensor runs in normal mode with one of the acquisition profiles below (oversampling, IIR filter and
+ standby time), written once by BME280Init() or BME280SetProfile(). A poll is then only the 8-byte burst
+ read of the latest measurement; poll at least as often as the profile's sample rate to see every one.
  */
 
 #ifndef BME280_H_
 #define BME280_H_
-#define BYTES 20 //Max number of bytes sent on SPI
-#define CS_TH BIT5; //Set CSB to P1.5 on MCU.  Must also be set consistently in main program
-
-volatile int32_t RawTemp, RawPress, RawHumid;
-volatile uint16_t dig_T1, dig_P1;
-volatile int16_t  dig_T2, dig_T3;
-volatile int16_t  dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
-volatile int32_t t_fine;
-volatile uint8_t dig_H1, dig_H3, i;
-volatile int8_t dig_H6;
-volatile int16_t dig_H2, dig_H4, dig_H5;
-volatile unsigned char  Tempbuf[30], Humbuf[15];
-char RXbuf[BYTES], RXdata[BYTES], TXbuf[BYTES], Data[BYTES];
-
-uint8_t ReadTHid(void)  // Get the TH sensor chip ID: 0x60
-    {
-     uint8_t FLAG;
-     UCB0CTL1 &= ~UCSWRST; //Start USCI
-     P1OUT &= ~CS_TH; //Pull CSB low
-     unsigned char TID[]={0xD0,0x00}; //Read followed by dummy byte
-
-     for (i=0; i < sizeof TID; i++)
-     {
-         while (!(UCB0IFG & UCTXIFG)); //Check if it is OK to write
-         UCB0TXBUF = TID[i]; //Load data into transmit buffer
-         while (!(UCB0IFG & UCRXIFG)); //Wait until complete RX byte is received
-         RXbuf[i] = UCB0RXBUF; //Read buffer to clear RX flag
-     }
-      P1OUT |= CS_TH; //Pull CSB line high
-      UCB0CTL1 |= UCSWRST; //Stop USCI
-      if (RXbuf[1] == 0x60) FLAG =1;
-      else FLAG=0;
-      return FLAG;
-    }
-
-void GetCompData(void)
-     {
-        /* Compensation data can be read in sleep mode. Use burst read
-        to get temp, pressure, and humidity compensation bytes starting at first data byte 0X88.
-        Retrieve data while CSB is low. */
-
-    UCB0CTL1 &= ~UCSWRST; //Start USCI
-    P1OUT &= ~CS_TH; //Pull CSB line low
-
-    while (!(UCB0IFG & UCTXIFG)); //Check if it is OK to write
-    UCB0TXBUF = 0x88; //Load first address to be read.
-    while (!(UCB0IFG & UCRXIFG)); //Wait until complete RX byte is received
-    Tempbuf[0] = UCB0RXBUF; //Read buffer to clear RX flag. The first read byte is of no use
-
-    //Burst mode read of temperature, pressure, and first humidity compensation bytes follows
-    for (i=1; i < 27; i++)
-    {
-        while (!(UCB0IFG & UCTXIFG));
-        UCB0TXBUF = 0xAA; //Load dummy data into transmit buffer
-        while (!(UCB0IFG & UCRXIFG));
-        Tempbuf[i] = UCB0RXBUF;
-        }
-         P1OUT |= CS_TH; //Pull CSB line high
-         UCB0CTL1 |= UCSWRST; //Stop USCI
-
-        // Build the temperature compensation coefficients
-        dig_T1 = ((uint16_t)(Tempbuf[2] << 8) | (uint16_t)Tempbuf[1]); //unsigned 16-bit int
-        dig_T2 = (int16_t)((uint16_t)(Tempbuf[4] << 8) | (uint16_t)Tempbuf[3]); //signed 16-bit int
-        dig_T3 = (int16_t)((uint16_t)(Tempbuf[6] << 8) | (uint16_t)Tempbuf[5]); //signed 16-bit int
-
-        // Build the pressure compensation coefficients
-        dig_P1 = ((uint16_t)(Tempbuf[8] << 8) | (uint16_t)Tempbuf[7]); //unsigned 16-bit int
-        dig_P2 = (int16_t)((uint16_t)(Tempbuf[10] << 8) | (uint16_t)Tempbuf[9]); //signed 16-bit int
-        dig_P3 = (int16_t)((uint16_t)(Tempbuf[12] << 8) | (uint16_t)Tempbuf[11]); //signed 16-bit int
-        dig_P4 = (int16_t)((uint16_t)(Tempbuf[14] << 8) | (uint16_t)Tempbuf[13]); //signed 16-bit int
-        dig_P5 = (int16_t)((uint16_t)(Tempbuf[16] << 8) | (uint16_t)Tempbuf[15]); //signed 16-bit int
-        dig_P6 = (int16_t)((uint16_t)(Tempbuf[18] << 8) | (uint16_t)Tempbuf[17]); //signed 16-bit int
-        dig_P7 = (int16_t)((uint16_t)(Tempbuf[20] << 8) | (uint16_t)Tempbuf[19]); //signed 16-bit int
-        dig_P8 = (int16_t)((uint16_t)(Tempbuf[22] << 8) | (uint16_t)Tempbuf[21]); //signed 16-bit int
-        dig_P9 = (int16_t)((uint16_t)(Tempbuf[24] << 8) | (uint16_t)Tempbuf[23]); //signed 16-bit int
-
-        Humbuf[1]=Tempbuf[26]; //This is byte 0xA1
-
-        UCB0CTL1 &= ~UCSWRST; //Start USCI
-        P1OUT &= ~CS_TH; //Pull CSB line low
-        //Burst read of remaining humidity bytes follows
-        while (!(UCB0IFG & UCTXIFG));
-        UCB0TXBUF = 0xE1; //Load first read address
-        while (!(UCB0IFG & UCRXIFG));
-        Humbuf[0] = UCB0RXBUF; //Read buffer to clear RX flag. This byte is of no use
-
-        for (i=2; i < 10; i++) //Write dummy variable to produce burst read
-        {
-            while (!(UCB0IFG & UCTXIFG));
-                UCB0TXBUF = 0xAA; //Load dummy data into transmit buffer
-                while (!(UCB0IFG & UCRXIFG));
-                Humbuf[i] = UCB0RXBUF;
-        }
-
-         P1OUT |= CS_TH; //Pull CSB line high
-         UCB0CTL1 |= UCSWRST; //Stop USCI
-
-         // Build the humidity compensation coefficients
-         dig_H1 = (uint8_t)Humbuf[1]; //0xA1
-         dig_H2 = (int16_t)((uint16_t)(Humbuf[3] << 8) | (uint16_t)Humbuf[2]); //  0xE2/0xE1
-         dig_H3 = (uint8_t)Humbuf[4];  //0xE3
-         //dig_H4 and dig_H5 use the lower and upper nibbles of 0xE5, respectively. Split up Humbuf[6] for this purpose
-         dig_H4 = (int16_t)((uint16_t)(Humbuf[5] << 4) | (uint16_t)(Humbuf[6] & 0x0F)); //0xE4 / low nibble of 0xE5 (12 bits)
-         dig_H5 = (int16_t)((uint16_t)(Humbuf[7] << 4) | (uint16_t)((Humbuf[6] >>4) & 0x0F)); //0xE7 / high nibble of 0xE5 (12 bits)
-         dig_H6 = (uint8_t)Humbuf[8]; //0xE7
-     }
-
-void ReadTHsensor(void)
-   {
-    /* Read from sensor as follows: The ctrl_hum register is written with 0x72 followed by 0x01 for 1x oversampling.
-    The ctrl_meas register is written with 0x74; send 0x21 for temperature only, forced mode, 1x oversampling.
-    Send 0x25 for pressure + temperature, forced mode, 1x oversampling.
-    Sending 0x74 also wakes up the sensor and enables any changes written to the ctrl_humid register. The config
-    register 0x75 is forced to zero just in case. No filter is used as recommended for low rate polling.
-    Use recommended burst mode read of 8 data registers by sending address of first byte 0XF7. Retrieve
-    data while CSB is low. */
-
-     //unsigned char TH1[]={0x72,0x01,0x74,0x21,0x75,0x00,0xF7}; //Temperature only
-     unsigned char TH1[]={0x72,0x01,0x74,0x25,0x75,0x00,0xF7}; //Temp + pressure
-     UCB0CTL1 &= ~UCSWRST; //Start USCI
-     P1OUT &= ~CS_TH; //Pull CSB line low
-
-     for (i=0; i < sizeof TH1; i++) //Write above data via SPI.  No useful data is read but save anyway
-     {
-         while (!(UCB0IFG & UCTXIFG)); //Check if it is OK to write
-         UCB0TXBUF = TH1[i]; //Load data into transmit buffer
-         while (!(UCB0IFG & UCRXIFG)); //Wait until complete RX byte is received
-         RXbuf[i] = UCB0RXBUF; //Read buffer to clear RX flag. These bytes are of no use
-     }
-    // Now do a burst read of 8 data bytes (press, temp, humid) from BME280.
-    for (i=0; i < 9; i++) //Burst read.  Address 0x07 auto-increments
-    {
-        while (!(UCB0IFG & UCTXIFG)); //Check if it is OK to write
-        UCB0TXBUF = 0xAA; //Load dummy data into transmit buffer
-        while (!(UCB0IFG & UCRXIFG)); //Wait until complete RX byte is received
-        Data[i] = UCB0RXBUF; //Read buffer to clear RX flag
-    }
-     P1OUT |= CS_TH; //Pull CSB line high
-     UCB0CTL1 |= UCSWRST; //Stop USCI
-    /*
-    Data[0]: Pressure  MSB
-    Data[1]: Pressure LSB
-    Data[2]: Pressure XLSB
-    Data[3]: Temperature  MSB
-    Data[4]: Temperature LSB
-    Data[5]: Temperature XLSB
-    Data[6]: Humidity MSB
-    Data[7]: Humidity LSB
-
-    Assemble the data bytes to make a 20-bit long integer for pressure and temperature and a 16-bit integer for humidity */
-    RawPress = ((uint32_t)Data[0] << 16 | (uint32_t)Data[1] << 8 | Data[2]) >> 4; //20-bit long unsigned integer
-    RawTemp = ((uint32_t)Data[3] << 16 | (uint32_t)Data[4] << 8 | Data[5]) >> 4; //20-bit long unsigned integer
-    RawHumid = ((uint32_t)Data[6] << 8) | (uint32_t)Data[7]; //16-bit unsigned integer
-   }
-
-//The following functions make integer data conversions appropriate for the MSP430
-
-int32_t CalcTemp(void) //32-bit integer conversion formula from BME280 spec sheet
-{
-    volatile int32_t var1, var2, T;
-    var1 = (((((int32_t)RawTemp >> 3) - ((int32_t)dig_T1 << 1))) * (int32_t)dig_T2) >> 11;
-    var2 = (((int32_t)RawTemp >> 4) - (int32_t)dig_T1);
-    var2 = (((var2*var2) >> 12) * (int32_t)dig_T3) >> 14;
-    t_fine = var1 + var2;
-    T = ((t_fine * 5) + 128) >> 8;
-    return T;
-}
-
-uint32_t CalcHumid(void) //Implement integer conversion formula from BME280 spec sheet
-{
-    volatile int32_t var3;
-    var3 = t_fine - (int32_t)76800;
-    var3 = ((((((int32_t)RawHumid << 14) - (((int32_t)dig_H4) << 20) - (((int32_t)dig_H5) * var3)) +
-        ((int32_t)16384)) >> 15) * (((((((var3 * ((int32_t)dig_H6)) >> 10) * (((var3 *
-        ((int32_t)dig_H3)) >> 11) + ((int32_t)32768))) >> 10) + ((int32_t)2097152)) *
-        ((int32_t)dig_H2) + (int32_t)8192) >> 14));
-    var3 = (var3 - (((((var3 >> 15) * (var3 >> 15)) >> 7) * ((int32_t)dig_H1)) >> 4));
-    if(var3 < 0) var3 = 0;
-    if(var3 > 419430400) var3 = 419430400;
-    return (uint32_t)(var3 >> 12);
-}
-
-uint32_t CalcPress(void) //32-bit integer conversion formula from BME280 spec sheet
-{
-    volatile int32_t var4, var5;
-    volatile uint32_t p;
-    var4 = (((int32_t)t_fine)>>1) - (int32_t)0xFA00;
-    var5 = (((var4>>2) * (var4>>2)) >> 11 ) * ((int32_t)dig_P6);
-    var5 = var5 + ((var4*((int32_t)dig_P5))<<1);
-    var5 = (var5>>2)+(((int32_t)dig_P4)<<16);
-    var4 = (((dig_P3 * (((var4>>2) * (var4>>2)) >> 13 )) >> 3) + ((((int32_t)dig_P2) * var4)>>1))>>18;
-    var4 = ((((0x8000+var4))*((int32_t)dig_P1))>>15);
-    if (var4 == 0)
-    {
-        return 0; // Avoid exception caused by division by zero
-    }
-    p = (((uint32_t)(((int32_t)0x100000)-RawPress)-(var5>>12)))*0xC35;
-    if (p < 0x80000000)
-    {
-        p = (p << 1) / ((uint32_t)var4);
-    }
-    else
-    {
-        p = (p / (uint32_t)var4) * 2;
-    }
-    var4 = (((int32_t)dig_P9) * ((int32_t)(((p>>3) * (p>>3))>>13)))>>12;
-    var5 = (((int32_t)(p>>2)) * ((int32_t)dig_P8))>>13;
-    p = (uint32_t)((int32_t)p + ((var4 + var5 + dig_P7) >> 4));
-    return p;
-}
-#endif /* BME280_H_ */
 
+#include <stdint.h>
+
+#include "spi.h"
+
+#define BME280_ID 0x60 // chip ID register 0xD0
+#define BME280_CAL_MAGIC 0xB280 // marks a BME280Cal block as filled
+
+// oversampling, osrs_h/osrs_t/osrs_p field values
+#define BME280_OSRS_SKIP 0
+#define BME280_OSRS_1X 1
+#define BME280_OSRS_2X 2
+#define BME280_OSRS_4X 3
+#define BME280_OSRS_8X 4
+#define BME280_OSRS_16X 5
+
+// normal mode standby time between measurements, t_sb field values
+#define BME280_STANDBY_0_5MS 0
+#define BME280_STANDBY_62_5MS 1
+#define BME280_STANDBY_125MS 2
+#define BME280_STANDBY_250MS 3
+#define BME280_STANDBY_500MS 4
+#define BME280_STANDBY_1000MS 5
+#define BME280_STANDBY_10MS 6
+#define BME280_STANDBY_20MS 7
+
+// IIR filter coefficient, filter field values
+#define BME280_FILTER_OFF 0
+#define BME280_FILTER_2 1
+#define BME280_FILTER_4 2
+#define BME280_FILTER_8 3
+#define BME280_FILTER_16 4
+
+#define BME280_CTRL_MEAS(osrsT, osrsP) (((osrsT) << 5) | ((osrsP) << 2) | 0x03) // 0xF4, normal mode
+#define BME280_CONFIG(standby, filter) (((standby) << 5) | ((filter) << 2)) // 0xF5, 4-wire SPI
+
+typedef struct {
+    uint16_t magic; // BME280_CAL_MAGIC once the coefficients below have been read
+    unsigned char cs; // chip select of the sensor they were read from
+    uint8_t dig_H1, dig_H3;
+    int8_t dig_H6;
+    uint16_t dig_T1, dig_P1;
+    int16_t dig_T2, dig_T3;
+    int16_t dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
+    int16_t dig_H2, dig_H4, dig_H5;
+} BME280Cal;
+
+typedef struct {
+    unsigned char ctrlHum; // 0xF2 value, humidity oversampling
+    unsigned char ctrlMeas; // 0xF4 value, BME280_CTRL_MEAS()
+    unsigned char config; // 0xF5 value, BME280_CONFIG()
+} BME280Profile;
+
+extern const BME280Profile BME280Weather, BME280Indoor, BME280HighRate;
+
+typedef struct {
+    SpiTransaction read; // first member, so a finished transaction leads back to its sensor
+    SpiTransaction humRead; // second compensation read
+    unsigned char cs; // P1 chip select pin
+    BME280Cal *cal; // compensation block in FRAM
+    int32_t RawTemp, RawPress, RawHumid;
+    int32_t t_fine; // set by CalcTemp(), used by CalcHumid() and CalcPress()
+    unsigned char Data[26]; // burst read: compensation bytes 0x88 to 0xA1, or the 8 sample bytes
+    unsigned char Humbuf[8]; // burst read: compensation bytes 0xE1 to 0xE8
+    unsigned char Tx[8]; // profile register writes
+} BME280;
+
+uint8_t BME280Init(BME280 *dev, unsigned char cs, BME280Cal *cal, const BME280Profile *profile);
+void BME280SetProfile(BME280 *dev, const BME280Profile *profile);
+uint8_t ReadTHid(BME280 *dev);
+void GetCompData(BME280 *dev);
+void ReadTHsensorStart(BME280 *dev);
+void ReadTHsensor(BME280 *dev);
+int32_t CalcTemp(BME280 *dev);
+uint32_t CalcHumid(BME280 *dev);
+uint32_t CalcPress(BME280 *dev);
+void BME280CompensateBatch(const BME280Cal *cal, const int32_t *rawTemp, const int32_t *rawPress,
+                           const int32_t *rawHumid, int32_t *temp, uint32_t *press, uint32_t *humid, uint16_t count);
+
+#endif /* BME280_H_ */
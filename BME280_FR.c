@@ -1,20 +1,20 @@
 #include <msp430.h>
-#include <stdio.h>
 #include <stdint.h>
 
 #include "BME280.h"
+#include "format.h"
 
 /*
  Read and display temperature, relative humidity, and pressure with BME280 sensor on FR5969 Launchpad.
- Sensor polled in forced mode using the SPI interface. Internal trimming parameters must be
+ Sensor measures in normal mode with the weather profile and is polled using the SPI interface. Internal trimming parameters must be
  read from device to perform conversion of raw data.  Data displayed on terminal program.
  Set serial port for 9600 baud, 8-bits, 1 stop, no parity, no flow control. UART interface is
  on TXD (P2.5) and RXD (P2.6); these ports are reversed on the receiving device, ie. the RX-TX
  are switched on the PC interface cable. UART polling with no RX interrupt. Green LED on P1.0
  illuminates during data transmission. SPI lines are on P1.6 (MOSI), P1.7 (MISO), P2.2 (CLK)
- of UCB0 module and P1.5 (CS). SPI clock 1 MHz. The CS line must be configured consistently in
- the BME280.h file. Main loop runs with timed interrupt from LPM3 and VLO clock. IDE with
- CCS 6.1.3 and nofloat printf support. Launchpad pins:
+ of UCB0 module and P1.5 (CS). SPI clock 1 MHz. The CS line is passed to BME280Init() and must
+ match CS_TH below. Main loop runs with timed interrupt from LPM3 and VLO clock. IDE with
+ CCS 6.1.3; numbers are formatted with format.h, no printf support needed. Launchpad pins:
 
     P1.6  UCB0 MOSI
     P1.7  UCB0 MISO
@@ -24,20 +24,28 @@
     P2.6  UCA1RXD
  */
 
+#define CS_TH BIT5 //CSB on P1.5
+#define SMCLK_HZ 1000000UL //Default DCO, this demo leaves the clock system as it comes out of reset
+
 # define PERIOD 10000 //Samping period. 10000 count is approximately 1 second; maximum is 65535
+#define TX_TRIES 2000 //Polls of the UART TX flag before the rest of a line is dropped, a byte takes far fewer
 
 void SetTimer(void);
 void SetVLO(void);
 void SetPins(void);
 void SetUART(void);
-void SetSPI(void);
 
 //Variables for UART terminal display
 char str[80];
 volatile uint8_t i,count;
+uint16_t tries;
 volatile int32_t CorT;
 volatile uint32_t CorH, CorP;
 
+BME280 th; //The sensor on CS_TH
+#pragma PERSISTENT(thCal)
+BME280Cal thCal = {0}; //Its compensation coefficients, kept in FRAM across resets
+
 void main(void) {
 
     WDTCTL = WDTPW | WDTHOLD;   // Stop watchdog timer
@@ -46,38 +54,41 @@ void main(void) {
     SetVLO();
     SetTimer();
     SetUART();
-    SetSPI();
+    spiInit(SMCLK_HZ); //Undivided, so the SPI clock is 1 MHz
 
     _BIS_SR(GIE); //Enable global interrupts.
 
-    if(ReadTHid()); //Check for presence of sensor; read its ID code
+    //Check for presence of sensor; read its ID code and, on first boot only, the compensation coefficients
+    if(BME280Init(&th, CS_TH, &thCal, &BME280Weather));
     else  //Trap CPU and turn on red LED if not found
     {
         P4OUT |= BIT6;
         while(1){}
     }
 
-    //Get the compensation coefficients from device for raw data conversion
-    GetCompData();
-
     while(1)
     {
          TA0CCR0 = PERIOD; // Polling period
          LPM3;      //Wait in low power mode
          P1OUT |= BIT0; //Timeout. Turn on green LED on Launchpad
-         //Burst read on SPI to get 3 press data bytes, 3 temp bytes and 2 humidity bytes
-         ReadTHsensor();
+         //Burst read on SPI to get the latest 3 press data bytes, 3 temp bytes and 2 humidity bytes; sleeps in LPM0 meanwhile
+         ReadTHsensor(&th);
          //Apply cal factors to raw data
-         CorT = CalcTemp(); //Corrected temperature
-         CorH = CalcHumid(); //Corrected humidity
-         CorP = CalcPress(); //Corrected pressure
-         //Send data to serial port for display
-         sprintf(str,"%s %lu.%.2lu%s %lu.%.2lu%s %lu.%.2lu%s", "Temperature:", CorT/100, CorT%100,"C Rel Humidity:",
-                 CorH/1000, CorH%100,"% Pressure:",CorP/100, CorP%100," hPa\r\n\n");
-         count = sizeof str;
-         for (i=0; i < count; i++)
+         CorT = CalcTemp(&th); //Corrected temperature
+         CorH = CalcHumid(&th); //Corrected humidity
+         CorP = CalcPress(&th); //Corrected pressure
+         //Send data to serial port for display. CorT is in 0.01 C, CorH in 1/1024 %RH and CorP in Pa
+         count = fmtText(str, "Temperature: ");
+         count += fmtFixed(&str[count], CorT, 2);
+         count += fmtText(&str[count], "C Rel Humidity: ");
+         count += fmtFixed(&str[count], (CorH * 100 + 512) >> 10, 2); //Rounded to 0.01 %RH
+         count += fmtText(&str[count], "% Pressure: ");
+         count += fmtFixed(&str[count], CorP, 2); //Pa are 0.01 hPa
+         count += fmtText(&str[count], " hPa\r\n\n");
+         for (i=0; i < count; i++) //Only the formatted characters, no trailing buffer bytes
          {
-             while (!(UCA1IFG & UCTXIFG)); // USCI_A0 TX buffer ready?
+             for (tries = TX_TRIES; !(UCA1IFG & UCTXIFG) && tries; tries--); // USCI_A0 TX buffer ready?
+             if (!tries) break; //UART stuck, drop the line rather than hang
              UCA1TXBUF = str[i]; //Send data 1 byte at a time
          }
          P1OUT &= ~BIT0; //Turn off LED
@@ -97,7 +108,7 @@ void SetPins(void)
     P1.0 Green LED
     P1.1 Launchpad switch
     P1.5 Chip select.  Pull this line low to enable BME280 communication
-        CS_TH must also be defined in BME280.h
+        CS_TH must match this pin
     P1.6 UCB0 MOSI
     P1.7 UCB0 MISO
     */
@@ -149,17 +160,3 @@ void SetPins(void)
      UCA1MCTLW |= UCOS16 + UCBRF3 + UCBRS5;
      UCA1CTLW0 &= ~UCSWRST;
   }
-
- void SetSPI(void)
-   {
-     // Configure the eUSCI_B0 module for 3-pin SPI at 1 MHz
-     UCB0CTLW0 |= UCSWRST;
-     // Use SMCLK at 1 MHz;
-     UCB0CTLW0 |= UCSSEL__SMCLK + UCMODE_0 + UCMST + UCSYNC + UCMSB + UCCKPH;
-     //UCB0BR0 |= 0x02; //Divide SMCLK by 2 to clock at 500 kHz
-     UCB0BR0 |= 0x01; //1 MHz SPI clock
-     UCB0BR1 |= 0x00;
-     UCB0CTLW0 &= ~UCSWRST;
-   }
-
-
@@ -0,0 +1,73 @@
+#include "adc.h"
+#include "hal.h"
+#include "prof.h"
+#include "scheduler.h"
+
+#define ADC_TEMP_CH (ADCSREF_1 | ADCINCH_12) // ADC input ch A12 => temp sense, internal 1.5 V reference
+
+volatile AdcSample adcRing[ADC_RING_LEN];
+
+static volatile unsigned char adcWriteIdx = 0; // next set to be written
+static volatile unsigned char adcStep = 0; // zone being converted, ZONE_COUNT for the temperature
+static volatile unsigned char adcSequenceBusy = 0;
+
+void adcInit() {
+    unsigned char zone;
+
+    adcSequenceBusy = 0; // a sequence cut short by a reset is not waited for
+    adcStep = 0;
+    for(zone = 0; zone < ZONE_COUNT; zone++) { // probe pins, analog function
+        halAdcPin(zoneConfig[zone].adcChannel & 0x0F);
+    }
+    halAdcInit(zoneConfig[0].adcChannel); // sequences always start with zone 0; reference and temperature sensor on
+}
+
+void adcStartSequence() { // convert ADC_HALF_LEN moisture/temperature sets into the next half of the ring
+    if(adcSequenceBusy) {
+        return; // previous half not finished yet
+    }
+    adcSequenceBusy = 1;
+    adcStep = 0;
+    halAdcSelect(zoneConfig[0].adcChannel);
+    halAdcStart();
+}
+
+unsigned char adcBusy() {
+    return adcSequenceBusy;
+}
+
+const volatile AdcSample *adcReadyHalf(unsigned char events) { // half of the ring that was just completed
+    if(events & EVENT_ADC_FULL) {
+        return &adcRing[ADC_HALF_LEN];
+    }
+    return &adcRing[0];
+}
+
+HAL_ISR(ADC_VECTOR, adcIsr) {
+    PROF_START(PROF_ISR_ADC);
+    switch(halAdcIv()) {
+        case ADCIV_ADCIFG:
+            if(adcStep < ZONE_COUNT) { // a probe done, next zone or the temperature next
+                adcRing[adcWriteIdx].moisture[adcStep] = halAdcResult();
+                adcStep++;
+                halAdcSelect(adcStep < ZONE_COUNT ? zoneConfig[adcStep].adcChannel : ADC_TEMP_CH);
+            } else { // temperature done, set complete
+                adcRing[adcWriteIdx].temp = halAdcResult();
+                adcWriteIdx = (adcWriteIdx + 1) & (ADC_RING_LEN - 1);
+                adcStep = 0;
+                halAdcSelect(zoneConfig[0].adcChannel);
+                if(adcWriteIdx == ADC_HALF_LEN || adcWriteIdx == 0) { // a half of the ring is ready
+                    schedEvents |= (adcWriteIdx == 0) ? EVENT_ADC_FULL : EVENT_ADC_HALF;
+                    PROF_START(PROF_ADC_LATENCY);
+                    adcSequenceBusy = 0;
+                    HAL_WAKE_ON_EXIT();
+                    break;
+                }
+            }
+            halAdcStart(); // start the next conversion right away
+            break;
+        default:
+            break;
+    }
+    PROF_END(PROF_ISR_ADC);
+}
@@ -0,0 +1,33 @@
+/*
+ adc.h
+ Interrupt-driven ADC sequence for the moisture probes of every zone (zone.h, Vref=AVCC) and the internal
+ temperature sensor (A12, 1.5 V internal reference). The FR2355 has no DMA, and a hardware channel sequence
+ shares one reference for every channel, so the ADC interrupt steps through the channels itself and starts the
+ next conversion immediately: one probe per zone, then the temperature, interleaved so every zone is sampled
+ at the same points in time. Each set goes into a ring buffer. EVENT_ADC_HALF is posted when the first half of
+ the ring is full and EVENT_ADC_FULL when the second half is, so main() can average one half while the other
+ is being filled. The reference is enabled once in adcInit().
+ */
+
+#ifndef ADC_H_
+#define ADC_H_
+
+#include "zone.h"
+
+#define ADC_RING_LEN 16 // moisture/temperature sets in the ring, must be a power of two
+#define ADC_HALF_LEN (ADC_RING_LEN/2) // sets converted by each adcStartSequence()
+#define ADC_HALF_SHIFT 3 // log2(ADC_HALF_LEN), to average a half with a shift
+
+typedef struct {
+    unsigned short moisture[ZONE_COUNT]; // probe of each zone
+    unsigned short temp; // A12
+} AdcSample;
+
+extern volatile AdcSample adcRing[ADC_RING_LEN];
+
+void adcInit();
+void adcStartSequence();
+unsigned char adcBusy();
+const volatile AdcSample *adcReadyHalf(unsigned char events);
+
+#endif /* ADC_H_ */
@@ -0,0 +1,157 @@
+#include "button.h"
+#include "hal.h"
+#include "prof.h"
+#include "scheduler.h"
+
+typedef struct {
+    unsigned char down; // debounced state
+    unsigned char differ; // samples in a row the raw state has differed from down
+    unsigned short held; // samples since the debounced press
+    unsigned char gap; // samples since a release with a short press pending
+    unsigned char pending; // 1 while a short press may still become a double press
+    unsigned char longSent; // 1 once BUTTON_LONG went out for this press
+} ButtonState;
+
+static ButtonState buttons[BUTTON_COUNT];
+static unsigned char buttonPolling = 0;
+static unsigned short buttonAlarm; // TB0R value of the next sample
+
+static unsigned char buttonQueue[BUTTON_QUEUE_LEN];
+static volatile unsigned char buttonQueueHead = 0; // next free slot, written by the interrupt
+static volatile unsigned char buttonQueueTail = 0; // next event to read, written by main()
+
+static unsigned char buttonRaw(unsigned char button) {
+    if(button == BUTTON_THRES) {
+        return halThresButtonDown();
+    }
+    return halRefillButtonDown();
+}
+
+static void buttonPost(unsigned char event) {
+    unsigned char next = (buttonQueueHead + 1) & (BUTTON_QUEUE_LEN - 1);
+
+    if(next != buttonQueueTail) { // drop the event if main() has fallen behind
+        buttonQueue[buttonQueueHead] = event;
+        buttonQueueHead = next;
+    }
+    schedEvents |= EVENT_BUTTON;
+}
+
+static unsigned char buttonSample(unsigned char button) { // 1 while the button still needs sampling
+    ButtonState *state = &buttons[button];
+    unsigned char raw = buttonRaw(button);
+
+    if(raw != state->down) {
+        state->differ++;
+    } else {
+        state->differ = 0;
+    }
+
+    if(state->differ >= BUTTON_STABLE) { // debounced edge
+        state->differ = 0;
+        state->down = raw;
+        if(raw) {
+            state->held = 0;
+            state->longSent = 0;
+        } else if(!state->longSent) {
+            if(state->pending) {
+                state->pending = 0;
+                buttonPost(button | BUTTON_DOUBLE);
+            } else {
+                state->pending = 1;
+                state->gap = 0;
+            }
+        }
+    } else if(state->down) {
+        if(state->held < BUTTON_LONG_HOLD && ++state->held == BUTTON_LONG_HOLD) {
+            state->pending = 0; // a long press ends any double press
+            state->longSent = 1;
+            buttonPost(button | BUTTON_LONG);
+        }
+    } else if(state->pending && ++state->gap >= BUTTON_DOUBLE_GAP) {
+        state->pending = 0;
+        buttonPost(button | BUTTON_SHORT);
+    }
+
+    return state->down || state->pending || state->differ;
+}
+
+static void buttonStartPolling() {
+    halButtonIrq(0); // edges are ignored while sampling, bounces included
+    if(!buttonPolling) {
+        buttonPolling = 1;
+        buttonAlarm = halTickCount();
+        buttonAlarm += BUTTON_POLL;
+        if(buttonAlarm > TICK_PERIOD) { // TB0 counts 0 to TICK_PERIOD
+            buttonAlarm -= TICK_PERIOD + 1;
+        }
+        halTickAlarm(buttonAlarm);
+    }
+}
+
+void buttonInit() {
+    unsigned char button;
+
+    for(button = 0; button < BUTTON_COUNT; button++) {
+        buttons[button].down = 0;
+        buttons[button].differ = 0;
+        buttons[button].pending = 0;
+        buttons[button].longSent = 0;
+    }
+    halButtonIrq(1); // buttons interrupt on the High -> Low edges set in gpioInit()
+}
+
+unsigned char buttonRead(unsigned char *event) { // 1 if a gesture was returned
+    unsigned char tail = buttonQueueTail;
+
+    if(tail == buttonQueueHead) {
+        return 0;
+    }
+    *event = buttonQueue[tail];
+    buttonQueueTail = (tail + 1) & (BUTTON_QUEUE_LEN - 1);
+    return 1;
+}
+
+HAL_ISR(PORT2_VECTOR, thresButtonIsr) {
+    halThresButtonAck();
+    buttonStartPolling(); // no wake-up, the alarm runs in LPM3
+}
+
+HAL_ISR(PORT4_VECTOR, refillButtonIsr) {
+    halRefillButtonAck();
+    buttonStartPolling();
+}
+
+HAL_ISR(TIMER0_B1_VECTOR, buttonPollIsr) {
+    unsigned char busy = 0;
+    unsigned char button;
+
+    PROF_START(PROF_ISR_BUTTON);
+    switch(halTickIv()) {
+        case TB0IV_TBCCR1:
+            for(button = 0; button < BUTTON_COUNT; button++) {
+                busy |= buttonSample(button);
+            }
+            if(busy) {
+                buttonAlarm += BUTTON_POLL;
+                if(buttonAlarm > TICK_PERIOD) {
+                    buttonAlarm -= TICK_PERIOD + 1;
+                }
+                halTickAlarm(buttonAlarm);
+            } else { // all quiet, back to edge interrupts
+                halTickAlarmOff();
+                buttonPolling = 0;
+                halButtonIrq(1);
+                if(halThresButtonDown() || halRefillButtonDown()) { // pressed before the edges were armed
+                    buttonStartPolling();
+                }
+            }
+            if(schedEvents & EVENT_BUTTON) {
+                HAL_WAKE_ON_EXIT();
+            }
+            break;
+        default:
+            break;
+    }
+    PROF_END(PROF_ISR_BUTTON);
+}
@@ -0,0 +1,40 @@
+/*
+ button.h
+ Debounced buttons with gestures. A press edge on P2.3 or P4.1 only wakes the port interrupt, which hands
+ over to a BUTTON_POLL alarm on Timer_B0 CCR1 (ACLK, so it keeps running in LPM3). The alarm samples both
+ buttons until they have been released and quiet again, then the edge interrupts take over and the CPU sleeps
+ until the next touch. A button has to read the same for BUTTON_STABLE samples in a row to change state, and
+ the gestures it makes are put in an event queue, with EVENT_BUTTON posted to the scheduler:
+
+    BUTTON_SHORT   pressed and released, no second press within BUTTON_DOUBLE_GAP
+    BUTTON_DOUBLE  two short presses within BUTTON_DOUBLE_GAP
+    BUTTON_LONG    held for BUTTON_LONG_HOLD, sent while still held; the release is not a press
+
+ Each queued event is the button number or'ed with the gesture.
+ */
+
+#ifndef BUTTON_H_
+#define BUTTON_H_
+
+#include "scheduler.h"
+
+#define BUTTON_POLL (ACLK_HZ / 100) // ACLK counts between samples, 10 ms
+#define BUTTON_STABLE 3 // samples that must agree, 30 ms
+#define BUTTON_LONG_HOLD 100 // samples, 1 s
+#define BUTTON_DOUBLE_GAP 30 // samples between the release and a second press, 300 ms
+#define BUTTON_QUEUE_LEN 8 // power of two
+
+// buttons
+#define BUTTON_THRES 0 // P2.3 moisture threshold button
+#define BUTTON_REFILL 1 // P4.1 water level reset button
+#define BUTTON_COUNT 2
+
+// gestures
+#define BUTTON_SHORT 0x00
+#define BUTTON_LONG 0x10
+#define BUTTON_DOUBLE 0x20
+
+void buttonInit();
+unsigned char buttonRead(unsigned char *event);
+
+#endif /* BUTTON_H_ */
@@ -0,0 +1,60 @@
+#include "clock.h"
+#include "hal.h"
+
+// DCO frequency range and FRAM wait states for CLOCK_FAST_HZ
+#if CLOCK_FAST_HZ > 24000000UL
+#error "CLOCK_FAST_HZ is above the 24 MHz maximum of the MSP430FR2355"
+#elif CLOCK_FAST_HZ > 20000000UL
+#define CLOCK_DCORSEL DCORSEL_7
+#elif CLOCK_FAST_HZ > 16000000UL
+#define CLOCK_DCORSEL DCORSEL_6
+#elif CLOCK_FAST_HZ > 12000000UL
+#define CLOCK_DCORSEL DCORSEL_5
+#elif CLOCK_FAST_HZ > 8000000UL
+#define CLOCK_DCORSEL DCORSEL_4
+#elif CLOCK_FAST_HZ > 4000000UL
+#define CLOCK_DCORSEL DCORSEL_3
+#elif CLOCK_FAST_HZ > 2000000UL
+#define CLOCK_DCORSEL DCORSEL_2
+#elif CLOCK_FAST_HZ > 1000000UL
+#define CLOCK_DCORSEL DCORSEL_1
+#else
+#define CLOCK_DCORSEL DCORSEL_0
+#endif
+
+#if CLOCK_FAST_HZ > 16000000UL
+#define CLOCK_NWAITS NWAITS_2 // FRAM reads above 16 MHz need two wait states
+#elif CLOCK_FAST_HZ > 8000000UL
+#define CLOCK_NWAITS NWAITS_1
+#else
+#define CLOCK_NWAITS NWAITS_0
+#endif
+
+// MCLK and SMCLK divider fields for CLOCK_SMCLK_DIV
+#if CLOCK_SMCLK_DIV == 2
+#define CLOCK_DIVM DIVM__2
+#define CLOCK_DIVS DIVS__2
+#elif CLOCK_SMCLK_DIV == 4
+#define CLOCK_DIVM DIVM__4
+#define CLOCK_DIVS DIVS__4
+#elif CLOCK_SMCLK_DIV == 8
+#define CLOCK_DIVM DIVM__8
+#define CLOCK_DIVS DIVS__8
+#else
+#error "CLOCK_SMCLK_DIV must be 2, 4 or 8, the dividers SMCLK can have"
+#endif
+
+#define CLOCK_LOCK_TRIES 60000 // FLL lock polls, it locks in a few hundred REFO cycles
+
+void clockInit() { // first thing after the watchdog is stopped
+    halClockInit(CLOCK_DCORSEL, CLOCK_FLLN, CLOCK_NWAITS, CLOCK_LOCK_TRIES); // FLL on REFO, ACLK from REFO
+    clockFast(); // init does the most work
+}
+
+void clockFast() { // MCLK at CLOCK_MCLK_HZ, SMCLK divided down to CLOCK_SMCLK_HZ
+    halClockDivide(DIVM__1, CLOCK_DIVS);
+}
+
+void clockSlow() { // MCLK divided down to CLOCK_SMCLK_HZ, SMCLK undivided so it stays the same
+    halClockDivide(CLOCK_DIVM, DIVS__1);
+}
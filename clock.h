@@ -0,0 +1,35 @@
+/*
+ clock.h
+ Clock system. The DCO is locked by the FLL to CLOCK_FAST_HZ (24 MHz by default), the one frequency the rest
+ of the firmware is derived from: CLOCK_SMCLK_HZ, the UART baud dividers (uart.c), the servo PWM period and
+ pulse widths (servo.h) and the settling delays (CLOCK_DELAY_US); spiInit() (spi.c) is passed CLOCK_SMCLK_HZ on
+ this board. Any of the DCO ranges from 4 MHz up, 4, 8, 12, 16, 20 or 24 MHz, can be used by changing
+ CLOCK_FAST_HZ alone; at 1 and 2 MHz SMCLK is too slow for the UART (uart.c).
+
+ MCLK runs at CLOCK_FAST_HZ for bursts of work (clockFast()), the ADC averaging, filters and controllers,
+ telemetry framing and log replay, and is divided down to the SMCLK frequency while the CPU is only handling
+ events (clockSlow()). SMCLK is MCLK divided again, by the same factor in the other direction, so the UART,
+ SPI and servo PWM see the same SMCLK_HZ in both modes and can be running when the mode changes. In LPM3 the
+ DCO is off; ACLK comes from REFO, the same 32768 Hz reference the FLL locks to, so the control tick
+ (scheduler.h) is as accurate as the fast clock. The VLO would draw less in LPM3, but its frequency is only
+ loosely specified and drifts with temperature, and everything timed by the tick would inherit that error.
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#define CLOCK_FAST_HZ 24000000UL // nominal MCLK for bursts of work, one of the DCO ranges
+#define CLOCK_REFO_HZ 32768UL // FLL reference
+#define CLOCK_FLLN (CLOCK_FAST_HZ / CLOCK_REFO_HZ - 1) // DCOCLKDIV = (FLLN + 1) * REFO
+#define CLOCK_MCLK_HZ ((CLOCK_FLLN + 1) * CLOCK_REFO_HZ) // actual fast MCLK, 23.986 MHz for 24 MHz
+#define CLOCK_SMCLK_DIV 8 // SMCLK below MCLK, and the slow MCLK below the fast one; 2, 4 or 8
+#define CLOCK_SMCLK_HZ (CLOCK_MCLK_HZ / CLOCK_SMCLK_DIV) // same in both modes, 2.998 MHz for 24 MHz
+
+// __delay_cycles() counts for a delay of at least us microseconds; longer while MCLK is slow, never shorter
+#define CLOCK_DELAY_US(us) ((us) * ((CLOCK_MCLK_HZ + 999999UL) / 1000000UL))
+
+void clockInit();
+void clockFast();
+void clockSlow();
+
+#endif /* CLOCK_H_ */
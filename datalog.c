@@ -0,0 +1,242 @@
+#include "datalog.h"
+#include "protocol.h"
+
+#define LOG_DATA_LEN (LOG_BLOCK_LEN - 10) // entry bytes per block
+#define LOG_ENTRY_MAX (6 + 2 * (LOG_ZONES_MAX - 1)) // largest entry, two 3-byte varints and a 2-byte one per further zone
+
+// The log must survive resets, so it is not initialized by the C startup code. Writes go straight to FRAM;
+// .datalog is in the read/write FRAM group below fram_rx_start, which is not write protected.
+#pragma DATA_SECTION(logBlocks, ".datalog")
+LogBlock logBlocks[LOG_BLOCKS];
+
+static LogBlock *logCurrent; // block being appended to
+static unsigned short logLastMoisture; // last logged values, deltas are taken from these
+static short logLastTemp;
+static unsigned short logCycles = 0; // control cycles until the next logged sample
+
+static unsigned char logReplayBlock; // block index being sent
+static unsigned char logReplayLeft = 0; // blocks still to look at after logReplayBlock
+static unsigned short logReplayIdx = 0; // next byte of the block to send
+static unsigned short logReplayLen = 0; // header plus used data bytes of the block, 0 when not replaying
+
+static unsigned short zigzag(short num) { // small negative and positive deltas both become small numbers
+    return ((unsigned short)num << 1) ^ (unsigned short)(num >> 15);
+}
+
+static short unzigzag(unsigned short num) {
+    return (short)(num >> 1) ^ -(short)(num & 1);
+}
+
+static unsigned char putVarint(unsigned char *dest, unsigned short num) { // returns bytes written
+    unsigned char len = 0;
+
+    while(num >= 0x80) {
+        dest[len++] = (unsigned char)num | 0x80; // low 7 bits, more to follow
+        num >>= 7;
+    }
+    dest[len++] = (unsigned char)num;
+    return len;
+}
+
+static unsigned short getVarint(const unsigned char *src, unsigned short *idx) {
+    unsigned short num = 0;
+    unsigned char shift = 0;
+    unsigned char byte;
+
+    do {
+        byte = src[(*idx)++];
+        num |= (unsigned short)(byte & 0x7F) << shift;
+        shift += 7;
+    } while((byte & 0x80) && shift < 16);
+    return num;
+}
+
+static void startBlock(unsigned short seq) { // move to the next block, the oldest one is overwritten
+    LogBlock *block = (logCurrent == 0 || logCurrent == &logBlocks[LOG_BLOCKS - 1]) ? &logBlocks[0] : logCurrent + 1;
+
+    block->magic = 0; // invalid until the header is complete
+    block->seq = seq;
+    block->used = 0;
+    block->moisture = logLastMoisture;
+    block->temp = logLastTemp;
+    block->magic = LOG_MAGIC;
+    logCurrent = block;
+}
+
+static void appendEntry(const unsigned char *entry, unsigned char len) {
+    unsigned char idx;
+
+    if(logCurrent->used + len > LOG_DATA_LEN) {
+        startBlock(logCurrent->seq + 1);
+    }
+    for(idx = 0; idx < len; idx++) {
+        logCurrent->data[logCurrent->used + idx] = entry[idx];
+    }
+    logCurrent->used += len; // entry only counts once all of its bytes are in FRAM
+}
+
+static void restoreLast(unsigned char type, unsigned short moisture, short temp, unsigned short value) {
+    if(type != LOG_SAMPLE || value == 0) { // deltas are taken from zone 0
+        logLastMoisture = moisture;
+        logLastTemp = temp;
+    }
+}
+
+void logInit() { // find the newest block and carry on after its last entry
+    unsigned char idx;
+    LogBlock *newest = 0;
+
+    for(idx = 0; idx < LOG_BLOCKS; idx++) {
+        if(logBlocks[idx].magic != LOG_MAGIC || logBlocks[idx].used > LOG_DATA_LEN) {
+            continue;
+        }
+        if(newest == 0 || (short)(logBlocks[idx].seq - newest->seq) > 0) {
+            newest = &logBlocks[idx];
+        }
+    }
+
+    if(newest == 0) { // blank or corrupt FRAM, start a new log
+        for(idx = 0; idx < LOG_BLOCKS; idx++) {
+            logBlocks[idx].magic = 0;
+        }
+        logLastMoisture = 0;
+        logLastTemp = 0;
+        logCurrent = 0;
+        startBlock(0);
+        return;
+    }
+
+    logCurrent = newest;
+    logLastMoisture = newest->moisture;
+    logLastTemp = newest->temp;
+    logDecodeBlock(newest, restoreLast); // replay the block to get the last logged values back
+}
+
+void logSample(const unsigned short *moisture, unsigned char zones, short temp, unsigned short cycles) { // call with every sample and the control cycles since the last
+    unsigned char entry[LOG_ENTRY_MAX];
+    unsigned char len;
+    unsigned char zone;
+
+    if(logCycles > cycles) {
+        logCycles -= cycles;
+        return;
+    }
+    logCycles = LOG_PERIOD;
+
+    if(temp < LOG_TEMP_MIN) {
+        temp = LOG_TEMP_MIN;
+    } else if(temp > LOG_TEMP_MAX) {
+        temp = LOG_TEMP_MAX;
+    }
+    if(zones > LOG_ZONES_MAX) {
+        zones = LOG_ZONES_MAX;
+    }
+
+    len = putVarint(entry, (zigzag(moisture[0] - logLastMoisture) << 2) | LOG_SAMPLE);
+    len += putVarint(&entry[len], (zigzag(temp - logLastTemp) << 3) | (zones - 1));
+    for(zone = 1; zone < zones; zone++) {
+        len += putVarint(&entry[len], zigzag(moisture[zone] - moisture[0]));
+    }
+    appendEntry(entry, len);
+    logLastMoisture = moisture[0];
+    logLastTemp = temp;
+}
+
+void logValve(unsigned char zone, unsigned char open) {
+    unsigned char entry = (zone << 3) | ((open ? 1 : 0) << 2) | LOG_VALVE; // one byte for up to 8 zones
+
+    appendEntry(&entry, 1);
+}
+
+void logRefill(unsigned short used) { // 10 mL units, up to 16383
+    unsigned char entry[3];
+
+    if(used > 0x3FFF) {
+        used = 0x3FFF; // the entry type takes 2 of the 16 bits
+    }
+    appendEntry(entry, putVarint(entry, (used << 2) | LOG_REFILL));
+}
+
+void logReset(unsigned short cause) {
+    unsigned char entry[2];
+
+    appendEntry(entry, putVarint(entry, (cause << 2) | LOG_RESET)); // causes are below 0x40
+}
+
+void logDecodeBlock(const LogBlock *block, LogEntryFn entryFn) {
+    unsigned short idx = 0;
+    unsigned short moisture = block->moisture;
+    short temp = block->temp;
+    unsigned short first;
+    unsigned short second;
+    unsigned char zone;
+
+    while(idx < block->used) {
+        first = getVarint(block->data, &idx);
+        switch(first & 0x03) {
+            case LOG_SAMPLE:
+                moisture += unzigzag(first >> 2);
+                second = getVarint(block->data, &idx);
+                temp += unzigzag(second >> 3);
+                entryFn(LOG_SAMPLE, moisture, temp, 0);
+                for(zone = 1; zone <= (second & 0x07); zone++) { // the other zones, relative to zone 0
+                    entryFn(LOG_SAMPLE, moisture + unzigzag(getVarint(block->data, &idx)), temp, zone);
+                }
+                break;
+            case LOG_VALVE:
+            case LOG_REFILL:
+            case LOG_RESET:
+                entryFn(first & 0x03, moisture, temp, first >> 2);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void replayNextBlock() {
+    logReplayIdx = logReplayLen = 0;
+    while(logReplayLeft > 0) {
+        logReplayBlock = (logReplayBlock + 1) & (LOG_BLOCKS - 1);
+        logReplayLeft--;
+        if(logBlocks[logReplayBlock].magic == LOG_MAGIC) {
+            logReplayLen = 10 + logBlocks[logReplayBlock].used;
+            return;
+        }
+    }
+}
+
+void logReplayStart() { // send every block, oldest first, the one after the current block is the oldest
+    logReplayBlock = logCurrent - logBlocks;
+    logReplayLeft = LOG_BLOCKS;
+    replayNextBlock();
+    logReplayStep();
+}
+
+void logReplayStep() { // call when the protocol window frees up, sends as much of the log as it takes
+    unsigned char chunk[PROTO_PAYLOAD_MAX];
+    const unsigned char *bytes;
+    unsigned short idx;
+    unsigned char len;
+
+    while(logReplayIdx < logReplayLen) {
+        bytes = (const unsigned char *)&logBlocks[logReplayBlock];
+        chunk[0] = logReplayBlock;
+        chunk[1] = (unsigned char)logReplayIdx; // offset in the block, blocks are 256 bytes
+        len = 2;
+        for(idx = logReplayIdx; len < PROTO_PAYLOAD_MAX && idx < logReplayLen; idx++) {
+            chunk[len++] = bytes[idx];
+        }
+        if(!protoSend(PROTO_LOG, chunk, len)) {
+            return; // window full, try again after the next ACK
+        }
+        logReplayIdx = idx;
+        if(logReplayIdx >= logReplayLen) {
+            replayNextBlock();
+        }
+    }
+}
+
+unsigned char logReplaying() {
+    return logReplayIdx < logReplayLen;
+}
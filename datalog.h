@@ -0,0 +1,62 @@
+/*
+ datalog.h
+ Persistent sensor history in FRAM (.datalog section, see lnk_msp430fr2355.cmd), so readings are kept while the
+ ESP-01 link is down. The log is a ring of LOG_BLOCKS blocks; when it is full the oldest block is reused. Each
+ block header holds absolute moisture and temperature values and every entry after it is a delta, so a block
+ can be decoded on its own. Entries are varints (7 bits per byte, high bit set on all but the last byte):
+
+    sample  varint(zigzag(d moisture) << 2 | LOG_SAMPLE), varint(zigzag(d temp) << 3 | zones - 1),
+            then varint(zigzag(moisture - zone 0 moisture)) for each zone after zone 0
+    valve   varint(zone << 3 | open << 2 | LOG_VALVE), open is 0 closed or 1 open
+    refill  varint(water used since the last refill in 10 mL << 2 | LOG_REFILL)
+    reset   varint(SYSRSTIV cause << 2 | LOG_RESET), a reset other than power-up (supervisor.h)
+
+ A sample holds every zone (zone.h): zone 0 as a delta from its last logged value, the others as their
+ difference from zone 0, since pots in one place dry alike. Samples are logged at the first sample (sample.h) at
+ least LOG_PERIOD control cycles after the last one, and events land between the samples they happened between,
+ so a typical sample of one zone is 2 bytes and the 8 KB log holds a few weeks; each further zone adds 1 or 2
+ bytes. Temperatures are clamped to LOG_TEMP_MIN to LOG_TEMP_MAX so their delta fits 16 bits. logReplayStart()
+ sends the whole log, oldest block first, as PROTO_LOG frames (protocol.h) once the link is back. Their payload
+ is the block index, the byte offset in the block, then the raw block bytes, header first.
+ */
+
+#ifndef DATALOG_H_
+#define DATALOG_H_
+
+#define LOG_BLOCK_LEN 256 // bytes per block, header included
+#define LOG_BLOCKS 32 // 8 KB of FRAM
+#define LOG_PERIOD 600 // control cycles between logged samples, about 10 minutes
+#define LOG_MAGIC 0x4C47 // marks a block header as written
+#define LOG_ZONES_MAX 8 // zones one sample can hold, 3 bits in the entry
+#define LOG_TEMP_MIN (-2048) // tenths of a degree
+#define LOG_TEMP_MAX 2047
+
+// entry types, low 2 bits of an entry's first varint
+#define LOG_SAMPLE 0
+#define LOG_VALVE 1
+#define LOG_REFILL 2
+#define LOG_RESET 3
+
+typedef struct {
+    unsigned short magic; // LOG_MAGIC once the block has been started
+    unsigned short seq; // block sequence number, the highest one is being written
+    unsigned short used; // bytes of data holding entries
+    unsigned short moisture; // values the first sample delta in the block is taken from
+    short temp;
+    unsigned char data[LOG_BLOCK_LEN - 10];
+} LogBlock;
+
+// value is the zone of a LOG_SAMPLE, called once per zone; moisture and temp are zone 0's for other entries
+typedef void (*LogEntryFn)(unsigned char type, unsigned short moisture, short temp, unsigned short value);
+
+void logInit();
+void logSample(const unsigned short *moisture, unsigned char zones, short temp, unsigned short cycles);
+void logValve(unsigned char zone, unsigned char open);
+void logRefill(unsigned short used);
+void logReset(unsigned short cause);
+void logReplayStart();
+void logReplayStep();
+unsigned char logReplaying();
+void logDecodeBlock(const LogBlock *block, LogEntryFn entryFn);
+
+#endif /* DATALOG_H_ */
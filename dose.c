@@ -0,0 +1,95 @@
+#include "dose.h"
+
+#define DOSE_GAIN_INIT 40 // moisture drop per pulse assumed before the first dose has settled
+#define DOSE_GAIN_MIN 4 // keeps the dose size bounded when a dose shows no response
+#define DOSE_LAG_INIT 60 // control cycles before the probe responds, until measured
+
+const DoseConfig doseConfig = {
+    3, // 3 s open per pulse
+    4, // at most 4 pulses per dose
+    8, // +/- 8 counts is steady
+    10, // for 10 readings in a row
+    600, // give up after 10 minutes
+    2 // new measurement weighs 1/4
+};
+
+void doseInit(DoseState *state) {
+    state->state = DOSE_IDLE;
+    state->gain = DOSE_GAIN_INIT;
+    state->lag = DOSE_LAG_INIT;
+}
+
+static void doseLearn(DoseState *state, const DoseConfig *config, unsigned short moisture) {
+    short perPulse = ((short)(state->before - moisture)) / (short)state->pulses; // lower values is more moist
+
+    state->gain += (perPulse - state->gain) >> config->learnShift;
+    if(state->gain < DOSE_GAIN_MIN) {
+        state->gain = DOSE_GAIN_MIN;
+    }
+}
+
+unsigned char doseUpdate(DoseState *state, const DoseConfig *config, unsigned short moisture,
+                         unsigned short threshold, char dry, unsigned char flowing) {
+    // called once per control cycle with the filtered reading, returns 1 while the hatch should be open
+    unsigned short pulses;
+
+    switch(state->state) {
+        case DOSE_IDLE:
+            if(!dry) {
+                return 0;
+            }
+            // size the dose from how far past the threshold the soil is, rounded up
+            pulses = (moisture > threshold) ? (moisture - threshold + state->gain - 1) / state->gain : 1;
+            if(pulses > config->pulsesMax) {
+                pulses = config->pulsesMax;
+            } else if(pulses == 0) {
+                pulses = 1;
+            }
+            state->pulses = pulses;
+            state->openLeft = pulses * config->pulseCycles;
+            state->before = moisture;
+            state->state = DOSE_POURING;
+            return 1;
+
+        case DOSE_POURING:
+            if(flowing && --state->openLeft == 0) { // only fully open cycles count towards the volume
+                state->cycles = 0;
+                state->last = moisture;
+                state->steady = 0;
+                state->responding = 0;
+                state->state = DOSE_SETTLING;
+                return 0;
+            }
+            return 1;
+
+        case DOSE_SETTLING:
+            state->cycles++;
+            if(!state->responding && moisture + config->settleBand < state->before) { // water front reached the probe
+                state->responding = 1;
+                state->lag += ((short)state->cycles - (short)state->lag) >> config->learnShift;
+            }
+            // steady means staying within the band of where the run started, so a slow drift still counts as moving
+            if(state->responding && moisture <= state->last + config->settleBand && moisture + config->settleBand >= state->last) {
+                state->steady++;
+            } else {
+                state->steady = 0;
+                state->last = moisture;
+            }
+
+            // a steady reading only means settled once the probe has responded; no response in twice the
+            // usual lag means the water never arrived, e.g. an empty reservoir, so try again
+            if((state->responding && state->steady >= config->settleCycles)
+               || (!state->responding && state->cycles > (state->lag << 1) + config->settleCycles)
+               || state->cycles >= config->settleMax) {
+                if(state->responding) {
+                    doseLearn(state, config, moisture);
+                }
+                state->state = DOSE_IDLE;
+            }
+            return 0;
+
+        default:
+            state->state = DOSE_IDLE;
+            return 0;
+    }
+}
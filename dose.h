@@ -0,0 +1,51 @@
+/*
+ dose.h
+ Closed-loop watering. Instead of holding the hatch open until the probe reads wet, which overshoots because
+ the probe only sees the water front some time after it was poured, the soil is watered in fixed pulses and
+ then left to settle before the next decision. The pulse length counts only control cycles with the hatch
+ fully open, so every pulse is about the same volume however long the servo takes to move.
+
+ For each pot the controller learns two things from every dose, both as integer moving averages:
+    gain  moisture drop per pulse once settled, used to size the next dose in pulses
+    lag   control cycles from the end of a dose until the probe starts to respond, used to give up on a
+          dose that never reaches the probe instead of waiting the full settleMax
+ All state is fixed size; the only division is one per dose.
+ */
+
+#ifndef DOSE_H_
+#define DOSE_H_
+
+// controller states
+#define DOSE_IDLE 0 // watching for the soil to get too dry
+#define DOSE_POURING 1 // hatch open for the current dose
+#define DOSE_SETTLING 2 // hatch closed, waiting for the reading to stop moving
+
+typedef struct {
+    unsigned char pulseCycles; // control cycles the hatch stays fully open per pulse
+    unsigned char pulsesMax; // largest dose in pulses
+    unsigned short settleBand; // readings within this many ADC counts of each other count as steady
+    unsigned char settleCycles; // steady readings in a row before a dose has settled
+    unsigned short settleMax; // give up waiting after this many control cycles
+    unsigned char learnShift; // a new gain or lag measurement weighs 1/2^learnShift
+} DoseConfig;
+
+typedef struct {
+    unsigned char state; // DOSE_IDLE, DOSE_POURING or DOSE_SETTLING
+    unsigned char pulses; // pulses in the current dose
+    unsigned short openLeft; // fully open control cycles left in the current dose
+    unsigned short cycles; // control cycles since the hatch closed
+    unsigned short before; // reading when the dose started
+    unsigned short last; // reading the current steady run started at
+    unsigned char steady; // steady readings in a row since the probe responded
+    unsigned char responding; // 1 once the reading has started to drop
+    short gain; // learned moisture drop per pulse, ADC counts
+    unsigned short lag; // learned control cycles before the probe responds
+} DoseState;
+
+extern const DoseConfig doseConfig;
+
+void doseInit(DoseState *state);
+unsigned char doseUpdate(DoseState *state, const DoseConfig *config, unsigned short moisture,
+                         unsigned short threshold, char dry, unsigned char flowing);
+
+#endif /* DOSE_H_ */
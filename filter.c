@@ -0,0 +1,74 @@
+#include "filter.h"
+
+const FilterConfig moistureFilterConfig = {
+    3, // median of 3 drops single-reading spikes
+    2, // new reading weighs 1/4
+    40 // +/- 40 counts around moistureThres
+};
+
+void filterInit(FilterState *state) {
+    state->windowIdx = 0;
+    state->windowFill = 0;
+    state->iirAcc = 0;
+    state->dry = 0;
+}
+
+static unsigned short filterMedian(const unsigned short *window, unsigned char len) {
+    unsigned short sorted[FILTER_MEDIAN_MAX];
+    unsigned short value;
+    unsigned char idx, pos;
+
+    for(idx = 0; idx < len; idx++) { // insertion sort, at most FILTER_MEDIAN_MAX readings
+        value = window[idx];
+        pos = idx;
+        while(pos > 0 && sorted[pos - 1] > value) {
+            sorted[pos] = sorted[pos - 1];
+            pos--;
+        }
+        sorted[pos] = value;
+    }
+    return sorted[len >> 1];
+}
+
+unsigned short filterUpdate(FilterState *state, const FilterConfig *config, unsigned short reading) {
+    unsigned short value = reading;
+
+    // median-of-N spike rejection
+    if(config->medianLen > 1) {
+        state->window[state->windowIdx] = reading;
+        state->windowIdx++;
+        if(state->windowIdx >= config->medianLen) {
+            state->windowIdx = 0;
+        }
+        if(state->windowFill < config->medianLen) {
+            state->windowFill++;
+        }
+        if(state->windowFill >= config->medianLen) { // use the raw reading until the window is full
+            value = filterMedian(state->window, config->medianLen);
+        }
+    }
+
+    // IIR, acc holds value << iirShift so no precision is lost between readings
+    if(config->iirShift > 0) {
+        if(state->iirAcc == 0) { // first reading, start the filter at it instead of ramping up from 0
+            state->iirAcc = (unsigned long)value << config->iirShift;
+        } else {
+            state->iirAcc += value - (state->iirAcc >> config->iirShift);
+        }
+        value = state->iirAcc >> config->iirShift;
+    }
+
+    return value;
+}
+
+char filterDry(FilterState *state, const FilterConfig *config, unsigned short value, unsigned short threshold) {
+    // lower values is more moist, so only switch once the value is clearly past the threshold
+    if(state->dry) {
+        if(value + config->hysteresis < threshold) {
+            state->dry = 0;
+        }
+    } else if(value > threshold + config->hysteresis) {
+        state->dry = 1;
+    }
+    return state->dry;
+}
@@ -0,0 +1,35 @@
+/*
+ filter.h
+ Streaming filter between the ADC and the watering decision. Oversampling and decimation is done by the ADC
+ ring (adc.h); each decimated reading then goes through a median-of-N spike rejector and an integer IIR
+ (exponential moving average with a power-of-two weight), and the watering decision uses a hysteresis band
+ around the threshold so a noisy reading near it does not chatter the servo. All state is fixed size and the
+ hot path only uses adds, compares and shifts.
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#define FILTER_MEDIAN_MAX 5 // largest median window
+
+typedef struct {
+    unsigned char medianLen; // median window, odd and no more than FILTER_MEDIAN_MAX; 1 disables
+    unsigned char iirShift; // IIR weight of a new reading is 1/2^iirShift; 0 disables
+    unsigned short hysteresis; // half width of the band around the threshold, in ADC counts
+} FilterConfig;
+
+typedef struct {
+    unsigned short window[FILTER_MEDIAN_MAX]; // last readings for the median
+    unsigned char windowIdx; // oldest reading in window
+    unsigned char windowFill; // readings in window so far
+    unsigned long iirAcc; // filtered value scaled by 2^iirShift
+    char dry; // hysteresis output, 1 while the soil counts as too dry
+} FilterState;
+
+extern const FilterConfig moistureFilterConfig;
+
+void filterInit(FilterState *state);
+unsigned short filterUpdate(FilterState *state, const FilterConfig *config, unsigned short reading);
+char filterDry(FilterState *state, const FilterConfig *config, unsigned short value, unsigned short threshold);
+
+#endif /* FILTER_H_ */
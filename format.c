@@ -0,0 +1,56 @@
+#include "format.h"
+
+static const unsigned long fmtPow10[FMT_DIGITS_MAX] = {
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL, 10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
+unsigned char fmtText(char *dest, const char *text) { // copies text without its NUL
+    unsigned char len = 0;
+
+    while(text[len] != '\0') {
+        dest[len] = text[len];
+        len++;
+    }
+    return len;
+}
+
+unsigned char fmtUnsigned(char *dest, unsigned long num, unsigned char minDigits) { // zero padded to minDigits
+    unsigned char len = 0;
+    unsigned char idx;
+    char digit;
+
+    if(minDigits == 0) {
+        minDigits = 1; // 0 is still written as "0"
+    }
+    for(idx = 0; idx < FMT_DIGITS_MAX; idx++) { // most significant digit first
+        digit = '0';
+        while(num >= fmtPow10[idx]) {
+            num -= fmtPow10[idx];
+            digit++;
+        }
+        if(len > 0 || digit != '0' || idx >= FMT_DIGITS_MAX - minDigits) { // skip leading zeros
+            dest[len++] = digit;
+        }
+    }
+    return len;
+}
+
+unsigned char fmtFixed(char *dest, long num, unsigned char decimals) { // num in units of 10^-decimals
+    unsigned long mag = (unsigned long)num;
+    unsigned char len = 0;
+    unsigned char idx;
+
+    if(num < 0) {
+        dest[len++] = '-';
+        mag = 0UL - mag;
+    }
+    len += fmtUnsigned(&dest[len], mag, decimals + 1); // at least one integer digit
+    if(decimals == 0) {
+        return len;
+    }
+    for(idx = len; idx > len - decimals; idx--) { // open a gap for the point
+        dest[idx] = dest[idx - 1];
+    }
+    dest[len - decimals] = '.';
+    return len + 1;
+}
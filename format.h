@@ -0,0 +1,20 @@
+/*
+ format.h
+ Allocation-free decimal formatting for text output, in place of sprintf. Numbers are written into a caller
+ buffer and every function returns the number of characters written, so only the real payload is sent and
+ no NUL is needed. Digits are found by subtracting powers of ten, at most 9 subtractions per digit and no
+ 32-bit division, so formatting a number takes a bounded time: at most FMT_DIGITS_MAX * 9 compare and
+ subtract steps.
+ */
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#define FMT_DIGITS_MAX 10 // digits of the largest unsigned long
+#define FMT_FIXED_MAX (FMT_DIGITS_MAX + 3) // longest fmtFixed() result: sign, digits, point and a leading 0
+
+unsigned char fmtText(char *dest, const char *text);
+unsigned char fmtUnsigned(char *dest, unsigned long num, unsigned char minDigits);
+unsigned char fmtFixed(char *dest, long num, unsigned char decimals);
+
+#endif /* FORMAT_H_ */
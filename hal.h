@@ -0,0 +1,367 @@
+/*
+ hal.h
+ Thin hardware-abstraction layer for the watering controller: clocks, watchdog, GPIO (LEDs, buttons, chip
+ selects), ADC, timers, UART, SPI, the CRC module, the TLV calibration record and interrupt control. The modules
+ call these instead of touching registers, peripheral setup and interrupt handlers included; they only
+ include hal.h, never msp430.h. spi.c includes hal_spi.h, the target-neutral part with interrupt control and
+ SPI, so it also builds for the FR5969 BME280 demo. Interrupt handlers are declared with HAL_ISR() and read their vector with the
+ halXxxIv() functions, and HAL_WAKE_ON_EXIT() leaves the low-power mode the CPU was woken from.
+
+ On the MSP430FR2355 (__MSP430__ defined) all functions are static inline, so they compile to the same
+ register accesses as before. Anywhere else hal_host.h declares them instead and a host backend implements
+ them; host/sim/hal_sim.c backs them with simulated peripherals and a plant model (host/sim/plant.h). The
+ host build puts a shim msp430.h first on the include path, which supplies the bit and field constants the
+ modules use (BIT0, ADCINCH_1, OUTMOD_7, ...) but no registers.
+
+ Pin use:
+    P1.0  red LED (water empty)
+    P1.1  moisture sensor of zone 0, ADC A1; other zones see zone.h
+    P1.5  BME280 chip select
+    P2.3  moisture threshold button
+    P4.1  water level reset button
+    P4.2, P4.3  UCA1 UART to the ESP-01
+    P6.3  servo PWM of zone 0, TB3.4 (servo channel 3); other zones see zone.h
+    P6.6  green LED (temperature OK)
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <msp430.h>
+
+#include "hal_spi.h" // interrupt control and SPI, also used on the FR5969
+
+// TLV addresses, device datasheet "Device Descriptors"
+#define HAL_TLV_DIE_RECORD 0x1A0A // lot/wafer ID, die X and die Y, 8 bytes
+#define HAL_TLV_ADC_30C 0x1A1A // temperature sensor ADC reading at 30C, 1.5 V reference
+#define HAL_TLV_ADC_85C 0x1A1C // same at 85C
+
+#ifndef __MSP430__
+#include "hal_host.h"
+#else
+
+#include "clock.h"
+
+// clock system
+
+static inline void halClockInit(unsigned short dcorsel, unsigned short flln, unsigned short nwaits, unsigned short tries) {
+    FRCTL0 = FRCTLPW | nwaits; // wait states before MCLK goes up
+
+    __bis_SR_register(SCG0); // FLL off while it is set up
+    CSCTL3 = SELREF__REFOCLK; // FLL reference is REFO
+    CSCTL0 = 0; // DCO tap and modulation start from the bottom of the range
+    CSCTL1 = (CSCTL1 & ~DCORSEL) | dcorsel; // DCO range, trim settings kept
+    CSCTL2 = FLLD_0 | flln; // DCOCLKDIV = (FLLN + 1) * REFO
+    __delay_cycles(3);
+    __bic_SR_register(SCG0); // FLL on
+    while((CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1)) && tries > 0) { // bounded, an unlocked DCO is still near the range
+        tries--;
+    }
+
+    CSCTL4 = SELMS__DCOCLKDIV | SELA__REFOCLK; // ACLK from REFO, the tick keeps running in LPM3 and keeps time
+}
+
+static inline void halClockDivide(unsigned short divm, unsigned short divs) { // DIVM__x and DIVS__x
+    CSCTL5 = (CSCTL5 & ~(DIVM | DIVS)) | divm | divs;
+}
+
+// reset and watchdog
+
+static inline unsigned short halResetCause() { // highest priority SYSRSTIV cause, clears the others
+    unsigned short cause = SYSRSTIV;
+
+    while(SYSRSTIV != SYSRSTIV_NONE) { // reading clears the flag, read until all pending causes are gone
+    }
+    return cause;
+}
+
+static inline void halWatchdogSet(unsigned short ctl) { // WDTCTL without the password, writing WDTCNTCL restarts the count
+    WDTCTL = WDTPW | ctl;
+}
+
+// TLV and CRC
+
+static inline unsigned short halTlvWord(unsigned short addr) {
+    return *(const unsigned short *)addr;
+}
+
+static inline unsigned short halCrc16(const unsigned char *data, unsigned char len) { // CRC-16/CCITT-FALSE
+    unsigned char idx;
+
+    CRCINIRES = 0xFFFF;
+    for(idx = 0; idx < len; idx++) {
+        CRCDIRB_L = data[idx]; // bit reversed input gives the usual MSB first CCITT result
+    }
+    return CRCINIRES;
+}
+
+// GPIO
+
+static inline void halGpioInit() { // buttons, LEDs, then the pins leave their high-impedance power-on state
+    // button, P2.3
+    P2DIR &= ~BIT3; // set P2.3 to input
+    P2REN |= BIT3; // enable P2.3 resistor
+    P2OUT |= BIT3; // set P2.3 resistor to pull-up
+    P2IES |= BIT3; // P2.3 High -> Low edge
+
+    // button, P4.1
+    P4DIR &= ~BIT1; // set P4.1 to input
+    P4REN |= BIT1; // enable P4.1 resistor
+    P4OUT |= BIT1; // set P4.1 resistor to pull-up
+    P4IES |= BIT1; // P4.1 High -> Low edge
+
+    // red LED, P1.0
+    P1OUT &= ~BIT0; // Clear P1.0 output latch for a defined power-on state
+    P1DIR |= BIT0; // Set P1.0 to output direction
+
+    // green LED, P6.6
+    P6OUT |= BIT6; // start P6.6 on
+    P6DIR |= BIT6; // Set P6.6 to output direction
+
+    PM5CTL0 &= ~LOCKLPM5; // disable the GPIO power-on default high-impedance mode
+}
+
+static inline void halLedRed(unsigned char on) {
+    if(on) {
+        P1OUT |= BIT0;
+    } else {
+        P1OUT &= ~BIT0;
+    }
+}
+
+static inline void halLedGreen(unsigned char on) {
+    if(on) {
+        P6OUT |= BIT6;
+    } else {
+        P6OUT &= ~BIT6;
+    }
+}
+
+static inline unsigned char halLedGreenIsOn() {
+    return (P6OUT & BIT6) != 0;
+}
+
+static inline unsigned char halThresButtonDown() { // pulled up, pressed pulls low
+    return !(P2IN & BIT3);
+}
+
+static inline unsigned char halRefillButtonDown() {
+    return !(P4IN & BIT1);
+}
+
+static inline void halButtonIrq(unsigned char on) { // High -> Low edges of both buttons, set up in halGpioInit()
+    if(on) {
+        P2IFG &= ~BIT3;
+        P4IFG &= ~BIT1;
+        P2IE |= BIT3;
+        P4IE |= BIT1;
+    } else {
+        P2IE &= ~BIT3;
+        P4IE &= ~BIT1;
+    }
+}
+
+static inline void halThresButtonAck() { // in the port interrupt
+    P2IFG &= ~BIT3;
+}
+
+static inline void halRefillButtonAck() {
+    P4IFG &= ~BIT1;
+}
+
+// ADC
+
+static inline void halAdcPin(unsigned char input) { // analog function for input A0-A11; A0-A7 are P1.0-P1.7, A8-A11 are P5.0-P5.3
+    if(input < 8) {
+        P1SEL0 |= 1 << input;
+        P1SEL1 |= 1 << input;
+    } else {
+        P5SEL0 |= 1 << (input - 8);
+        P5SEL1 |= 1 << (input - 8);
+    }
+}
+
+static inline void halAdcInit(unsigned short mctl) { // 12-bit software triggered conversions, first channel mctl
+    ADCCTL0 |= ADCSHT_8 | ADCON; // ADC ON, sample period>30us, long enough for the temperature sensor after a channel switch
+    ADCCTL1 |= ADCSHP;  // software trigger, single channel conversion, MODOSC
+    ADCCTL2 &= ~ADCRES;  // clear ADCRES in ADCCTL
+    ADCCTL2 |= ADCRES_2;  // 12-bit conversion results
+    ADCMCTL0 = mctl;
+    ADCIE |= ADCIE0; // enable the interrupt request for a completed ADC_B conversion
+
+    // Configure reference once, it stays on for every sequence
+    PMMCTL0_H = PMMPW_H; // unlock the PMM registers
+    PMMCTL2 |= INTREFEN | TSENSOREN; // enable internal reference and temperature sensor
+    __delay_cycles(CLOCK_DELAY_US(400));  // delay for reference settling
+}
+
+static inline void halAdcSelect(unsigned short mctl) { // reference and input channel, ADCMCTL0 bits
+    ADCCTL0 &= ~ADCENC; // ADCMCTL0 can only be changed while conversion is disabled
+    ADCMCTL0 = mctl;
+}
+
+static inline void halAdcStart() {
+    ADCCTL0 |= ADCENC | ADCSC; // sampling and conversion start
+}
+
+static inline unsigned short halAdcResult() {
+    return ADCMEM0; // reading ADCMEM0 clears ADCIFG0
+}
+
+static inline unsigned short halAdcIv() {
+    return __even_in_range(ADCIV, ADCIV_ADCIFG);
+}
+
+// tick timer, Timer_B0 on ACLK; CCR0 is the control tick, CCR1 a spare alarm within the tick period
+
+static inline void halTickStart(unsigned short period) { // CCR0 interrupt every period + 1 ACLK counts
+    TB0CCR0 = period;
+    TB0CCTL0 = CCIE;
+    TB0CTL = TBSSEL_1 | MC_1 | TBCLR; // ACLK, up mode
+}
+
+static inline void halTickAlarm(unsigned short at) { // CCR1 interrupt when TB0R reaches at
+    TB0CCR1 = at;
+    TB0CCTL1 = CCIE;
+}
+
+static inline void halTickAlarmOff() {
+    TB0CCTL1 = 0;
+}
+
+static inline unsigned short halTickCount() { // ACLK is asynchronous to MCLK, read until two reads agree
+    unsigned short count;
+
+    do {
+        count = TB0R;
+    } while(count != TB0R);
+    return count;
+}
+
+static inline unsigned short halTickIv() {
+    return __even_in_range(TB0IV, TB0IV_TBIFG);
+}
+
+// profiling timer, Timer_B1 free running on SMCLK
+
+static inline void halProfStart() {
+    TB1CTL = TBSSEL_2 | MC_2 | TBCLR; // SMCLK, continuous mode
+}
+
+static inline unsigned short halProfCount() { // SMCLK is MCLK divided, one read is enough
+    return TB1R;
+}
+
+// timer PWM, servo channels 0-5 on TB3.1-TB3.6 (P6.0-P6.5), 6-7 on TB2.1-TB2.2 (P5.0-P5.1)
+
+static inline void halPwmOutputs(unsigned char channels, unsigned short mode) { // OUTMOD_x of the channels set in channels
+    if(channels & BIT0) TB3CCTL1 = mode;
+    if(channels & BIT1) TB3CCTL2 = mode;
+    if(channels & BIT2) TB3CCTL3 = mode;
+    if(channels & BIT3) TB3CCTL4 = mode;
+    if(channels & BIT4) TB3CCTL5 = mode;
+    if(channels & BIT5) TB3CCTL6 = mode;
+    if(channels & BIT6) TB2CCTL1 = mode;
+    if(channels & BIT7) TB2CCTL2 = mode;
+}
+
+static inline void halPwmInit(unsigned char channels, unsigned short period, unsigned short id) {
+    // PWM pins of the channels in use, second function
+    P6OUT &= ~(channels & 0x3F);
+    P6DIR |= channels & 0x3F;
+    P6SEL0 |= channels & 0x3F;
+    P6SEL1 &= ~(channels & 0x3F);
+    P5OUT &= ~((channels >> 6) & 0x03);
+    P5DIR |= (channels >> 6) & 0x03;
+    P5SEL0 |= (channels >> 6) & 0x03;
+    P5SEL1 &= ~((channels >> 6) & 0x03);
+
+    halPwmOutputs(0xFF, OUTMOD_0); // outputs held low, OUT clear
+    TB3CCR0 = period;
+    TB2CCR0 = period;
+    TB3CCTL0 = 0; // period interrupt off
+    TB3CTL = TBSSEL_2 | id | MC_0 | TBCLR; // SMCLK / ID__x, halted until halPwmRun()
+    TB2CTL = TBSSEL_2 | id | MC_0 | TBCLR;
+}
+
+static inline void halPwmRun(unsigned char on) { // both PWM timers, restarted together so their periods line up
+    if(on) {
+        TB3CTL = (TB3CTL & ~MC) | MC_1 | TBCLR;
+        TB2CTL = (TB2CTL & ~MC) | MC_1 | TBCLR;
+    } else {
+        TB3CTL &= ~MC;
+        TB2CTL &= ~MC;
+    }
+}
+
+static inline void halPwmSet(unsigned char channel, unsigned short width) {
+    switch(channel) {
+        case 0: TB3CCR1 = width; break;
+        case 1: TB3CCR2 = width; break;
+        case 2: TB3CCR3 = width; break;
+        case 3: TB3CCR4 = width; break;
+        case 4: TB3CCR5 = width; break;
+        case 5: TB3CCR6 = width; break;
+        case 6: TB2CCR1 = width; break;
+        case 7: TB2CCR2 = width; break;
+        default: break;
+    }
+}
+
+static inline void halPwmPeriodIrq(unsigned char on) { // TB3 CCR0 interrupt at the start of every period
+    if(on) {
+        TB3CCTL0 = CCIE;
+    } else {
+        TB3CCTL0 &= ~CCIE;
+    }
+}
+
+// UART, eUSCI_A1
+
+static inline void halUartInit(unsigned short brw, unsigned short mctlw) { // SMCLK, dividers from uartDividers()
+    // configure UART pins
+    P4SEL0 |= BIT2 | BIT3; // set 2-UART pin as second function
+    P4SEL1 &= ~BIT2; // set 2-UART pin as second function
+    P4SEL1 &= ~ BIT3; // set 2-UART pin as second function
+
+    // configure eUSCI_A1 for UART
+    UCA1CTLW0 |= UCSWRST;
+    UCA1CTLW0 |= UCSSEL__SMCLK;
+    UCA1BRW = brw;
+    UCA1MCTLW = mctlw;
+    UCA1CTLW0 &= ~UCSWRST; // Initialize eUSCI
+    UCA1IE |= UCRXIE; // Enable USCI_A1 RX interrupt
+}
+
+static inline void halUartPut(unsigned char byte) {
+    UCA1TXBUF = byte;
+}
+
+static inline unsigned char halUartGet() {
+    return UCA1RXBUF;
+}
+
+static inline void halUartTxIrq(unsigned char on) { // transmit buffer empty interrupt
+    if(on) {
+        UCA1IE |= UCTXIE;
+    } else {
+        UCA1IE &= ~UCTXIE;
+    }
+}
+
+static inline void halUartTxDoneIrq(unsigned char on) { // last byte left the shift register
+    if(on) {
+        UCA1IFG &= ~UCTXCPTIFG;
+        UCA1IE |= UCTXCPTIE;
+    } else {
+        UCA1IE &= ~UCTXCPTIE;
+    }
+}
+
+static inline unsigned short halUartIv() {
+    return __even_in_range(UCA1IV, USCI_UART_UCTXCPTIFG);
+}
+
+#endif /* __MSP430__ */
+
+#endif /* HAL_H_ */
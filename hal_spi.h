@@ -0,0 +1,98 @@
+/*
+ hal_spi.h
+ The part of hal.h that spi.c needs: interrupt control, sleep, HAL_ISR() and eUSCI_B0 as SPI master with chip
+ selects on P1. These registers are the same on the MSP430FR2355 and the FR5969, so unlike the rest of hal.h,
+ which is FR2355 only (clock.h, Timer_B, ADC, P5/P6), this header also builds for the FR5969 BME280 demo
+ (BME280_FR.c). hal.h includes it; other builds get the same functions from hal_host.h.
+ */
+
+#ifndef HAL_SPI_H_
+#define HAL_SPI_H_
+
+#include <msp430.h>
+
+#ifndef __MSP430__
+#include "hal_host.h"
+#else
+
+#define HAL_PRAGMA(x) _Pragma(#x)
+#define HAL_ISR(vec, name) HAL_PRAGMA(vector=vec) __interrupt void name(void)
+#define HAL_WAKE_ON_EXIT() __bic_SR_register_on_exit(LPM3_bits) // only valid in a HAL_ISR() body
+
+// interrupt control and low-power modes
+
+static inline unsigned short halIrqSave() { // disables interrupts, returns the state for halIrqRestore()
+    unsigned short state = __get_interrupt_state();
+
+    __disable_interrupt();
+    return state;
+}
+
+static inline void halIrqRestore(unsigned short state) {
+    __set_interrupt_state(state);
+}
+
+static inline void halIrqOff() {
+    __disable_interrupt();
+}
+
+static inline void halIrqOn() {
+    __enable_interrupt();
+}
+
+static inline void halSleep(unsigned char deep) { // call with interrupts off, returns with them off again
+    if(deep) {
+        __bis_SR_register(LPM3_bits | GIE); // enable and sleep in one instruction, no wake-up can be missed
+    } else {
+        __bis_SR_register(LPM0_bits | GIE); // SMCLK keeps running
+    }
+    __disable_interrupt();
+}
+
+// SPI, eUSCI_B0
+
+static inline void halSpiSelect(unsigned char pin) { // P1 chip select, active low
+    P1OUT &= ~pin;
+}
+
+static inline void halSpiDeselect(unsigned char pin) {
+    P1OUT |= pin;
+}
+
+static inline void halSpiInit(unsigned short brw) { // 3-pin master, SMCLK / brw
+    UCB0CTLW0 |= UCSWRST;
+    UCB0CTLW0 |= UCSSEL__SMCLK + UCMODE_0 + UCMST + UCSYNC + UCMSB + UCCKPH;
+    UCB0BRW = brw;
+}
+
+static inline void halSpiEnable(unsigned char on) {
+    if(on) {
+        UCB0CTL1 &= ~UCSWRST; //Start USCI
+    } else {
+        UCB0CTL1 |= UCSWRST; //Stop USCI
+    }
+}
+
+static inline void halSpiPut(unsigned char byte) {
+    UCB0TXBUF = byte;
+}
+
+static inline unsigned char halSpiGet() {
+    return UCB0RXBUF; //Read buffer to clear RX flag
+}
+
+static inline void halSpiRxIrq(unsigned char on) { // a byte has been clocked in, so the next can be sent
+    if(on) {
+        UCB0IE |= UCRXIE;
+    } else {
+        UCB0IE &= ~UCRXIE;
+    }
+}
+
+static inline unsigned short halSpiIv() {
+    return __even_in_range(UCB0IV, USCI_SPI_UCTXIFG);
+}
+
+#endif /* __MSP430__ */
+
+#endif /* HAL_SPI_H_ */
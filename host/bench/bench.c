@@ -0,0 +1,377 @@
+/*
+ bench.c
+ Host timings of the firmware's sensor math and encoding kernels, the baseline later optimizations are measured
+ against. Each kernel runs over a table of varied inputs until BENCH_RUN_NS has passed, five times, and the
+ fastest run gives its ns per operation. Given the nm -S listing of the firmware library, the size of each
+ kernel's code is printed next to it; static inline helpers are counted in the functions they are inlined into.
+ Next to a kernel that replaced older code, that code is timed as the baseline, built into bench itself (whose
+ own listing report.cmake adds): tempFromAdcFloat is main()'s float calTemp formula before the table, and
+ sprintfUnsigned and sprintfFixed are the sprintf() calls of the BME280 demo before format.h. The host does
+ float in hardware, while the MSP430 calls the compiler's float routines, and the code of those routines and of
+ sprintf itself (a few KB on the chip) is not in the baselines' code bytes.
+
+    bench [-q] [nm listing]
+
+ -q is a quick run for ctest. The numbers are for the host build, not the MSP430: they show whether a change
+ made a kernel faster or smaller, not how long it takes on the chip (prof.h measures that on the target).
+ "make bench_report" (report.cmake) writes host/bench/report.txt, headed by the machine it ran on; its ns/op
+ only compare with numbers from the same machine and compiler.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "BME280.h"
+#include "datalog.h"
+#include "filter.h"
+#include "format.h"
+#include "tempsense.h"
+#include "uart.h"
+
+#define BENCH_INPUTS 1024 // inputs per table, a power of two
+#define BENCH_RUN_NS 50000000ULL // length of one timed run
+#define BENCH_RUNS 5
+#define BENCH_BATCH 64 // readings per BME280CompensateBatch() call
+
+#ifndef BENCH_BUILD
+#define BENCH_BUILD "" // CMAKE_BUILD_TYPE
+#endif
+#ifndef BENCH_COMPILER
+#define BENCH_COMPILER "" // CMAKE_C_COMPILER_ID
+#endif
+
+typedef unsigned long (*BenchFn)(unsigned long ops); // runs ops operations, returns a checksum
+
+typedef struct {
+    const char *name; // the function's symbol
+    BenchFn fn;
+    const char *op; // what one operation is
+} Kernel;
+
+static unsigned short adcIn[BENCH_INPUTS];
+static unsigned long numIn[BENCH_INPUTS];
+static long fixedIn[BENCH_INPUTS];
+static int32_t rawT[BENCH_INPUTS], rawP[BENCH_INPUTS], rawH[BENCH_INPUTS];
+static BME280Cal cal = {
+    BME280_CAL_MAGIC, 0x10, 75, 0, 30, 27504, 36477, 26435, -1000,
+    -10685, 3024, 2855, 140, -7, 15500, -14600, 6000, 362, 324, 0
+};
+static LogBlock benchBlock;
+static volatile unsigned long sink; // keeps the checksums, and so the work, alive
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static unsigned long benchTempLutBuild(unsigned long ops) {
+    unsigned long idx;
+
+    for(idx = 0; idx < ops; idx++) {
+        tempLutBuild(1900 + (idx & 63), 2300 + (idx & 63));
+    }
+    return (unsigned long)tempFromAdc(2000);
+}
+
+static unsigned long benchTempFromAdc(unsigned long ops) {
+    unsigned long idx, sum = 0;
+
+    for(idx = 0; idx < ops; idx++) {
+        sum += (unsigned short)tempFromAdc(adcIn[idx & (BENCH_INPUTS - 1)]);
+    }
+    return sum;
+}
+
+static unsigned short benchCal30 = 1950, benchCal85 = 2335; // TLV points for the float baseline
+
+static __attribute__((noinline)) short tempFromAdcFloat(unsigned short adc) { // baseline, tenths of a degree celsius
+    float calTemp = (float)((long)adc - benchCal30) * (85 - 30) / (benchCal85 - benchCal30) + 30;
+
+    return (short)(calTemp * 10);
+}
+
+static unsigned long benchTempFromAdcFloat(unsigned long ops) {
+    unsigned long idx, sum = 0;
+
+    for(idx = 0; idx < ops; idx++) {
+        sum += (unsigned short)tempFromAdcFloat(adcIn[idx & (BENCH_INPUTS - 1)]);
+    }
+    return sum;
+}
+
+static unsigned long benchFmtUnsigned(unsigned long ops) {
+    char text[FMT_DIGITS_MAX];
+    unsigned long idx, sum = 0;
+
+    for(idx = 0; idx < ops; idx++) {
+        sum += fmtUnsigned(text, numIn[idx & (BENCH_INPUTS - 1)], 1) + text[0];
+    }
+    return sum;
+}
+
+static unsigned long benchFmtFixed(unsigned long ops) {
+    char text[FMT_FIXED_MAX];
+    unsigned long idx, sum = 0;
+
+    for(idx = 0; idx < ops; idx++) {
+        sum += fmtFixed(text, fixedIn[idx & (BENCH_INPUTS - 1)], 2) + text[0];
+    }
+    return sum;
+}
+
+static __attribute__((noinline)) int sprintfUnsigned(char *text, unsigned long num) { // baseline
+    return sprintf(text, "%lu", num);
+}
+
+static __attribute__((noinline)) int sprintfFixed(char *text, long num) { // baseline, 2 decimals like the demo
+    unsigned long mag = num < 0 ? -(unsigned long)num : (unsigned long)num;
+
+    return sprintf(text, "%s%lu.%.2lu", num < 0 ? "-" : "", mag / 100, mag % 100);
+}
+
+static unsigned long benchSprintfUnsigned(unsigned long ops) {
+    char text[FMT_DIGITS_MAX + 1];
+    unsigned long idx, sum = 0;
+
+    for(idx = 0; idx < ops; idx++) {
+        sum += sprintfUnsigned(text, numIn[idx & (BENCH_INPUTS - 1)]) + text[0];
+    }
+    return sum;
+}
+
+static unsigned long benchSprintfFixed(unsigned long ops) {
+    char text[FMT_FIXED_MAX + 1];
+    unsigned long idx, sum = 0;
+
+    for(idx = 0; idx < ops; idx++) {
+        sum += sprintfFixed(text, fixedIn[idx & (BENCH_INPUTS - 1)]) + text[0];
+    }
+    return sum;
+}
+
+static unsigned long benchCalcTemp(unsigned long ops) {
+    BME280 dev = {0};
+    unsigned long idx, sum = 0;
+
+    dev.cal = &cal;
+    for(idx = 0; idx < ops; idx++) {
+        dev.RawTemp = rawT[idx & (BENCH_INPUTS - 1)];
+        sum += (unsigned long)CalcTemp(&dev);
+    }
+    return sum;
+}
+
+static unsigned long benchCalcHumid(unsigned long ops) {
+    BME280 dev = {0};
+    unsigned long idx, sum = 0;
+
+    dev.cal = &cal;
+    for(idx = 0; idx < ops; idx++) {
+        dev.t_fine = rawT[idx & (BENCH_INPUTS - 1)] >> 2;
+        dev.RawHumid = rawH[idx & (BENCH_INPUTS - 1)];
+        sum += CalcHumid(&dev);
+    }
+    return sum;
+}
+
+static unsigned long benchCalcPress(unsigned long ops) {
+    BME280 dev = {0};
+    unsigned long idx, sum = 0;
+
+    dev.cal = &cal;
+    for(idx = 0; idx < ops; idx++) {
+        dev.t_fine = rawT[idx & (BENCH_INPUTS - 1)] >> 2;
+        dev.RawPress = rawP[idx & (BENCH_INPUTS - 1)];
+        sum += CalcPress(&dev);
+    }
+    return sum;
+}
+
+static unsigned long benchCompensateBatch(unsigned long ops) { // ops readings, BENCH_BATCH at a time
+    static int32_t temp[BENCH_BATCH];
+    static uint32_t press[BENCH_BATCH], humid[BENCH_BATCH];
+    unsigned long idx, first, sum = 0;
+
+    for(idx = 0; idx < ops; idx += BENCH_BATCH) {
+        first = idx & (BENCH_INPUTS - 1) & ~(BENCH_BATCH - 1UL);
+        BME280CompensateBatch(&cal, &rawT[first], &rawP[first], &rawH[first], temp, press, humid, BENCH_BATCH);
+        sum += (unsigned long)temp[0] + press[BENCH_BATCH - 1] + humid[1];
+    }
+    return sum;
+}
+
+static unsigned long benchFilterUpdate(unsigned long ops) {
+    FilterState state;
+    unsigned long idx, sum = 0;
+
+    filterInit(&state);
+    for(idx = 0; idx < ops; idx++) {
+        sum += filterUpdate(&state, &moistureFilterConfig, adcIn[idx & (BENCH_INPUTS - 1)]);
+    }
+    return sum;
+}
+
+static unsigned long benchLogSample(unsigned long ops) { // one logged sample, small deltas like the soil gives
+    unsigned long idx;
+    unsigned short moisture;
+
+    for(idx = 0; idx < ops; idx++) {
+        moisture = (unsigned short)(1500 + (adcIn[idx & (BENCH_INPUTS - 1)] & 31));
+        logSample(&moisture, 1, (short)(210 + (idx & 7)), LOG_PERIOD);
+    }
+    return ops;
+}
+
+static unsigned long decodedSum;
+
+static void decodedEntry(unsigned char type, unsigned short moisture, short temp, unsigned short value) { // LogEntryFn
+    decodedSum += type + moisture + (unsigned short)temp + value;
+}
+
+static unsigned long benchLogDecodeBlock(unsigned long ops) { // one entry of a full block of samples
+    unsigned long entries = 0;
+
+    decodedSum = 0;
+    while(entries < ops) {
+        logDecodeBlock(&benchBlock, decodedEntry);
+        entries += benchBlock.used / 2; // two bytes per sample, see benchInputs()
+    }
+    return decodedSum;
+}
+
+static unsigned long benchUartDividers(unsigned long ops) {
+    unsigned short brw, mctlw;
+    unsigned long idx, sum = 0;
+
+    for(idx = 0; idx < ops; idx++) {
+        uartDividers(1000000UL + (idx & 0xFFFF) * 300UL, UART_BAUD, &brw, &mctlw);
+        sum += brw + mctlw;
+    }
+    return sum;
+}
+
+static const Kernel kernels[] = {
+    {"tempLutBuild", benchTempLutBuild, "table"},
+    {"tempFromAdc", benchTempFromAdc, "reading"},
+    {"tempFromAdcFloat", benchTempFromAdcFloat, "reading"},
+    {"fmtUnsigned", benchFmtUnsigned, "number"},
+    {"sprintfUnsigned", benchSprintfUnsigned, "number"},
+    {"fmtFixed", benchFmtFixed, "number"},
+    {"sprintfFixed", benchSprintfFixed, "number"},
+    {"CalcTemp", benchCalcTemp, "reading"},
+    {"CalcHumid", benchCalcHumid, "reading"},
+    {"CalcPress", benchCalcPress, "reading"},
+    {"BME280CompensateBatch", benchCompensateBatch, "reading"},
+    {"filterUpdate", benchFilterUpdate, "reading"},
+    {"logSample", benchLogSample, "sample"},
+    {"logDecodeBlock", benchLogDecodeBlock, "entry"},
+    {"uartDividers", benchUartDividers, "call"},
+};
+
+static double timeKernel(const Kernel *kernel, uint64_t runNs) { // ns per operation, fastest of BENCH_RUNS
+    unsigned long ops = BENCH_BATCH;
+    uint64_t start, took = 0;
+    double best = 0.0;
+    unsigned char run;
+
+    while(took < runNs / 10) { // size a run
+        ops *= 2;
+        start = nowNs();
+        sink += kernel->fn(ops);
+        took = nowNs() - start;
+    }
+    ops = (unsigned long)((double)ops * runNs / took) + BENCH_BATCH;
+    for(run = 0; run < BENCH_RUNS; run++) {
+        start = nowNs();
+        sink += kernel->fn(ops);
+        took = nowNs() - start;
+        if(run == 0 || (double)took / ops < best) {
+            best = (double)took / ops;
+        }
+    }
+    return best;
+}
+
+static long symbolSize(const char *listing, const char *name) { // from nm -S output, -1 if not there
+    char line[256], symbol[128];
+    unsigned long addr, size;
+    char type;
+    FILE *file;
+    long found = -1;
+
+    if(listing == 0 || (file = fopen(listing, "r")) == 0) {
+        return -1;
+    }
+    while(fgets(line, sizeof line, file)) {
+        if(sscanf(line, "%lx %lx %c %127s", &addr, &size, &type, symbol) == 4 && (type == 'T' || type == 't') &&
+           strcmp(symbol, name) == 0) {
+            found = (long)size;
+            break;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+static void benchInputs(void) {
+    unsigned idx;
+
+    srand(1);
+    for(idx = 0; idx < BENCH_INPUTS; idx++) {
+        adcIn[idx] = (unsigned short)(rand() & 0x0FFF);
+        numIn[idx] = (((unsigned long)rand() << 16 ^ (unsigned long)rand()) & 0xFFFFFFFFUL) >> (idx & 31);
+        fixedIn[idx] = (long)(rand() % 20001) - 10000;
+        rawT[idx] = 400000 + rand() % 200000;
+        rawP[idx] = 250000 + rand() % 300000;
+        rawH[idx] = 20000 + rand() % 30000;
+    }
+
+    logInit();
+    for(idx = 0; benchBlock.used + 2 <= sizeof benchBlock.data; idx++) { // a block of 2-byte samples
+        benchBlock.data[benchBlock.used++] = (unsigned char)((idx & 7) << 3); // moisture delta, LOG_SAMPLE
+        benchBlock.data[benchBlock.used++] = (unsigned char)(idx & 1) << 4; // temperature delta, one zone
+    }
+    benchBlock.magic = LOG_MAGIC;
+    benchBlock.moisture = 1500;
+    benchBlock.temp = 210;
+}
+
+int main(int argc, char **argv) {
+    uint64_t runNs = BENCH_RUN_NS;
+    const char *listing = 0;
+    char sizeText[24];
+    unsigned char idx;
+    long size;
+    int arg;
+
+    for(arg = 1; arg < argc; arg++) {
+        if(strcmp(argv[arg], "-q") == 0) {
+            runNs = BENCH_RUN_NS / 100;
+        } else {
+            listing = argv[arg];
+        }
+    }
+
+    benchInputs();
+    printf("%s host build, compiler %s %s, %u-bit\n\n", BENCH_BUILD, BENCH_COMPILER, __VERSION__,
+           (unsigned)(8 * sizeof(void *)));
+    printf("%-22s %10s  %-8s %10s\n", "kernel", "ns/op", "op", "code bytes");
+    for(idx = 0; idx < sizeof kernels / sizeof kernels[0]; idx++) {
+        size = symbolSize(listing, kernels[idx].name);
+        if(size >= 0) {
+            snprintf(sizeText, sizeof sizeText, "%ld", size);
+        } else {
+            strcpy(sizeText, "-"); // no listing given
+        }
+        printf("%-22s %10.2f  %-8s %10s\n", kernels[idx].name, timeKernel(&kernels[idx], runNs), kernels[idx].op,
+               sizeText);
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+# Writes the kernel timings and code sizes to OUT: cmake -DBENCH=... -DNM=... -DLIB=... -DOUT=... -P report.cmake
+# the firmware kernels are in LIB, the baselines they are compared against in bench itself
+execute_process(COMMAND ${NM} -S --defined-only ${LIB} ${BENCH} OUTPUT_FILE ${OUT}.nm RESULT_VARIABLE failed)
+if(failed)
+    message(FATAL_ERROR "${NM} failed on ${LIB} or ${BENCH}")
+endif()
+execute_process(COMMAND ${BENCH} ${OUT}.nm OUTPUT_VARIABLE report RESULT_VARIABLE failed)
+file(REMOVE ${OUT}.nm)
+if(failed)
+    message(FATAL_ERROR "${BENCH} failed")
+endif()
+
+# the timings only mean something next to others from the same machine, so the report names it
+cmake_host_system_information(RESULT cpu QUERY PROCESSOR_DESCRIPTION)
+cmake_host_system_information(RESULT os QUERY OS_NAME)
+cmake_host_system_information(RESULT release QUERY OS_RELEASE)
+file(WRITE ${OUT} "Written by make bench_report on ${cpu}, ${os} ${release}\n${report}")
@@ -0,0 +1,349 @@
+/*
+ fleetd.c
+ The fleet aggregator: takes node frames from ESP-01s over TCP and from nodes wired to serial ports,
+ acknowledges them, and stores the telemetry in a memory-mapped columnar file (store.h) that fleetq can query
+ while fleetd is writing it.
+
+    fleetd -f file [-p port] [-s serial device]... [-t seconds] [-v]
+
+ An ESP-01 in transparent mode holds one TCP connection and passes the node's UART bytes through in both
+ directions, so each connection, like each serial port, is one stream of node frames with ACKs going back the
+ same way (ingest.h). Serial ports are set to 115200 baud 8N1, UART_BAUD (uart.h). One thread serves every
+ stream through epoll, which keeps 10k connections cheap; the open file limit is raised to its hard limit for
+ them. The file is flushed every FLEETD_SYNC_S seconds and on SIGINT or SIGTERM, -t stops after that many
+ seconds, and -v prints the counters at every flush. The port is printed once fleetd listens, -p 0 picks a
+ free one.
+ */
+
+#define _GNU_SOURCE // accept4()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ingest.h"
+#include "store.h"
+
+#define FLEETD_PORT 5020
+#define FLEETD_SERIALS 8
+#define FLEETD_EVENTS 256
+#define FLEETD_READ 65536 // bytes read from a stream per event
+#define FLEETD_OUT_MAX (256 * 1024) // ACK bytes held for a stream that does not take them, then it is dropped
+#define FLEETD_SYNC_S 10
+
+typedef struct {
+    int fd;
+    unsigned char writing; // EPOLLOUT asked for
+    unsigned char broken; // out of room for ACKs, closed after this read
+    IngestStream ingest;
+    uint8_t *out; // ACKs not sent yet
+    size_t outLen;
+    size_t outSize;
+} Stream;
+
+static volatile sig_atomic_t stopping;
+static int epollFd;
+static Stream listener;
+static Ingest ingest;
+static unsigned long streams;
+static unsigned long streamsPeak;
+static unsigned long streamsDropped;
+
+static void stop(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static int64_t nowMs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static Stream *streamAdd(int fd) { // a TCP connection or a serial port
+    struct epoll_event event;
+    Stream *stream = calloc(1, sizeof *stream);
+
+    if(stream == 0) {
+        close(fd);
+        return 0;
+    }
+    stream->fd = fd;
+    ingestStreamInit(&stream->ingest);
+    event.events = EPOLLIN;
+    event.data.ptr = stream;
+    if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        close(fd);
+        free(stream);
+        return 0;
+    }
+    if(++streams > streamsPeak) {
+        streamsPeak = streams;
+    }
+    return stream;
+}
+
+static void streamClose(Stream *stream) {
+    close(stream->fd); // leaves the epoll set with it
+    free(stream->out);
+    free(stream);
+    streams--;
+}
+
+static void queueReply(const uint8_t *data, size_t len, void *arg) { // IngestReplyFn
+    Stream *stream = arg;
+    size_t size;
+    uint8_t *out;
+
+    if(stream->outLen + len > stream->outSize) {
+        size = stream->outSize ? 2 * stream->outSize : 1024;
+        while(size < stream->outLen + len) {
+            size *= 2;
+        }
+        if(size > FLEETD_OUT_MAX || (out = realloc(stream->out, size)) == 0) {
+            stream->broken = 1;
+            return;
+        }
+        stream->out = out;
+        stream->outSize = size;
+    }
+    memcpy(&stream->out[stream->outLen], data, len);
+    stream->outLen += len;
+}
+
+static int streamFlush(Stream *stream) { // 0 if the stream failed
+    struct epoll_event event;
+    ssize_t sent;
+    unsigned char writing;
+
+    while(stream->outLen) {
+        sent = write(stream->fd, stream->out, stream->outLen);
+        if(sent < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                return 0;
+            }
+            break;
+        }
+        stream->outLen -= (size_t)sent;
+        memmove(stream->out, &stream->out[sent], stream->outLen);
+    }
+
+    writing = stream->outLen != 0; // the rest when the stream can take it
+    if(writing != stream->writing) {
+        event.events = writing ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.ptr = stream;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, stream->fd, &event);
+        stream->writing = writing;
+    }
+    return 1;
+}
+
+static void streamEvent(Stream *stream, uint32_t events, int64_t now) {
+    static uint8_t data[FLEETD_READ];
+    ssize_t len = 0;
+
+    if(events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        len = read(stream->fd, data, sizeof data);
+        if(len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            streamClose(stream); // the ESP-01 went away, it connects again; a serial port is not opened again
+            return;
+        }
+        if(len > 0) {
+            ingestBytes(&ingest, &stream->ingest, data, (size_t)len, now, queueReply, stream);
+        }
+    }
+    if(stream->broken) {
+        streamsDropped++;
+        streamClose(stream);
+        return;
+    }
+    if(!streamFlush(stream)) {
+        streamClose(stream);
+    }
+}
+
+static void acceptAll(void) {
+    int fd, one = 1;
+
+    while((fd = accept4(listener.fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one); // ACKs are small and due within the listen window
+        streamAdd(fd);
+    }
+}
+
+static int listenTcp(unsigned short port) { // the port listened on, 0 if it failed
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof addr;
+    int one = 1;
+
+    listener.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listener.fd < 0) {
+        return 0;
+    }
+    setsockopt(listener.fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if(bind(listener.fd, (struct sockaddr *)&addr, sizeof addr) != 0 || listen(listener.fd, SOMAXCONN) != 0 ||
+       getsockname(listener.fd, (struct sockaddr *)&addr, &addrLen) != 0) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+static int openSerial(const char *path) { // -1 if it failed
+    struct termios tio;
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+    if(fd < 0) {
+        return -1;
+    }
+    if(isatty(fd)) { // a FIFO or file works too, for testing
+        if(tcgetattr(fd, &tio) != 0) {
+            close(fd);
+            return -1;
+        }
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        cfsetispeed(&tio, B115200);
+        cfsetospeed(&tio, B115200);
+        if(tcsetattr(fd, TCSANOW, &tio) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+static void raiseFileLimit(void) {
+    struct rlimit limit;
+
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static void report(const Store *store) {
+    const IngestStats *stats = &ingest.stats;
+
+    printf("fleetd: %lu streams (%lu at most, %lu dropped), %llu bytes, %llu frames (%llu bad, %llu telemetry, "
+           "%llu log, %llu stats), %llu records stored, %llu duplicates, %llu not stored, %u nodes, %llu records "
+           "in the file\n", streams, streamsPeak, streamsDropped, (unsigned long long)stats->bytes,
+           (unsigned long long)stats->frames, (unsigned long long)stats->badFrames,
+           (unsigned long long)stats->telemetryFrames, (unsigned long long)stats->logFrames,
+           (unsigned long long)stats->statsFrames, (unsigned long long)stats->records,
+           (unsigned long long)stats->duplicates, (unsigned long long)stats->storeErrors, store->header->nodes,
+           (unsigned long long)store->header->records);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    struct epoll_event events[FLEETD_EVENTS];
+    struct sigaction action;
+    const char *path = 0;
+    const char *serials[FLEETD_SERIALS];
+    unsigned char serialCount = 0, verbose = 0, idx;
+    unsigned long port = FLEETD_PORT, runFor = 0;
+    int64_t now, started, nextSync;
+    Store store;
+    Stream *stream;
+    int opt, count, event, fd;
+
+    while((opt = getopt(argc, argv, "f:p:s:t:v")) != -1) {
+        switch(opt) {
+            case 'f': path = optarg; break;
+            case 'p': port = strtoul(optarg, 0, 10); break;
+            case 's':
+                if(serialCount < FLEETD_SERIALS) {
+                    serials[serialCount++] = optarg;
+                }
+                break;
+            case 't': runFor = strtoul(optarg, 0, 10); break;
+            case 'v': verbose = 1; break;
+            default: path = 0; optind = argc; break;
+        }
+    }
+    if(path == 0 || port > 65535) {
+        fprintf(stderr, "usage: %s -f file [-p port] [-s serial device]... [-t seconds] [-v]\n", argv[0]);
+        return 2;
+    }
+
+    if(!storeOpen(&store, path, 1)) {
+        fprintf(stderr, "fleetd: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    ingestInit(&ingest, &store);
+    raiseFileLimit();
+    memset(&action, 0, sizeof action);
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    signal(SIGPIPE, SIG_IGN); // a connection that went away shows up as a failed write
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    port = listenTcp((unsigned short)port);
+    if(epollFd < 0 || port == 0) {
+        fprintf(stderr, "fleetd: cannot listen: %s\n", strerror(errno));
+        storeClose(&store);
+        return 1;
+    }
+    events[0].events = EPOLLIN;
+    events[0].data.ptr = &listener;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listener.fd, &events[0]);
+    for(idx = 0; idx < serialCount; idx++) {
+        fd = openSerial(serials[idx]);
+        if(fd < 0) {
+            fprintf(stderr, "fleetd: %s: %s\n", serials[idx], strerror(errno));
+        } else {
+            streamAdd(fd);
+        }
+    }
+    printf("fleetd: listening on port %lu, %u serial port(s), %s\n", port, serialCount, path);
+    fflush(stdout);
+
+    started = nowMs();
+    nextSync = started + FLEETD_SYNC_S * 1000;
+    while(!stopping) {
+        count = epoll_wait(epollFd, events, FLEETD_EVENTS, 500);
+        now = nowMs();
+        for(event = 0; event < count; event++) {
+            stream = events[event].data.ptr;
+            if(stream == &listener) {
+                acceptAll();
+            } else {
+                streamEvent(stream, events[event].events, now);
+            }
+        }
+        if(now >= nextSync) {
+            storeSync(&store, 0);
+            if(verbose) {
+                report(&store);
+            }
+            nextSync = now + FLEETD_SYNC_S * 1000;
+        }
+        if(runFor && now - started >= (int64_t)runFor * 1000) {
+            break;
+        }
+    }
+
+    report(&store);
+    storeClose(&store);
+    return ingest.stats.storeErrors ? 1 : 0;
+}
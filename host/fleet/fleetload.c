@@ -0,0 +1,355 @@
+/*
+ fleetload.c
+ Load generator for fleetd: many simulated nodes sending telemetry exactly as the firmware does, each batch of
+ TELEMETRY_BATCH records (telemetry.h) in a PROTO_TELEMETRY frame with the node's ID and its own frame seq,
+ COBS encoded with the CRC (frame.h). Node IDs run from 1, each node has its own moisture, temperature and
+ reservoir walk, and every sample has one record per zone with the same cycle count, like main.c.
+
+    fleetload [-n nodes] [-c connections] [-b batches per node] [-z zones] [-i cycles] [-r frames/s]
+              [-H host] [-p port] [-t timeout]
+
+ The defaults are 10000 nodes, each on its own connection as behind its own ESP-01, sending 16 batches of
+ 60-cycle samples as fast as fleetd takes them. With fewer connections than nodes a connection carries several
+ nodes, like a gateway would; ACKs carry no node ID, so flow control is per connection, PROTO_WINDOW frames
+ per node on it waiting for their ACK at most. The exit status is 1 if any frame was not acknowledged within
+ the timeout (60 s).
+ */
+
+#define _GNU_SOURCE // SOCK_NONBLOCK, getaddrinfo()
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame.h"
+#include "protocol.h"
+#include "telemetry.h"
+
+#define LOAD_NODES 10000
+#define LOAD_BATCHES 16
+#define LOAD_CYCLES 60 // control cycles between samples
+#define LOAD_TIMEOUT_S 60
+#define LOAD_EVENTS 256
+#define LOAD_OUT_MAX 4096 // frame bytes queued on a connection before it waits for the socket
+
+typedef struct {
+    uint16_t id;
+    uint8_t frameSeq;
+    uint16_t recordSeq;
+    uint16_t batchesLeft;
+    uint8_t zone; // of the next record
+    uint8_t valve;
+    uint8_t level;
+    double moisture;
+    unsigned long samples;
+} Node;
+
+typedef struct {
+    int fd;
+    unsigned char connected;
+    unsigned char writing; // EPOLLOUT asked for
+    Node **nodes;
+    unsigned nodeCount;
+    unsigned nextNode; // round robin over nodes
+    unsigned nodesLeft; // with batches still to send
+    unsigned outstanding; // frames not acknowledged yet
+    FrameReader reader;
+    uint8_t out[LOAD_OUT_MAX + FRAME_COBS_MAX];
+    size_t outLen;
+} Conn;
+
+static Node *nodes;
+static Conn *conns;
+static unsigned nodeCount = LOAD_NODES, connCount = 0, zones = 1;
+static unsigned batches = LOAD_BATCHES, cycles = LOAD_CYCLES;
+static int epollFd;
+static unsigned long long framesSent, recordsSent, acks, connectFailures;
+
+static double nowS(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void addRecord(Node *node, uint8_t *record) { // telemetry.h layout, the next record of the node
+    unsigned long phase = (node->samples * cycles + node->id * 97UL) % 86400; // seconds into the day
+    unsigned long fromNight = phase < 43200 ? phase : 86400 - phase;
+    short temp = (short)(120 + fromNight * 160 / 43200 + rand() % 5); // 12 to 28 C and back
+    unsigned short moisture, hoursLeft;
+
+    if(node->zone == 0) { // a new sample
+        node->samples++;
+        node->moisture += (node->valve ? 25.0 : -2.0) + (rand() % 7 - 3);
+        if(node->moisture < 1200) {
+            node->valve = 1;
+        } else if(node->moisture > 1800) {
+            node->valve = 0;
+        }
+        if(node->valve && node->level > 0 && node->samples % 4 == 0) {
+            node->level--;
+        }
+        if(node->level == 0) {
+            node->level = 100; // refilled
+        }
+    }
+    moisture = (unsigned short)(node->moisture + 40 * node->zone);
+    hoursLeft = node->valve ? (unsigned short)(node->level * 3) : 0xFFFF;
+
+    record[0] = (uint8_t)node->recordSeq;
+    record[1] = (uint8_t)(node->recordSeq >> 8);
+    record[2] = (uint8_t)moisture;
+    record[3] = (uint8_t)(moisture >> 8);
+    record[4] = (uint8_t)temp;
+    record[5] = (uint8_t)((unsigned short)temp >> 8);
+    record[6] = (uint8_t)(node->zone << 4 | node->valve);
+    record[7] = node->level;
+    record[8] = (uint8_t)hoursLeft;
+    record[9] = (uint8_t)(hoursLeft >> 8);
+    record[10] = (uint8_t)cycles;
+    record[11] = (uint8_t)(cycles >> 8);
+    node->recordSeq++;
+    node->zone = (uint8_t)((node->zone + 1) % zones);
+}
+
+static void queueFrame(Conn *conn, Node *node) {
+    uint8_t payload[TELEMETRY_BATCH * TELEMETRY_RECORD_LEN];
+    unsigned char idx;
+
+    for(idx = 0; idx < TELEMETRY_BATCH; idx++) {
+        addRecord(node, &payload[idx * TELEMETRY_RECORD_LEN]);
+    }
+    conn->outLen += frameEncode(PROTO_TELEMETRY, node->frameSeq++, 1, node->id, payload, sizeof payload,
+                                &conn->out[conn->outLen]);
+    conn->outstanding++;
+    framesSent++;
+    recordsSent += TELEMETRY_BATCH;
+    if(--node->batchesLeft == 0) {
+        conn->nodesLeft--;
+    }
+}
+
+static void watch(Conn *conn, unsigned char writing) {
+    struct epoll_event event;
+
+    if(writing != conn->writing) {
+        event.events = writing ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.ptr = conn;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+        conn->writing = writing;
+    }
+}
+
+static void pump(Conn *conn, unsigned long long *budget) { // queue what the window allows, send what the socket takes
+    Node *node;
+    ssize_t sent;
+
+    while(*budget && conn->nodesLeft && conn->outstanding < PROTO_WINDOW * conn->nodeCount &&
+          conn->outLen < LOAD_OUT_MAX) {
+        do {
+            node = conn->nodes[conn->nextNode];
+            conn->nextNode = (conn->nextNode + 1) % conn->nodeCount;
+        } while(node->batchesLeft == 0);
+        queueFrame(conn, node);
+        (*budget)--;
+    }
+    while(conn->outLen) {
+        sent = send(conn->fd, conn->out, conn->outLen, MSG_NOSIGNAL);
+        if(sent <= 0) {
+            break;
+        }
+        conn->outLen -= (size_t)sent;
+        memmove(conn->out, &conn->out[sent], conn->outLen);
+    }
+    watch(conn, conn->outLen != 0);
+}
+
+static void closeConn(Conn *conn) { // what it has not sent stays unacknowledged
+    close(conn->fd);
+    conn->fd = -1;
+    connectFailures += !conn->connected;
+}
+
+static int readAcks(Conn *conn) { // 0 if fleetd closed the connection
+    uint8_t data[4096];
+    Frame frame;
+    ssize_t len, idx;
+
+    len = recv(conn->fd, data, sizeof data, 0);
+    if(len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        return 0;
+    }
+    for(idx = 0; idx < len; idx++) {
+        if(frameReaderPush(&conn->reader, data[idx], 0, &frame) && frame.type == PROTO_ACK && conn->outstanding) {
+            conn->outstanding--;
+            acks++;
+        }
+    }
+    return 1;
+}
+
+static int connectAll(const char *host, const char *port) { // 0 if the address does not resolve
+    struct addrinfo hints, *addr;
+    struct epoll_event event;
+    unsigned idx;
+    int one = 1;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, port, &hints, &addr) != 0) {
+        return 0;
+    }
+    for(idx = 0; idx < connCount; idx++) {
+        conns[idx].fd = socket(addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(conns[idx].fd < 0 ||
+           (connect(conns[idx].fd, addr->ai_addr, addr->ai_addrlen) != 0 && errno != EINPROGRESS)) {
+            fprintf(stderr, "fleetload: connection %u: %s\n", idx, strerror(errno));
+            if(conns[idx].fd >= 0) {
+                closeConn(&conns[idx]);
+            } else {
+                connectFailures++;
+            }
+            continue;
+        }
+        setsockopt(conns[idx].fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        event.events = EPOLLIN | EPOLLOUT; // writable once connected
+        event.data.ptr = &conns[idx];
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, conns[idx].fd, &event);
+        conns[idx].writing = 1;
+    }
+    freeaddrinfo(addr);
+    return 1;
+}
+
+static void raiseFileLimit(void) {
+    struct rlimit limit;
+
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int main(int argc, char **argv) {
+    struct epoll_event events[LOAD_EVENTS];
+    const char *host = "127.0.0.1", *port = "5020";
+    unsigned long long budget, unacked, allowed;
+    unsigned long rate = 0, timeout = LOAD_TIMEOUT_S;
+    double start, now, took;
+    unsigned idx, busy;
+    Conn *conn;
+    int opt, count, event, error;
+    socklen_t errorLen;
+
+    while((opt = getopt(argc, argv, "n:c:b:z:i:r:H:p:t:")) != -1) {
+        switch(opt) {
+            case 'n': nodeCount = strtoul(optarg, 0, 10); break;
+            case 'c': connCount = strtoul(optarg, 0, 10); break;
+            case 'b': batches = strtoul(optarg, 0, 10); break;
+            case 'z': zones = strtoul(optarg, 0, 10); break;
+            case 'i': cycles = strtoul(optarg, 0, 10); break;
+            case 'r': rate = strtoul(optarg, 0, 10); break;
+            case 'H': host = optarg; break;
+            case 'p': port = optarg; break;
+            case 't': timeout = strtoul(optarg, 0, 10); break;
+            default: nodeCount = 0; optind = argc; break;
+        }
+    }
+    if(connCount == 0 || connCount > nodeCount) {
+        connCount = nodeCount;
+    }
+    if(nodeCount == 0 || nodeCount > 65535 || batches == 0 || batches > 65535 || zones == 0 || zones > 8 ||
+       cycles > 65535) {
+        fprintf(stderr, "usage: %s [-n nodes] [-c connections] [-b batches per node] [-z zones] [-i cycles] "
+                "[-r frames/s] [-H host] [-p port] [-t timeout]\n", argv[0]);
+        return 2;
+    }
+
+    raiseFileLimit();
+    nodes = calloc(nodeCount, sizeof *nodes);
+    conns = calloc(connCount, sizeof *conns);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(nodes == 0 || conns == 0 || epollFd < 0) {
+        fprintf(stderr, "fleetload: out of memory\n");
+        return 1;
+    }
+    srand(1);
+    for(idx = 0; idx < connCount; idx++) {
+        conns[idx].nodes = malloc(((nodeCount - idx - 1) / connCount + 1) * sizeof *conns[idx].nodes);
+        frameReaderInit(&conns[idx].reader);
+    }
+    for(idx = 0; idx < nodeCount; idx++) { // node n on connection n % connections
+        nodes[idx].id = (uint16_t)(idx + 1);
+        nodes[idx].batchesLeft = (uint16_t)batches;
+        nodes[idx].level = (uint8_t)(50 + rand() % 51);
+        nodes[idx].moisture = 1200 + rand() % 600;
+        conn = &conns[idx % connCount];
+        conn->nodes[conn->nodeCount++] = &nodes[idx];
+        conn->nodesLeft++;
+    }
+    if(!connectAll(host, port)) {
+        fprintf(stderr, "fleetload: cannot resolve %s\n", host);
+        return 1;
+    }
+
+    start = nowS();
+    do {
+        count = epoll_wait(epollFd, events, LOAD_EVENTS, rate ? 1 : 100);
+        now = nowS();
+        budget = ~0ULL;
+        if(rate) { // frames/s so far
+            allowed = (unsigned long long)((now - start) * rate);
+            budget = allowed > framesSent ? allowed - framesSent : 0;
+        }
+        for(event = 0; event < count; event++) {
+            conn = events[event].data.ptr;
+            if(!conn->connected && (events[event].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                errorLen = sizeof error;
+                if(getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) != 0 || error != 0) {
+                    fprintf(stderr, "fleetload: connect: %s\n", strerror(error));
+                    closeConn(conn);
+                    continue;
+                }
+                conn->connected = 1;
+            }
+            if((events[event].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !readAcks(conn)) {
+                fprintf(stderr, "fleetload: node %04X: connection closed\n", conn->nodes[0]->id);
+                closeConn(conn);
+                continue;
+            }
+            pump(conn, &budget);
+        }
+        if(rate) { // connections only waiting for the budget get no event
+            for(idx = 0; idx < connCount && budget; idx++) {
+                if(conns[idx].fd >= 0 && conns[idx].connected && conns[idx].nodesLeft && !conns[idx].writing) {
+                    pump(&conns[idx], &budget);
+                }
+            }
+        }
+        for(idx = 0, busy = 0; idx < connCount; idx++) {
+            busy += conns[idx].fd >= 0 && (conns[idx].nodesLeft || conns[idx].outstanding);
+        }
+    } while(busy && now - start < timeout);
+    took = now - start;
+
+    unacked = (unsigned long long)nodeCount * batches - acks; // sent and not acknowledged, or never sent
+    for(idx = 0; idx < connCount; idx++) {
+        if(conns[idx].fd >= 0) {
+            close(conns[idx].fd);
+        }
+    }
+    printf("fleetload: %u nodes over %u connections, %llu frames (%llu records) in %.2f s, %.0f frames/s, "
+           "%.0f records/s, %llu ACKs, %llu frames unacknowledged, %llu connections failed\n", nodeCount, connCount,
+           framesSent, recordsSent, took, framesSent / took, recordsSent / took, acks, unacked, connectFailures);
+    return unacked ? 1 : 0;
+}
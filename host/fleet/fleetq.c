@@ -0,0 +1,162 @@
+/*
+ fleetq.c
+ Queries of the fleet aggregator's file (store.h), which fleetd may be writing at the same time.
+
+    fleetq -f file nodes
+    fleetq -f file [-z zone] range node [from [to]]
+    fleetq -f file [-z zone] down node width [from [to]]
+
+ nodes lists every node with its record count and time span. range prints a node's records, down folds them
+ into buckets of width seconds with the mean, minimum and maximum moisture and temperature. Times are Unix
+ seconds; a negative one counts back from the node's newest record, so "down 1234 3600 -86400" is the last day
+ hour by hour. from defaults to the first record and to to just after the last. Node IDs are taken in hex, as
+ watersim prints them. How long the query took, without the printing, goes to stderr.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "store.h"
+
+#define FLEETQ_BUCKETS_MAX 100000
+
+static double nowUs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static const char *timeText(int64_t ms) { // UTC, in a static buffer
+    static char text[32];
+    time_t sec = (time_t)(ms / 1000);
+    struct tm tm;
+    size_t len;
+
+    gmtime_r(&sec, &tm);
+    len = strftime(text, sizeof text, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(&text[len], sizeof text - len, ".%03dZ", (int)(ms % 1000));
+    return text;
+}
+
+static int64_t timeArg(const char *arg, int64_t newest) { // ms
+    long long sec = strtoll(arg, 0, 10);
+
+    return sec < 0 ? newest + sec * 1000 : sec * 1000;
+}
+
+static int printRecord(const StoreRecord *record, void *arg) { // StoreRecordFn
+    (void)arg;
+    printf("%s %5u %u %u %4u %5.1f %3u %5u %5u\n", timeText(record->time), record->seq, record->zone, record->valve,
+           record->moisture, record->temp / 10.0, record->level, record->hoursLeft, record->cycles);
+    return 0;
+}
+
+static void listNodes(const Store *store) {
+    const StoreNode *node;
+    unsigned long id;
+
+    printf("node  records  chunks  first                     last\n");
+    for(id = 0; id < STORE_NODES; id++) {
+        node = storeNode(store, (uint16_t)id);
+        if(node->records) {
+            printf("%04lX %8llu %7u  %s", id, (unsigned long long)node->records, node->chunkCount,
+                   timeText(node->firstTime));
+            printf("  %s\n", timeText(node->lastTime));
+        }
+    }
+    printf("%u nodes, %llu records, %u of %u chunks used\n", store->header->nodes,
+           (unsigned long long)store->header->records, store->header->chunksUsed, store->header->chunks);
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s -f file nodes\n"
+                    "       %s -f file [-z zone] range node [from [to]]\n"
+                    "       %s -f file [-z zone] down node width [from [to]]\n", name, name, name);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    static StoreBucket buckets[FLEETQ_BUCKETS_MAX];
+    const char *path = 0;
+    const StoreNode *entry;
+    const char *command;
+    Store store;
+    uint16_t node;
+    int64_t from, to, width = 0;
+    uint64_t found;
+    size_t count, idx;
+    double start;
+    int zone = STORE_ZONE_ANY;
+    int opt, arg;
+
+    while((opt = getopt(argc, argv, "+f:z:")) != -1) {
+        switch(opt) {
+            case 'f': path = optarg; break;
+            case 'z': zone = atoi(optarg); break;
+            default: return usage(argv[0]);
+        }
+    }
+    if(path == 0 || optind >= argc) {
+        return usage(argv[0]);
+    }
+    if(!storeOpen(&store, path, 0)) {
+        fprintf(stderr, "fleetq: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    command = argv[optind++];
+    if(strcmp(command, "nodes") == 0) {
+        listNodes(&store);
+        storeClose(&store);
+        return 0;
+    }
+    if((strcmp(command, "range") != 0 && strcmp(command, "down") != 0) || optind >= argc) {
+        storeClose(&store);
+        return usage(argv[0]);
+    }
+
+    node = (uint16_t)strtoul(argv[optind++], 0, 16);
+    entry = storeNode(&store, node);
+    if(strcmp(command, "down") == 0) {
+        if(optind >= argc || (width = strtoll(argv[optind++], 0, 10) * 1000) <= 0) {
+            storeClose(&store);
+            return usage(argv[0]);
+        }
+    }
+    arg = optind;
+    from = arg < argc ? timeArg(argv[arg++], entry->lastTime) : entry->firstTime;
+    to = arg < argc ? timeArg(argv[arg++], entry->lastTime) : entry->lastTime + 1;
+    if(entry->records == 0) {
+        fprintf(stderr, "fleetq: no records of node %04X\n", node);
+        storeClose(&store);
+        return 1;
+    }
+
+    if(width == 0) {
+        start = nowUs();
+        found = storeRange(&store, node, zone, from, to, 0, 0); // timed without the printing
+        fprintf(stderr, "fleetq: %llu records in %.0f us\n", (unsigned long long)found, nowUs() - start);
+        printf("time                     seq   zone valve moisture temp level hours cycles\n");
+        storeRange(&store, node, zone, from, to, printRecord, 0);
+    } else {
+        start = nowUs();
+        count = storeDownsample(&store, node, zone, from, to, width, buckets, FLEETQ_BUCKETS_MAX);
+        fprintf(stderr, "fleetq: %lu buckets in %.0f us\n", (unsigned long)count, nowUs() - start);
+        printf("start                    records  open  moisture mean/min/max    temp mean/min/max\n");
+        for(idx = 0; idx < count; idx++) {
+            printf("%s %7u %5u  %8.1f %5u %5u  %6.1f %5.1f %5.1f\n", timeText(buckets[idx].start),
+                   buckets[idx].count, buckets[idx].valveOpen, buckets[idx].moistureMean, buckets[idx].moistureMin,
+                   buckets[idx].moistureMax, buckets[idx].tempMean / 10.0, buckets[idx].tempMin / 10.0,
+                   buckets[idx].tempMax / 10.0);
+        }
+    }
+    storeClose(&store);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "ingest.h"
+#include "protocol.h"
+#include "telemetry.h"
+
+void ingestInit(Ingest *ingest, Store *store) {
+    ingest->store = store;
+    ingest->stats = (IngestStats){0};
+}
+
+void ingestStreamInit(IngestStream *stream) {
+    frameReaderInit(&stream->reader);
+    stream->seq = 0;
+}
+
+static void decodeRecord(const uint8_t *raw, StoreRecord *record) { // telemetry.h layout
+    record->seq = (uint16_t)(raw[0] | raw[1] << 8);
+    record->moisture = (uint16_t)(raw[2] | raw[3] << 8);
+    record->temp = (int16_t)(raw[4] | raw[5] << 8);
+    record->valve = raw[6] & 1;
+    record->zone = (raw[6] >> 4) & 0x07;
+    record->level = raw[7];
+    record->hoursLeft = (uint16_t)(raw[8] | raw[9] << 8);
+    record->cycles = (uint16_t)(raw[10] | raw[11] << 8);
+}
+
+static void telemetry(Ingest *ingest, const Frame *frame, int64_t now) {
+    StoreRecord records[FRAME_PAYLOAD_MAX / TELEMETRY_RECORD_LEN];
+    const StoreNode *node = storeNode(ingest->store, frame->node);
+    size_t count = frame->len / TELEMETRY_RECORD_LEN;
+    size_t idx, first = 0;
+    int64_t earliest, shift;
+    int stored;
+
+    ingest->stats.telemetryFrames++;
+    for(idx = 0; idx < count; idx++) {
+        decodeRecord(&frame->payload[idx * TELEMETRY_RECORD_LEN], &records[idx]);
+    }
+    if(node->records) { // resent records, all at the front
+        while(first < count && (uint16_t)(node->lastSeq - records[first].seq) < INGEST_RESEND_SPAN) {
+            first++;
+        }
+        ingest->stats.duplicates += first;
+    }
+    if(first == count) {
+        return;
+    }
+
+    records[count - 1].time = now;
+    for(idx = count - 1; idx > first; idx--) { // a new sample starts where the zone does not count up
+        records[idx - 1].time = records[idx].time -
+                                (records[idx].zone > records[idx - 1].zone ? 0 : records[idx].cycles * INGEST_CYCLE_MS);
+    }
+    if(node->records) {
+        earliest = node->lastTime;
+        if(records[first].zone <= node->lastZone) { // the frame starts a new sample
+            earliest += records[first].cycles * INGEST_CYCLE_MS;
+        }
+        shift = earliest - records[first].time;
+        for(idx = first; shift > 0 && idx < count; idx++) {
+            records[idx].time += shift;
+        }
+    }
+
+    for(idx = first; idx < count; idx++) {
+        stored = storeAppend(ingest->store, frame->node, &records[idx]);
+        if(stored > 0) {
+            ingest->stats.records++;
+        } else if(stored < 0) {
+            ingest->stats.storeErrors++;
+        }
+    }
+}
+
+void ingestBytes(Ingest *ingest, IngestStream *stream, const uint8_t *data, size_t len, int64_t now,
+                 IngestReplyFn reply, void *arg) {
+    uint8_t ack[FRAME_COBS_MAX];
+    Frame frame;
+    size_t idx;
+    int ending;
+
+    ingest->stats.bytes += len;
+    for(idx = 0; idx < len; idx++) {
+        ending = (data[idx] == 0 && stream->reader.len != 0);
+        if(!frameReaderPush(&stream->reader, data[idx], 1, &frame)) {
+            if(ending) {
+                ingest->stats.badFrames++;
+            }
+            continue;
+        }
+
+        ingest->stats.frames++;
+        if(frame.type == PROTO_TELEMETRY) {
+            telemetry(ingest, &frame, now);
+        } else if(frame.type == PROTO_LOG) {
+            ingest->stats.logFrames++;
+        } else if(frame.type == PROTO_STATS) {
+            ingest->stats.statsFrames++;
+        } else {
+            continue; // not a node frame, nothing to acknowledge
+        }
+        ingest->stats.acks++;
+        reply(ack, frameEncode(PROTO_ACK, stream->seq++, 0, 0, &frame.seq, 1, ack), arg);
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ ingest.h
+ Node frames into the store. Every byte stream the aggregator reads, a TCP connection from an ESP-01 or a
+ serial port with a node on it, has an IngestStream with its own frame reader (frame.h). Each frame with a
+ good CRC is acknowledged the way the simulated gateway does it (gateway.h), the records of a PROTO_TELEMETRY
+ frame are appended to the node's series (store.h), and PROTO_LOG and PROTO_STATS frames are only counted.
+
+ Records carry no time, only the control cycles since the previous sample (telemetry.h). The newest record of
+ a frame is dated when the frame arrived and the others back from it by their cycle counts, the records of one
+ sample (one per zone, zones counting up) sharing a time. If that would put the first record closer to the
+ node's newest stored one than its cycle count says, the batch is moved up to keep that spacing: frames that
+ come in faster than the node's own clock, as a replay (fleetload) sends them, still get a time axis that
+ follows the cycle counts.
+
+ A node sends a frame again when its ACK was lost, so records whose seq is less than INGEST_RESEND_SPAN behind
+ the node's newest are dropped as already stored; a seq further back is a node that restarted.
+ */
+
+#ifndef INGEST_H_
+#define INGEST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame.h"
+#include "store.h"
+
+#define INGEST_CYCLE_MS 1000 // one control cycle, TICK_PERIOD (scheduler.h)
+#define INGEST_RESEND_SPAN 64 // records, well over a full protocol window of batches
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t frames; // good frames
+    uint64_t badFrames; // failed COBS or CRC
+    uint64_t telemetryFrames;
+    uint64_t records; // stored
+    uint64_t duplicates; // dropped, seq not past the node's newest record
+    uint64_t storeErrors; // lost, the file could not grow
+    uint64_t logFrames;
+    uint64_t statsFrames;
+    uint64_t acks;
+} IngestStats;
+
+typedef struct {
+    Store *store;
+    IngestStats stats;
+} Ingest;
+
+typedef struct {
+    FrameReader reader;
+    uint8_t seq; // of the next frame sent back
+} IngestStream;
+
+// bytes to send back on the stream they came from
+typedef void (*IngestReplyFn)(const uint8_t *data, size_t len, void *arg);
+
+void ingestInit(Ingest *ingest, Store *store);
+void ingestStreamInit(IngestStream *stream);
+void ingestBytes(Ingest *ingest, IngestStream *stream, const uint8_t *data, size_t len, int64_t now,
+                 IngestReplyFn reply, void *arg);
+
+#endif /* INGEST_H_ */
@@ -0,0 +1,348 @@
+#define _GNU_SOURCE // mremap()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "store.h"
+
+#define STORE_CHUNKS_OFFSET (sizeof(StoreHeader) + STORE_NODES * sizeof(StoreNode))
+#define STORE_CHUNKS_START 1024 // room in a new file
+
+static size_t fileLen(uint32_t chunks) {
+    return STORE_CHUNKS_OFFSET + (size_t)chunks * sizeof(StoreChunk);
+}
+
+static void mapped(Store *store) { // pointers into a new mapping
+    store->header = (StoreHeader *)store->map;
+    store->nodes = (StoreNode *)(store->map + sizeof(StoreHeader));
+    store->chunks = (StoreChunk *)(store->map + STORE_CHUNKS_OFFSET);
+    store->chunksMapped = (uint32_t)((store->mapLen - STORE_CHUNKS_OFFSET) / sizeof(StoreChunk));
+}
+
+static int openFailed(Store *store, int error) {
+    if(store->map) {
+        munmap(store->map, store->mapLen);
+        store->map = 0;
+    }
+    close(store->fd);
+    store->fd = -1;
+    errno = error;
+    return 0;
+}
+
+int storeOpen(Store *store, const char *path, int writable) {
+    // 1 if open, 0 with errno set if the file cannot be opened, is not a store (EINVAL) or has a writer (EWOULDBLOCK)
+    struct stat st;
+    uint32_t node;
+    int fresh;
+
+    memset(store, 0, sizeof *store);
+    store->writable = writable;
+    store->fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if(store->fd < 0) {
+        return 0;
+    }
+    if(writable && flock(store->fd, LOCK_EX | LOCK_NB) != 0) { // one fleetd per file
+        return openFailed(store, errno);
+    }
+    if(fstat(store->fd, &st) != 0) {
+        return openFailed(store, errno);
+    }
+    fresh = (st.st_size == 0);
+    if(fresh) {
+        if(!writable) {
+            return openFailed(store, EINVAL);
+        }
+        st.st_size = (off_t)fileLen(STORE_CHUNKS_START);
+        if(ftruncate(store->fd, st.st_size) != 0) {
+            return openFailed(store, errno);
+        }
+    }
+    if((size_t)st.st_size < fileLen(0)) {
+        return openFailed(store, EINVAL);
+    }
+
+    store->mapLen = (size_t)st.st_size;
+    store->map = mmap(0, store->mapLen, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, store->fd, 0);
+    if(store->map == MAP_FAILED) {
+        store->map = 0;
+        return openFailed(store, errno);
+    }
+    mapped(store);
+
+    if(fresh) { // the rest of the header is already zero
+        store->header->magic = STORE_MAGIC;
+        store->header->version = STORE_VERSION;
+        store->header->chunkRecords = STORE_CHUNK_RECORDS;
+        store->header->chunks = store->chunksMapped;
+        for(node = 0; node < STORE_NODES; node++) {
+            store->nodes[node].firstChunk = store->nodes[node].lastChunk = STORE_NONE;
+            store->nodes[node].markChunk = STORE_NONE;
+        }
+    } else if(store->header->magic != STORE_MAGIC || store->header->version != STORE_VERSION ||
+              store->header->chunkRecords != STORE_CHUNK_RECORDS || store->header->chunks > store->chunksMapped) {
+        return openFailed(store, EINVAL);
+    }
+    return 1;
+}
+
+void storeClose(Store *store) {
+    if(store->map) {
+        if(store->writable) {
+            msync(store->map, store->mapLen, MS_SYNC);
+        }
+        munmap(store->map, store->mapLen);
+        store->map = 0;
+    }
+    if(store->fd >= 0) {
+        close(store->fd); // drops the writer's lock
+        store->fd = -1;
+    }
+}
+
+int storeSync(Store *store, int wait) { // 1 once written back, or queued for it unless wait
+    return msync(store->map, store->mapLen, wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+const StoreNode *storeNode(const Store *store, uint16_t node) {
+    return &store->nodes[node];
+}
+
+static int grow(Store *store) { // doubles the room for chunks
+    uint32_t chunks = store->header->chunks * 2;
+    size_t len = fileLen(chunks);
+    void *map;
+
+    if(ftruncate(store->fd, (off_t)len) != 0) {
+        return 0;
+    }
+    map = mremap(store->map, store->mapLen, len, MREMAP_MAYMOVE);
+    if(map == MAP_FAILED) {
+        return 0;
+    }
+    store->map = map;
+    store->mapLen = len;
+    mapped(store);
+    store->header->chunks = chunks;
+    return 1;
+}
+
+static uint32_t newChunk(Store *store, uint16_t node) { // appended to the node's list, STORE_NONE if no room
+    StoreNode *entry;
+    StoreChunk *chunk;
+    uint32_t idx;
+
+    if(store->header->chunksUsed == store->header->chunks && !grow(store)) {
+        return STORE_NONE;
+    }
+    entry = &store->nodes[node]; // after grow(), the mapping may have moved
+    idx = store->header->chunksUsed;
+    chunk = &store->chunks[idx];
+    chunk->next = STORE_NONE;
+    chunk->node = node;
+    chunk->count = 0;
+    chunk->number = entry->chunkCount;
+    chunk->ahead = STORE_NONE;
+
+    if(entry->lastChunk == STORE_NONE) {
+        entry->firstChunk = idx;
+    } else {
+        store->chunks[entry->lastChunk].next = idx;
+    }
+    if(chunk->number % STORE_SKIP == 0) {
+        if(entry->markChunk != STORE_NONE) {
+            store->chunks[entry->markChunk].ahead = idx;
+        }
+        entry->markChunk = idx;
+    }
+    entry->lastChunk = idx;
+    entry->chunkCount++;
+    store->header->chunksUsed++;
+    return idx;
+}
+
+int storeAppend(Store *store, uint16_t node, const StoreRecord *record) {
+    // 1 if stored, 0 if older than the node's newest record, -1 if the file could not grow
+    StoreNode *entry = &store->nodes[node];
+    StoreChunk *chunk;
+    uint32_t idx = entry->lastChunk;
+    uint16_t pos;
+
+    if(entry->records && record->time < entry->lastTime) {
+        return 0;
+    }
+    if(idx == STORE_NONE || store->chunks[idx].count == STORE_CHUNK_RECORDS) {
+        idx = newChunk(store, node);
+        if(idx == STORE_NONE) {
+            return -1;
+        }
+        entry = &store->nodes[node];
+    }
+
+    chunk = &store->chunks[idx];
+    pos = chunk->count;
+    chunk->time[pos] = record->time;
+    chunk->seq[pos] = record->seq;
+    chunk->moisture[pos] = record->moisture;
+    chunk->temp[pos] = record->temp;
+    chunk->hoursLeft[pos] = record->hoursLeft;
+    chunk->cycles[pos] = record->cycles;
+    chunk->zoneValve[pos] = (uint8_t)((record->zone & 0x07) << 4 | (record->valve ? 1 : 0));
+    chunk->level[pos] = record->level;
+    if(pos == 0) {
+        chunk->firstTime = record->time;
+    }
+    chunk->lastTime = record->time;
+    chunk->count = pos + 1; // last, so a reader never sees a half written record
+
+    if(entry->records == 0) {
+        entry->firstTime = record->time;
+        store->header->nodes++;
+    }
+    entry->lastTime = record->time;
+    entry->lastSeq = record->seq;
+    entry->lastZone = record->zone & 0x07;
+    entry->records++;
+    store->header->records++;
+    return 1;
+}
+
+static uint32_t startChunk(const Store *store, uint16_t node, int64_t from) { // first chunk with records from `from` on
+    const StoreChunk *chunk;
+    uint32_t idx = store->nodes[node].firstChunk;
+    uint32_t ahead;
+
+    while(idx < store->chunksMapped) { // STORE_NONE is above any index
+        chunk = &store->chunks[idx];
+        ahead = chunk->ahead;
+        if(ahead < store->chunksMapped && store->chunks[ahead].count && store->chunks[ahead].firstTime < from) {
+            idx = ahead; // everything before it is older than from
+        } else if(chunk->count && chunk->lastTime < from) {
+            idx = chunk->next;
+        } else {
+            return idx;
+        }
+    }
+    return STORE_NONE;
+}
+
+static uint16_t lowerBound(const int64_t *time, uint16_t count, int64_t from) { // first position not before from
+    uint16_t low = 0, high = count, mid;
+
+    while(low < high) {
+        mid = (uint16_t)((low + high) / 2);
+        if(time[mid] < from) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+uint64_t storeRange(const Store *store, uint16_t node, int zone, int64_t from, int64_t to, StoreRecordFn fn,
+                    void *arg) { // records found, in time order; fn may be 0 to only count them
+    const StoreChunk *chunk;
+    StoreRecord record;
+    uint64_t found = 0;
+    uint32_t idx;
+    uint16_t count, pos;
+
+    for(idx = startChunk(store, node, from); idx < store->chunksMapped; idx = chunk->next) {
+        chunk = &store->chunks[idx];
+        count = chunk->count;
+        if(count == 0 || chunk->firstTime >= to) {
+            break;
+        }
+        for(pos = lowerBound(chunk->time, count, from); pos < count && chunk->time[pos] < to; pos++) {
+            if(zone != STORE_ZONE_ANY && (chunk->zoneValve[pos] >> 4) != zone) {
+                continue;
+            }
+            found++;
+            if(fn) {
+                record.time = chunk->time[pos];
+                record.seq = chunk->seq[pos];
+                record.moisture = chunk->moisture[pos];
+                record.temp = chunk->temp[pos];
+                record.zone = chunk->zoneValve[pos] >> 4;
+                record.valve = chunk->zoneValve[pos] & 1;
+                record.level = chunk->level[pos];
+                record.hoursLeft = chunk->hoursLeft[pos];
+                record.cycles = chunk->cycles[pos];
+                if(fn(&record, arg)) {
+                    return found;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+size_t storeDownsample(const Store *store, uint16_t node, int zone, int64_t from, int64_t to, int64_t width,
+                       StoreBucket *buckets, size_t maxBuckets) {
+    // buckets of width ms from `from` on, as many as [from, to) needs up to maxBuckets; returns how many
+    const StoreChunk *chunk;
+    StoreBucket *bucket;
+    size_t count, idx;
+    uint32_t chunkIdx;
+    uint16_t records, pos;
+
+    if(width <= 0 || to <= from || maxBuckets == 0) {
+        return 0;
+    }
+    count = (size_t)((to - from - 1) / width + 1);
+    if(count > maxBuckets) {
+        count = maxBuckets;
+        to = from + (int64_t)count * width;
+    }
+    for(idx = 0; idx < count; idx++) {
+        buckets[idx] = (StoreBucket){from + (int64_t)idx * width, 0, 0, 0xFFFF, 0, 0.0, 32767, -32768, 0.0};
+    }
+
+    for(chunkIdx = startChunk(store, node, from); chunkIdx < store->chunksMapped; chunkIdx = chunk->next) {
+        chunk = &store->chunks[chunkIdx];
+        records = chunk->count;
+        if(records == 0 || chunk->firstTime >= to) {
+            break;
+        }
+        for(pos = lowerBound(chunk->time, records, from); pos < records && chunk->time[pos] < to; pos++) {
+            if(zone != STORE_ZONE_ANY && (chunk->zoneValve[pos] >> 4) != zone) {
+                continue;
+            }
+            bucket = &buckets[(chunk->time[pos] - from) / width];
+            bucket->count++;
+            bucket->valveOpen += chunk->zoneValve[pos] & 1;
+            bucket->moistureMean += chunk->moisture[pos]; // sums until the end
+            bucket->tempMean += chunk->temp[pos];
+            if(chunk->moisture[pos] < bucket->moistureMin) {
+                bucket->moistureMin = chunk->moisture[pos];
+            }
+            if(chunk->moisture[pos] > bucket->moistureMax) {
+                bucket->moistureMax = chunk->moisture[pos];
+            }
+            if(chunk->temp[pos] < bucket->tempMin) {
+                bucket->tempMin = chunk->temp[pos];
+            }
+            if(chunk->temp[pos] > bucket->tempMax) {
+                bucket->tempMax = chunk->temp[pos];
+            }
+        }
+    }
+
+    for(idx = 0; idx < count; idx++) {
+        bucket = &buckets[idx];
+        if(bucket->count) {
+            bucket->moistureMean /= bucket->count;
+            bucket->tempMean /= bucket->count;
+        } else {
+            bucket->moistureMin = bucket->moistureMax = 0;
+            bucket->tempMin = bucket->tempMax = 0;
+        }
+    }
+    return count;
+}
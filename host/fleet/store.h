@@ -0,0 +1,124 @@
+/*
+ store.h
+ The fleet aggregator's time-series file: telemetry records (telemetry.h) of up to 65536 nodes, memory mapped
+ and laid out in columns. The file is a header, a per-node index addressed directly by the 16-bit node ID, and
+ chunks of STORE_CHUNK_RECORDS records. A chunk belongs to one node and holds each field as its own array
+ (time, seq, moisture, ...), so a query that only needs time and moisture touches only those; the chunks of a
+ node are linked oldest first and each carries the time span it covers.
+
+ Records of a node are appended in time order, which keeps every chunk sorted: a range query skips whole chunks
+ by their time span, STORE_SKIP at a time while it can, and binary searches the first one it needs. A downsample
+ query folds a range into buckets of a fixed width: the count, mean, minimum and maximum of moisture and
+ temperature and how many records had the valve open. Ranges are [from, to), times in ms since the epoch.
+
+ One process writes (fleetd), any number can read; a reader sees the chunks that were there when it opened the
+ file. The file grows by doubling, the new space is sparse until chunks are handed out.
+ */
+
+#ifndef STORE_H_
+#define STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STORE_MAGIC 0x54534C46UL // "FLST"
+#define STORE_VERSION 1
+#define STORE_NODES 65536 // node IDs are 16 bits
+#define STORE_CHUNK_RECORDS 128
+#define STORE_SKIP 32 // chunks jumped by StoreChunk.ahead
+#define STORE_NONE 0xFFFFFFFFUL // no chunk
+#define STORE_ZONE_ANY -1 // every zone
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunkRecords; // STORE_CHUNK_RECORDS of the build that made the file
+    uint32_t chunks; // room in the file
+    uint32_t chunksUsed;
+    uint32_t nodes; // nodes with records
+    uint64_t records;
+    uint8_t reserved[32];
+} StoreHeader;
+
+typedef struct {
+    uint32_t firstChunk; // STORE_NONE while the node has no records
+    uint32_t lastChunk; // the one being filled
+    uint32_t markChunk; // newest chunk whose number is a multiple of STORE_SKIP
+    uint32_t chunkCount;
+    uint64_t records;
+    int64_t firstTime;
+    int64_t lastTime;
+    uint16_t lastSeq; // seq and zone of the newest record, ingest.h follows the node's samples with them
+    uint8_t lastZone;
+    uint8_t reserved[5];
+} StoreNode;
+
+typedef struct {
+    uint32_t next; // next chunk of the same node, STORE_NONE for the last
+    uint16_t node;
+    uint16_t count; // records in the chunk
+    int64_t firstTime;
+    int64_t lastTime;
+    uint32_t number; // position in the node's list, from 0
+    uint32_t ahead; // on chunks numbered a multiple of STORE_SKIP the next such chunk, else STORE_NONE
+    int64_t time[STORE_CHUNK_RECORDS];
+    uint16_t seq[STORE_CHUNK_RECORDS];
+    uint16_t moisture[STORE_CHUNK_RECORDS];
+    int16_t temp[STORE_CHUNK_RECORDS]; // tenths of a degree
+    uint16_t hoursLeft[STORE_CHUNK_RECORDS];
+    uint16_t cycles[STORE_CHUNK_RECORDS];
+    uint8_t zoneValve[STORE_CHUNK_RECORDS]; // byte 6 of the record, zone in bits 4-6, valve in bit 0
+    uint8_t level[STORE_CHUNK_RECORDS];
+} StoreChunk;
+
+typedef struct {
+    int64_t time;
+    uint16_t seq;
+    uint16_t moisture;
+    int16_t temp;
+    uint8_t zone;
+    uint8_t valve;
+    uint8_t level;
+    uint16_t hoursLeft;
+    uint16_t cycles;
+} StoreRecord;
+
+typedef struct {
+    int64_t start; // first ms of the bucket
+    uint32_t count; // records, 0 for an empty bucket
+    uint32_t valveOpen; // records with the valve open
+    uint16_t moistureMin;
+    uint16_t moistureMax;
+    double moistureMean;
+    int16_t tempMin;
+    int16_t tempMax;
+    double tempMean;
+} StoreBucket;
+
+typedef struct {
+    int fd;
+    int writable;
+    uint8_t *map;
+    size_t mapLen;
+    StoreHeader *header;
+    StoreNode *nodes; // STORE_NODES entries
+    StoreChunk *chunks;
+    uint32_t chunksMapped; // chunks inside the mapping, a reader may see the header count more
+} Store;
+
+// a record of a range query, return nonzero to stop
+typedef int (*StoreRecordFn)(const StoreRecord *record, void *arg);
+
+int storeOpen(Store *store, const char *path, int writable);
+void storeClose(Store *store);
+int storeSync(Store *store, int wait);
+
+int storeAppend(Store *store, uint16_t node, const StoreRecord *record);
+const StoreNode *storeNode(const Store *store, uint16_t node);
+
+uint64_t storeRange(const Store *store, uint16_t node, int zone, int64_t from, int64_t to, StoreRecordFn fn,
+                    void *arg);
+size_t storeDownsample(const Store *store, uint16_t node, int zone, int64_t from, int64_t to, int64_t width,
+                       StoreBucket *buckets, size_t maxBuckets);
+
+#endif /* STORE_H_ */
@@ -0,0 +1,133 @@
+#include "frame.h"
+
+uint16_t frameCrc16(const uint8_t *data, size_t len) { // polynomial 0x1021, initial value 0xFFFF, MSB first
+    uint16_t crc = 0xFFFF;
+    size_t idx;
+    int bit;
+
+    for(idx = 0; idx < len; idx++) {
+        crc ^= (uint16_t)data[idx] << 8;
+        for(bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+size_t frameCobsEncode(const uint8_t *src, size_t len, uint8_t *dest) {
+    size_t codeIdx = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    size_t idx;
+
+    for(idx = 0; idx < len; idx++) {
+        if(src[idx] == 0) {
+            dest[codeIdx] = code;
+            codeIdx = out++;
+            code = 1;
+        } else {
+            dest[out++] = src[idx];
+            if(++code == 0xFF) {
+                dest[codeIdx] = code;
+                codeIdx = out++;
+                code = 1;
+            }
+        }
+    }
+    dest[codeIdx] = code;
+    return out;
+}
+
+size_t frameCobsDecode(const uint8_t *src, size_t len, uint8_t *dest) { // 0 if malformed
+    size_t idx = 0;
+    size_t out = 0;
+    uint8_t code, copy;
+
+    while(idx < len) {
+        code = src[idx++];
+        if(code == 0 || idx + code - 1 > len) {
+            return 0;
+        }
+        for(copy = 1; copy < code; copy++) {
+            dest[out++] = src[idx++];
+        }
+        if(code < 0xFF && idx < len) {
+            dest[out++] = 0;
+        }
+    }
+    return out;
+}
+
+size_t frameEncode(uint8_t type, uint8_t seq, int withNode, uint16_t node, const uint8_t *payload, size_t len,
+                   uint8_t *out) { // COBS bytes and the delimiter, 0 if the payload is too long
+    uint8_t raw[FRAME_RAW_MAX];
+    size_t rawLen = 0;
+    size_t idx;
+    uint16_t crc;
+
+    if(len > FRAME_PAYLOAD_MAX) {
+        return 0;
+    }
+    raw[rawLen++] = type;
+    raw[rawLen++] = seq;
+    if(withNode) {
+        raw[rawLen++] = (uint8_t)node;
+        raw[rawLen++] = (uint8_t)(node >> 8);
+    }
+    for(idx = 0; idx < len; idx++) {
+        raw[rawLen++] = payload[idx];
+    }
+    crc = frameCrc16(raw, rawLen);
+    raw[rawLen++] = (uint8_t)crc;
+    raw[rawLen++] = (uint8_t)(crc >> 8);
+
+    rawLen = frameCobsEncode(raw, rawLen, out);
+    out[rawLen++] = 0;
+    return rawLen;
+}
+
+int frameParse(const uint8_t *raw, size_t len, int withNode, Frame *frame) { // 1 if the CRC is good
+    size_t header = withNode ? 4 : 2;
+    uint16_t crc;
+
+    if(len < header + 2) {
+        return 0;
+    }
+    crc = frameCrc16(raw, len - 2);
+    if(raw[len - 2] != (uint8_t)crc || raw[len - 1] != (uint8_t)(crc >> 8)) {
+        return 0;
+    }
+    frame->type = raw[0];
+    frame->seq = raw[1];
+    frame->node = withNode ? (uint16_t)(raw[2] | (raw[3] << 8)) : 0;
+    frame->payload = &raw[header];
+    frame->len = len - header - 2;
+    return 1;
+}
+
+void frameReaderInit(FrameReader *reader) {
+    reader->len = 0;
+    reader->discard = 0;
+}
+
+int frameReaderPush(FrameReader *reader, uint8_t byte, int withNode, Frame *frame) {
+    // feed one received byte, 1 when it completed a frame with a good CRC
+    size_t rawLen;
+
+    if(byte != 0) {
+        if(reader->len < sizeof reader->buf) {
+            reader->buf[reader->len++] = byte;
+        } else {
+            reader->discard = 1;
+        }
+        return 0;
+    }
+    if(reader->discard || reader->len == 0) {
+        reader->len = 0;
+        reader->discard = 0;
+        return 0;
+    }
+    rawLen = frameCobsDecode(reader->buf, reader->len, reader->raw);
+    reader->len = 0;
+    return rawLen != 0 && frameParse(reader->raw, rawLen, withNode, frame);
+}
@@ -0,0 +1,48 @@
+/*
+ frame.h
+ Host side of the link protocol (protocol.h): CRC-16/CCITT-FALSE, COBS, and building and parsing frames in
+ both directions. Used by the simulated gateway (sim/gateway.c), the tests and the fleet aggregator, so all of
+ them read exactly what the firmware writes. Frames from a node are
+
+    type, seq, node ID (2 bytes), payload, CRC-16 (2 bytes), COBS encoded and ended with 0x00
+
+ and frames from the gateway the same without the node ID.
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_PAYLOAD_MAX 255 // host buffers take any frame the firmware could send
+#define FRAME_RAW_MAX (FRAME_PAYLOAD_MAX + 6)
+#define FRAME_COBS_MAX (FRAME_RAW_MAX + FRAME_RAW_MAX / 254 + 2) // plus the delimiter
+
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint16_t node; // 0 for gateway frames
+    const uint8_t *payload; // points into the raw frame it was parsed from
+    size_t len;
+} Frame;
+
+typedef struct {
+    uint8_t buf[FRAME_COBS_MAX]; // COBS bytes of the frame being received
+    size_t len;
+    int discard; // frame too long, skip to the next delimiter
+    uint8_t raw[FRAME_RAW_MAX]; // last decoded frame, Frame.payload points here
+} FrameReader;
+
+uint16_t frameCrc16(const uint8_t *data, size_t len);
+size_t frameCobsEncode(const uint8_t *src, size_t len, uint8_t *dest);
+size_t frameCobsDecode(const uint8_t *src, size_t len, uint8_t *dest);
+
+size_t frameEncode(uint8_t type, uint8_t seq, int withNode, uint16_t node, const uint8_t *payload, size_t len,
+                   uint8_t *out);
+int frameParse(const uint8_t *raw, size_t len, int withNode, Frame *frame);
+
+void frameReaderInit(FrameReader *reader);
+int frameReaderPush(FrameReader *reader, uint8_t byte, int withNode, Frame *frame);
+
+#endif /* FRAME_H_ */
@@ -0,0 +1,90 @@
+/*
+ hal_host.h
+ The hal.h functions for builds that are not for the MSP430 (__MSP430__ not defined). Same names and
+ arguments as the static inline target versions in hal.h, implemented by a host backend; host/sim/hal_sim.c
+ is the one in this tree. Interrupt handlers become plain functions the backend calls when their interrupt is
+ due, and HAL_WAKE_ON_EXIT() tells it the CPU leaves halSleep() after the handler.
+ */
+
+#ifndef HAL_HOST_H_
+#define HAL_HOST_H_
+
+#define HAL_ISR(vec, name) void name(void)
+#define HAL_WAKE_ON_EXIT() halWakeOnExit()
+
+// interrupt handlers of the firmware modules, called by the backend
+void adcIsr(void);
+void uartIsr(void);
+void spiIsr(void);
+void servoIsr(void);
+void tickIsr(void);
+void buttonPollIsr(void);
+void thresButtonIsr(void);
+void refillButtonIsr(void);
+
+void halWakeOnExit();
+
+unsigned short halIrqSave();
+void halIrqRestore(unsigned short state);
+void halIrqOff();
+void halIrqOn();
+void halSleep(unsigned char deep);
+
+void halClockInit(unsigned short dcorsel, unsigned short flln, unsigned short nwaits, unsigned short tries);
+void halClockDivide(unsigned short divm, unsigned short divs);
+
+unsigned short halResetCause();
+void halWatchdogSet(unsigned short ctl);
+
+unsigned short halTlvWord(unsigned short addr);
+unsigned short halCrc16(const unsigned char *data, unsigned char len);
+
+void halGpioInit();
+void halLedRed(unsigned char on);
+void halLedGreen(unsigned char on);
+unsigned char halLedGreenIsOn();
+unsigned char halThresButtonDown();
+unsigned char halRefillButtonDown();
+void halButtonIrq(unsigned char on);
+void halThresButtonAck();
+void halRefillButtonAck();
+void halSpiSelect(unsigned char pin);
+void halSpiDeselect(unsigned char pin);
+
+void halAdcPin(unsigned char input);
+void halAdcInit(unsigned short mctl);
+void halAdcSelect(unsigned short mctl);
+void halAdcStart();
+unsigned short halAdcResult();
+unsigned short halAdcIv();
+
+void halTickStart(unsigned short period);
+void halTickAlarm(unsigned short at);
+void halTickAlarmOff();
+unsigned short halTickCount();
+unsigned short halTickIv();
+
+void halProfStart();
+unsigned short halProfCount();
+
+void halPwmOutputs(unsigned char channels, unsigned short mode);
+void halPwmInit(unsigned char channels, unsigned short period, unsigned short id);
+void halPwmRun(unsigned char on);
+void halPwmSet(unsigned char channel, unsigned short width);
+void halPwmPeriodIrq(unsigned char on);
+
+void halUartInit(unsigned short brw, unsigned short mctlw);
+void halUartPut(unsigned char byte);
+unsigned char halUartGet();
+void halUartTxIrq(unsigned char on);
+void halUartTxDoneIrq(unsigned char on);
+unsigned short halUartIv();
+
+void halSpiInit(unsigned short brw);
+void halSpiEnable(unsigned char on);
+void halSpiPut(unsigned char byte);
+unsigned char halSpiGet();
+void halSpiRxIrq(unsigned char on);
+unsigned short halSpiIv();
+
+#endif /* HAL_HOST_H_ */
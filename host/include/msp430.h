@@ -0,0 +1,144 @@
+/*
+ msp430.h
+ Host shim for the TI device header. The firmware modules only reach the hardware through hal.h, but they
+ still use the device header's bit and field constants as values: ADCMCTL0 channel codes in zone.c, OUTMOD_x
+ in servo.c, interrupt vector values in the handlers, the UCOS16 bit of uartDividers(), ... This header
+ supplies those with the values of msp430fr2355.h, so the modules compile unmodified on the host and the
+ values a host backend sees are the ones the target would write. It has no registers; anything that would
+ need one goes through hal.h and the host backend.
+
+ Only what the firmware uses is here; add constants from the device header as modules start to use them.
+ */
+
+#ifndef MSP430_H_HOST_SHIM_
+#define MSP430_H_HOST_SHIM_
+
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+#define BIT8 (0x0100)
+#define BIT9 (0x0200)
+#define BITA (0x0400)
+#define BITB (0x0800)
+#define BITC (0x1000)
+#define BITD (0x2000)
+#define BITE (0x4000)
+#define BITF (0x8000)
+
+// ADCMCTL0
+#define ADCSREF_0 (0x0000) // AVCC and AVSS
+#define ADCSREF_1 (0x0010) // internal reference and AVSS
+#define ADCINCH_0 (0x0000)
+#define ADCINCH_1 (0x0001)
+#define ADCINCH_2 (0x0002)
+#define ADCINCH_3 (0x0003)
+#define ADCINCH_4 (0x0004)
+#define ADCINCH_5 (0x0005)
+#define ADCINCH_6 (0x0006)
+#define ADCINCH_7 (0x0007)
+#define ADCINCH_8 (0x0008)
+#define ADCINCH_9 (0x0009)
+#define ADCINCH_10 (0x000A)
+#define ADCINCH_11 (0x000B)
+#define ADCINCH_12 (0x000C) // temperature sensor
+#define ADCINCH_13 (0x000D)
+#define ADCINCH_14 (0x000E)
+#define ADCINCH_15 (0x000F)
+
+// interrupt vector register values
+#define ADCIV_NONE (0x0000)
+#define ADCIV_ADCIFG (0x000C)
+#define TB0IV_NONE (0x0000)
+#define TB0IV_TBCCR1 (0x0002)
+#define TB0IV_TBCCR2 (0x0004)
+#define TB0IV_TBIFG (0x000E)
+#define USCI_NONE (0x0000)
+#define USCI_UART_UCRXIFG (0x0002)
+#define USCI_UART_UCTXIFG (0x0004)
+#define USCI_UART_UCSTTIFG (0x0006)
+#define USCI_UART_UCTXCPTIFG (0x0008)
+#define USCI_SPI_UCRXIFG (0x0002)
+#define USCI_SPI_UCTXIFG (0x0004)
+
+// reset causes, SYSRSTIV
+#define SYSRSTIV_NONE (0x0000)
+#define SYSRSTIV_BOR (0x0002) // brownout, the normal power-up
+#define SYSRSTIV_RSTNMI (0x0004)
+#define SYSRSTIV_DOBOR (0x0006)
+#define SYSRSTIV_SECYV (0x000A)
+#define SYSRSTIV_DOPOR (0x0012)
+#define SYSRSTIV_WDTTO (0x0016) // watchdog timeout
+#define SYSRSTIV_WDTPW (0x0018)
+#define SYSRSTIV_FRCTLPW (0x001A)
+#define SYSRSTIV_PMMPW (0x0020)
+#define SYSRSTIV_FLLUL (0x0024)
+
+// WDTCTL, without the password
+#define WDTHOLD (0x0080)
+#define WDTSSEL__SMCLK (0x0000)
+#define WDTSSEL__ACLK (0x0020)
+#define WDTSSEL__VLO (0x0040)
+#define WDTTMSEL (0x0010)
+#define WDTCNTCL (0x0008)
+#define WDTIS__2G (0x0000)
+#define WDTIS__128M (0x0001)
+#define WDTIS__8192K (0x0002)
+#define WDTIS__512K (0x0003)
+#define WDTIS__32K (0x0004)
+#define WDTIS__8192 (0x0005)
+#define WDTIS__512 (0x0006)
+#define WDTIS__64 (0x0007)
+#define WDTIS (0x0007)
+
+// clock system and FRAM controller
+#define DCORSEL_0 (0x0000) // 1 MHz
+#define DCORSEL_1 (0x0002) // 2 MHz
+#define DCORSEL_2 (0x0004) // 4 MHz
+#define DCORSEL_3 (0x0006) // 8 MHz
+#define DCORSEL_4 (0x0008) // 12 MHz
+#define DCORSEL_5 (0x000A) // 16 MHz
+#define DCORSEL_6 (0x000C) // 20 MHz
+#define DCORSEL_7 (0x000E) // 24 MHz
+#define NWAITS_0 (0x0000)
+#define NWAITS_1 (0x0010)
+#define NWAITS_2 (0x0020)
+#define DIVM__1 (0x0000)
+#define DIVM__2 (0x0001)
+#define DIVM__4 (0x0002)
+#define DIVM__8 (0x0003)
+#define DIVM__16 (0x0004)
+#define DIVM__32 (0x0005)
+#define DIVM__64 (0x0006)
+#define DIVM__128 (0x0007)
+#define DIVM (0x0007)
+#define DIVS__1 (0x0000)
+#define DIVS__2 (0x0010)
+#define DIVS__4 (0x0020)
+#define DIVS__8 (0x0030)
+#define DIVS (0x0030)
+
+// timers
+#define ID__1 (0x0000)
+#define ID__2 (0x0040)
+#define ID__4 (0x0080)
+#define ID__8 (0x00C0)
+#define ID (0x00C0)
+#define OUTMOD_0 (0x0000) // OUT bit
+#define OUTMOD_1 (0x0020) // set
+#define OUTMOD_2 (0x0040) // toggle/reset
+#define OUTMOD_3 (0x0060) // set/reset
+#define OUTMOD_4 (0x0080) // toggle
+#define OUTMOD_5 (0x00A0) // reset
+#define OUTMOD_6 (0x00C0) // toggle/set
+#define OUTMOD_7 (0x00E0) // reset/set
+#define OUTMOD (0x00E0)
+
+// eUSCI_A UART
+#define UCOS16 (0x0001)
+
+#endif /* MSP430_H_HOST_SHIM_ */
@@ -0,0 +1,39 @@
+# Runs watersim with the dose controller (DOSE) and with the open-while-dry logic it replaced (BANG) on the same
+# plant, and fails unless the controller uses at most WATER_PERCENT of the water and spends at most BAND_PERCENT of
+# the time out of band, too dry or saturated: cmake -DDOSE=... -DBANG=... -DARGS="-d;3" -P compare.cmake
+set(WATER_PERCENT 60)
+set(BAND_PERCENT 50)
+
+function(run exe prefix) # sets ${prefix}_ML and ${prefix}_BAND, tenths of an hour, summed over the zones
+    execute_process(COMMAND ${exe} ${ARGS} OUTPUT_VARIABLE out RESULT_VARIABLE failed)
+    if(failed)
+        message(FATAL_ERROR "${exe} failed:\n${out}")
+    endif()
+    set(ml 0)
+    set(band 0)
+    string(REGEX MATCHALL "poured [0-9]+ mL[^\n]* [0-9]+\\.[0-9] h too dry, [0-9]+\\.[0-9] h saturated" zones "${out}")
+    foreach(zone IN LISTS zones)
+        string(REGEX MATCH "poured ([0-9]+) mL.* ([0-9]+)\\.([0-9]) h too dry, ([0-9]+)\\.([0-9]) h saturated" _ "${zone}")
+        math(EXPR ml "${ml} + ${CMAKE_MATCH_1}")
+        math(EXPR band "${band} + ${CMAKE_MATCH_2}${CMAKE_MATCH_3} + ${CMAKE_MATCH_4}${CMAKE_MATCH_5}")
+    endforeach()
+    if(NOT zones)
+        message(FATAL_ERROR "no zone lines in the output of ${exe}:\n${out}")
+    endif()
+    set(${prefix}_ML ${ml} PARENT_SCOPE)
+    set(${prefix}_BAND ${band} PARENT_SCOPE)
+endfunction()
+
+run(${DOSE} DOSE)
+run(${BANG} BANG)
+message("dose controller: ${DOSE_ML} mL poured, ${DOSE_BAND} tenths of an hour out of band")
+message("bang-bang:       ${BANG_ML} mL poured, ${BANG_BAND} tenths of an hour out of band")
+math(EXPR waterMax "${BANG_ML} * ${WATER_PERCENT} / 100")
+math(EXPR bandMax "${BANG_BAND} * ${BAND_PERCENT} / 100")
+if(DOSE_ML GREATER waterMax)
+    message(FATAL_ERROR "the dose controller poured ${DOSE_ML} mL, more than ${WATER_PERCENT}% of bang-bang's")
+endif()
+if(DOSE_BAND GREATER bandMax)
+    message(FATAL_ERROR "the dose controller was out of band for ${DOSE_BAND} tenths of an hour, more than "
+        "${BAND_PERCENT}% of bang-bang's")
+endif()
@@ -0,0 +1,117 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp01.h"
+
+#define ESP01_OUT_MAX 4096 // bytes from the node waiting for the next poll
+#define ESP01_REPLY_MS 1000 // real time the reply to a frame may take before the simulation goes on
+
+static int esp01Fd = -1;
+static double esp01Speedup;
+static uint64_t realStart; // ns, when simulated time was 0
+static unsigned char out[ESP01_OUT_MAX];
+static size_t outLen;
+static Esp01Stats stats;
+
+static uint64_t realNs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int esp01Connect(const char *host, const char *port, double speedup) { // 1 once connected; speedup 0 is unpaced
+    struct addrinfo hints, *addr;
+    int one = 1;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, port, &hints, &addr) != 0) {
+        return 0;
+    }
+    esp01Fd = socket(addr->ai_family, SOCK_STREAM, 0);
+    if(esp01Fd >= 0 && connect(esp01Fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+        close(esp01Fd);
+        esp01Fd = -1;
+    }
+    freeaddrinfo(addr);
+    if(esp01Fd < 0) {
+        return 0;
+    }
+    setsockopt(esp01Fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    esp01Speedup = speedup;
+    realStart = speedup > 0.0 ? realNs() - (uint64_t)(simNow() / speedup) : 0;
+    outLen = 0;
+    stats = (Esp01Stats){0};
+    return 1;
+}
+
+const Esp01Stats *esp01Stats(void) {
+    return &stats;
+}
+
+void esp01Byte(unsigned char byte) { // SimByteFn
+    if(outLen < sizeof out) {
+        out[outLen++] = byte;
+    }
+}
+
+void esp01Poll(void) { // SimFn
+    unsigned char in[SIM_UART_RX_QUEUE];
+    struct pollfd reply;
+    struct timespec wait;
+    uint64_t due, now;
+    ssize_t len;
+    size_t sent = 0;
+
+    stats.polls++;
+    while(esp01Fd >= 0 && sent < outLen) { // the UART bytes of the last ESP01_POLL in one burst
+        len = send(esp01Fd, &out[sent], outLen - sent, MSG_NOSIGNAL);
+        if(len <= 0) {
+            close(esp01Fd); // fleetd went away, the node carries on without its ACKs
+            esp01Fd = -1;
+            break;
+        }
+        sent += (size_t)len;
+    }
+    stats.bytesOut += sent;
+    outLen = 0;
+
+    if(esp01Speedup > 0.0) {
+        due = realStart + (uint64_t)(simNow() / esp01Speedup);
+        now = realNs();
+        if(now < due) { // ahead of the speedup, the rest of the real time goes to fleetd
+            wait.tv_sec = (time_t)((due - now) / 1000000000ULL);
+            wait.tv_nsec = (long)((due - now) % 1000000000ULL);
+            nanosleep(&wait, 0);
+        } else {
+            stats.behind++;
+        }
+    }
+
+    if(esp01Fd < 0) {
+        return;
+    }
+    reply.fd = esp01Fd;
+    reply.events = POLLIN;
+    if(sent && poll(&reply, 1, ESP01_REPLY_MS) == 0) { // frames sent, wait for their ACKs
+        stats.late++;
+    }
+    len = recv(esp01Fd, in, sizeof in, MSG_DONTWAIT);
+    if(len > 0) {
+        simUartRx(in, (size_t)len, 0);
+        stats.bytesIn += (uint64_t)len;
+    } else if(len == 0) {
+        close(esp01Fd);
+        esp01Fd = -1;
+    }
+}
@@ -0,0 +1,31 @@
+/*
+ esp01.h
+ The ESP-01 in transparent mode, standing in for the simulated gateway (gateway.h) when a simulated node should
+ talk to a real fleetd: what the node sends on the UART goes out on a TCP connection, and what comes back is fed
+ to the node's UART receiver. esp01Poll() does both every ESP01_POLL of simulated time. After sending it waits
+ for the reply in real time, so the aggregator's ACKs reach the node inside its listen window (protocol.h) as
+ they would over Wi-Fi however fast the simulation runs; a speedup paces simulated time to a multiple of real
+ time on top of that.
+ */
+
+#ifndef ESP01_H_
+#define ESP01_H_
+
+#include "sim.h"
+
+#define ESP01_POLL (10 * SIM_MS)
+
+typedef struct {
+    uint64_t bytesOut;
+    uint64_t bytesIn;
+    uint64_t polls;
+    uint64_t behind; // polls that found the simulation slower than the speedup asks for
+    uint64_t late; // frames sent without a reply within ESP01_REPLY_MS
+} Esp01Stats;
+
+int esp01Connect(const char *host, const char *port, double speedup);
+void esp01Byte(unsigned char byte);
+void esp01Poll(void);
+const Esp01Stats *esp01Stats(void);
+
+#endif /* ESP01_H_ */
@@ -0,0 +1,124 @@
+#include "frame.h"
+#include "gateway.h"
+#include "protocol.h"
+#include "telemetry.h"
+
+#define GATEWAY_RECENT 16 // frame seqs remembered to spot resends
+
+static GatewayConfig gatewayConfig;
+static GatewayStats stats;
+static FrameReader reader;
+static unsigned char gatewaySeq;
+static unsigned char recentSeq[GATEWAY_RECENT];
+static unsigned char recentType[GATEWAY_RECENT];
+static unsigned char recentCount;
+static unsigned char recentNext;
+static unsigned short recordNext; // sequence number the next record should have
+static unsigned char recordStarted;
+static unsigned char replaySent;
+static unsigned char profileSent;
+
+void gatewayInit(const GatewayConfig *config) {
+    gatewayConfig = *config;
+    stats = (GatewayStats){0};
+    frameReaderInit(&reader);
+    gatewaySeq = 0;
+    recentCount = recentNext = 0;
+    recordStarted = 0;
+    replaySent = profileSent = 0;
+}
+
+const GatewayStats *gatewayStats(void) {
+    return &stats;
+}
+
+static unsigned char seenBefore(const Frame *frame) {
+    unsigned char idx;
+
+    for(idx = 0; idx < recentCount; idx++) {
+        if(recentSeq[idx] == frame->seq && recentType[idx] == frame->type) {
+            return 1;
+        }
+    }
+    recentSeq[recentNext] = frame->seq;
+    recentType[recentNext] = frame->type;
+    recentNext = (recentNext + 1) % GATEWAY_RECENT;
+    if(recentCount < GATEWAY_RECENT) {
+        recentCount++;
+    }
+    return 0;
+}
+
+static void telemetry(const Frame *frame) {
+    const uint8_t *record;
+    unsigned short seq;
+    size_t offset;
+
+    stats.telemetryFrames++;
+    for(offset = 0; offset + TELEMETRY_RECORD_LEN <= frame->len; offset += TELEMETRY_RECORD_LEN) {
+        record = &frame->payload[offset];
+        seq = (unsigned short)(record[0] | (record[1] << 8));
+        if(recordStarted && seq != recordNext) {
+            stats.recordsSkipped += (unsigned short)(seq - recordNext);
+        }
+        recordStarted = 1;
+        recordNext = seq + 1;
+        stats.telemetryRecords++;
+        if((record[6] >> 4) == 0) {
+            stats.moisture = (unsigned short)(record[2] | (record[3] << 8));
+            stats.temp = (short)(record[4] | (record[5] << 8));
+            stats.level = record[7];
+        }
+    }
+}
+
+static void reply(const Frame *frame) { // ACK, and a request behind it when one is due
+    uint8_t out[2 * FRAME_COBS_MAX];
+    size_t len;
+    uint8_t seq = frame->seq;
+
+    stats.acks++;
+    if(gatewayConfig.dropAckEvery && stats.acks % gatewayConfig.dropAckEvery == 0) {
+        return;
+    }
+    len = frameEncode(PROTO_ACK, gatewaySeq++, 0, 0, &seq, 1, out);
+    if(gatewayConfig.replayAt && !replaySent && simNow() >= gatewayConfig.replayAt) {
+        len += frameEncode(PROTO_REPLAY, gatewaySeq++, 0, 0, 0, 0, &out[len]);
+        replaySent = 1;
+        stats.requests++;
+    } else if(gatewayConfig.profileAt && !profileSent && simNow() >= gatewayConfig.profileAt) {
+        len += frameEncode(PROTO_PROFILE, gatewaySeq++, 0, 0, 0, 0, &out[len]);
+        profileSent = 1;
+        stats.requests++;
+    }
+    simUartRx(out, len, gatewayConfig.ackDelay);
+}
+
+void gatewayByte(unsigned char byte) { // SimByteFn
+    Frame frame;
+    unsigned char ending = (byte == 0 && reader.len != 0);
+
+    if(!frameReaderPush(&reader, byte, 1, &frame)) {
+        if(ending) {
+            stats.badFrames++;
+        }
+        return;
+    }
+
+    stats.frames++;
+    stats.node = frame.node;
+    if(gatewayConfig.frameFn) {
+        gatewayConfig.frameFn(&frame);
+    }
+    if(seenBefore(&frame)) {
+        stats.resent++;
+    } else if(frame.type == PROTO_TELEMETRY) {
+        telemetry(&frame);
+    } else if(frame.type == PROTO_LOG) {
+        stats.logFrames++;
+        stats.logBytes += frame.len;
+    } else if(frame.type == PROTO_STATS) {
+        stats.statsFrames++;
+    }
+    reply(&frame);
+}
@@ -0,0 +1,46 @@
+/*
+ gateway.h
+ The ESP-01 and the server behind it, as the simulated node sees them over the UART. Frames the node sends are
+ decoded with frame.h and checked, telemetry records are counted and their sequence numbers followed, and
+ every data frame is acknowledged a little later, unless the configuration drops some ACKs to make the node
+ resend. PROTO_REPLAY and PROTO_PROFILE requests are sent right behind an ACK, while the node is listening
+ (protocol.h).
+ */
+
+#ifndef GATEWAY_H_
+#define GATEWAY_H_
+
+#include "frame.h"
+#include "sim.h"
+
+typedef struct {
+    SimTime ackDelay; // end of a data frame to the start of its ACK
+    unsigned long dropAckEvery; // 0 acknowledges every frame, n leaves every nth one unacknowledged
+    SimTime replayAt; // asks for the FRAM log behind the first ACK after this, 0 never
+    SimTime profileAt; // same for the profiling table
+    void (*frameFn)(const Frame *frame); // called with every good frame before it is acknowledged, may be 0
+} GatewayConfig;
+
+typedef struct {
+    unsigned short node; // ID in the last good frame
+    unsigned long frames; // good frames
+    unsigned long badFrames; // failed COBS or CRC
+    unsigned long resent; // frames seen before, their ACK was dropped or late
+    unsigned long telemetryFrames;
+    unsigned long telemetryRecords;
+    unsigned long recordsSkipped; // gaps in the record sequence numbers
+    unsigned long logFrames;
+    unsigned long logBytes;
+    unsigned long statsFrames;
+    unsigned long acks;
+    unsigned long requests;
+    unsigned short moisture; // last record of zone 0
+    short temp;
+    unsigned char level;
+} GatewayStats;
+
+void gatewayInit(const GatewayConfig *config);
+void gatewayByte(unsigned char byte);
+const GatewayStats *gatewayStats(void);
+
+#endif /* GATEWAY_H_ */
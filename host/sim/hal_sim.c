@@ -0,0 +1,928 @@
+/*
+ hal_sim.c
+ Host backend of hal.h: the FR2355 peripherals the firmware uses, driven by simulated time (sim.h). Each
+ peripheral keeps its registers as plain state and the time of its next event; simStep() runs the earliest
+ event and then every interrupt handler whose flag and enable are both set, the way the CPU would.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "clock.h"
+#include "hal.h"
+#include "sim.h"
+
+#define SIM_NEVER UINT64_MAX
+#define SIM_VLO_HZ 10000ULL // typical VLO, the watchdog source
+#define SIM_UART_BYTE_NS (10 * SIM_S / 115200) // start bit, 8 data bits, stop bit
+#define SIM_WAKE_NS (200 * SIM_US) // estimated CPU time of one pass of main()'s loop, a few thousand cycles
+#define SIM_ISR_NS (10 * SIM_US) // and of an interrupt handler
+#define SIM_STORM 100000 // interrupt handlers in a row without time moving before the run is stopped
+
+enum { EV_NONE, EV_TICK, EV_ALARM, EV_ADC, EV_UART_TX, EV_UART_RX, EV_PWM, EV_SPI, EV_WDT, EV_TIMER };
+
+static SimTime simTime;
+static SimStats stats;
+static unsigned char simGie; // GIE bit
+static unsigned char simWoken; // a handler cleared the LPM bits on exit
+static unsigned char simDeep; // sleeping in LPM3, SMCLK stopped
+static unsigned char simInIsr;
+static struct timespec hostMark; // start of the firmware code being timed
+static unsigned char hostTiming;
+
+static SimAdcFn adcFn;
+static SimByteFn uartTxFn;
+static SimSpiFn spiFn;
+static SimTime stopAt;
+static SimFn stopFn;
+static SimFn resetFn;
+static unsigned char stalls; // SIM_STALL_ bits
+
+static struct {
+    SimTime due; // SIM_NEVER while the slot is free
+    SimTime period; // 0 for a one-shot
+    SimFn fn;
+} timers[SIM_TIMERS];
+
+// GPIO
+static unsigned char ledRed, ledGreen;
+static unsigned char csLow; // P1 chip selects pulled low
+static unsigned char csSelected; // pulled low since the last SPI byte, a new transaction on them
+static unsigned char buttonDown[2], buttonIfg[2], buttonIe;
+
+// reset, watchdog, TLV
+static unsigned short resetCause;
+static SimTime wdtDue, wdtPeriod;
+static unsigned short tlv[0x40]; // words from 0x1A00
+
+// Timer_B0 on ACLK, counts since halTickStart()
+static unsigned char tickOn;
+static SimTime tickStart;
+static uint64_t tickLen; // TB0CCR0 + 1
+static uint64_t tickNext; // count of the next CCR0 match
+static unsigned char tickIfg;
+static unsigned char alarmIe, alarmIfg;
+static uint64_t alarmNext;
+
+// ADC
+static unsigned short adcMctl, adcMem, adcConvMctl;
+static unsigned char adcIe, adcIfg;
+static SimTime adcDue;
+
+// PWM, Timer_B3 and Timer_B2 as one
+static unsigned short pwmMode[8], pwmCcr[8];
+static unsigned short pwmPeriod, pwmDiv;
+static unsigned char pwmSet[8]; // output set at the start of the current period
+static unsigned char pwmRunning, pwmIe, pwmIfg;
+static SimTime pwmPeriodStart, pwmNext;
+static unsigned short pwmLastPulse[8];
+static SimTime pwmLastPulseAt[8];
+
+// UART, eUSCI_A1
+static unsigned char uartReady, uartRxIe, uartTxIe, uartCptIe, uartRxIfg, uartTxIfg, uartCptIfg;
+static unsigned char uartRxBuf, uartTxBuf, uartTxBufFull, uartShift, uartShiftByte;
+static SimTime uartShiftEnd;
+static struct {
+    SimTime at;
+    unsigned char byte;
+} uartRxQueue[SIM_UART_RX_QUEUE];
+static size_t uartRxHead, uartRxCount;
+static SimTime uartRxLast; // arrival of the last queued byte
+
+// SPI, eUSCI_B0
+static unsigned char spiOn, spiRxIe, spiRxIfg, spiRxBuf, spiTxByte;
+static unsigned short spiBrw;
+static SimTime spiDue;
+
+static void hostStart(void) {
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &hostMark);
+    hostTiming = 1;
+}
+
+static void hostStop(void) {
+    struct timespec now;
+
+    if(!hostTiming) {
+        return;
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    stats.hostNs += (uint64_t)(now.tv_sec - hostMark.tv_sec) * SIM_S + now.tv_nsec - hostMark.tv_nsec;
+    hostTiming = 0;
+}
+
+static SimTime countTime(SimTime start, uint64_t count, uint64_t hz) { // time of the count'th edge of an hz clock
+    return start + count / hz * SIM_S + ((count % hz) * SIM_S + hz - 1) / hz;
+}
+
+static uint64_t aclkCount(void) { // ACLK edges since halTickStart()
+    SimTime elapsed = simTime - tickStart;
+
+    return elapsed / SIM_S * CLOCK_REFO_HZ + (elapsed % SIM_S) * CLOCK_REFO_HZ / SIM_S;
+}
+
+static SimTime pwmCountsNs(uint64_t counts) {
+    return counts * pwmDiv * SIM_S / CLOCK_SMCLK_HZ;
+}
+
+static unsigned char pwmHigh(void) { // any output high right now
+    unsigned char channel;
+
+    for(channel = 0; channel < 8; channel++) {
+        if(pwmSet[channel] && simTime - pwmPeriodStart < pwmCountsNs(pwmCcr[channel])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void resetPeripherals(void) { // power-up state, what a PUC puts back; FRAM and the outside world stay
+    unsigned char idx;
+
+    simGie = simWoken = simDeep = simInIsr = 0;
+    ledRed = ledGreen = csLow = csSelected = 0;
+    buttonIfg[0] = buttonIfg[1] = buttonIe = 0;
+    wdtDue = SIM_NEVER; // halted until the firmware sets it up, the watchdog's power-up state is not modelled
+
+    tickOn = tickIfg = alarmIe = alarmIfg = 0;
+    adcMctl = adcMem = 0;
+    adcIe = adcIfg = 0;
+    adcDue = SIM_NEVER;
+    for(idx = 0; idx < 8; idx++) {
+        pwmMode[idx] = OUTMOD_0;
+        pwmCcr[idx] = 0;
+        pwmSet[idx] = 0;
+    }
+    pwmPeriod = 0;
+    pwmDiv = 1;
+    pwmRunning = pwmIe = pwmIfg = 0;
+    uartReady = uartRxIe = uartTxIe = uartCptIe = uartRxIfg = uartCptIfg = 0;
+    uartTxIfg = 1; // UCTXIFG is set after reset
+    uartTxBufFull = uartShift = 0;
+    spiOn = spiRxIe = spiRxIfg = 0;
+    spiBrw = 1;
+    spiDue = SIM_NEVER;
+}
+
+void simInit(void) {
+    unsigned char idx;
+
+    simTime = 0;
+    stats = (SimStats){0};
+    adcFn = 0;
+    uartTxFn = 0;
+    spiFn = 0;
+    stopAt = SIM_NEVER;
+    stopFn = 0;
+    resetFn = 0;
+    stalls = 0;
+    for(idx = 0; idx < SIM_TIMERS; idx++) {
+        timers[idx].due = SIM_NEVER;
+    }
+
+    buttonDown[0] = buttonDown[1] = 0;
+    resetCause = SYSRSTIV_BOR;
+    for(idx = 0; idx < sizeof tlv / sizeof tlv[0]; idx++) {
+        tlv[idx] = 0xFFFF; // erased
+    }
+    simSetTlv(HAL_TLV_DIE_RECORD, 0x3512); // lot and wafer of a made-up chip
+    simSetTlv(HAL_TLV_DIE_RECORD + 2, 0x0A41);
+    simSetTlv(HAL_TLV_DIE_RECORD + 4, 0x0017); // die X
+    simSetTlv(HAL_TLV_DIE_RECORD + 6, 0x002C); // die Y
+    simSetTlv(HAL_TLV_ADC_30C, 1950); // typical 1.5 V reference readings, 385 counts between 30C and 85C
+    simSetTlv(HAL_TLV_ADC_85C, 2335);
+
+    resetPeripherals();
+    for(idx = 0; idx < 8; idx++) {
+        pwmLastPulse[idx] = 0;
+        pwmLastPulseAt[idx] = 0;
+    }
+    uartRxHead = uartRxCount = 0;
+    uartRxLast = 0;
+
+    hostStart();
+}
+
+SimTime simNow(void) {
+    return simTime;
+}
+
+const SimStats *simStats(void) {
+    return &stats;
+}
+
+void simSetAdc(SimAdcFn fn) {
+    adcFn = fn;
+}
+
+void simSetUartTx(SimByteFn fn) {
+    uartTxFn = fn;
+}
+
+void simSetSpi(SimSpiFn fn) {
+    spiFn = fn;
+}
+
+void simSetTlv(unsigned short addr, unsigned short value) {
+    tlv[((addr - 0x1A00) >> 1) & 0x3F] = value;
+}
+
+void simSetResetCause(unsigned short cause) {
+    resetCause = cause;
+}
+
+void simSetStop(SimTime at, SimFn stop) { // stop is called from halSleep() once time reaches at, and must not return
+    stopAt = at;
+    stopFn = stop;
+}
+
+void simSetReset(SimFn reset) { // reset is called when the watchdog runs out, and must not return
+    resetFn = reset;
+}
+
+void simStall(unsigned char what) { // SIM_STALL_ bits, 0 lets everything run again
+    stalls = what;
+}
+
+int simTimer(SimTime first, SimTime period, SimFn fn) { // fn at first, then every period if period is not 0
+    int idx;
+
+    for(idx = 0; idx < SIM_TIMERS; idx++) {
+        if(timers[idx].due == SIM_NEVER) {
+            timers[idx].due = first;
+            timers[idx].period = period;
+            timers[idx].fn = fn;
+            return idx;
+        }
+    }
+    return -1;
+}
+
+void simTimerCancel(int timer) {
+    if(timer >= 0 && timer < SIM_TIMERS) {
+        timers[timer].due = SIM_NEVER;
+    }
+}
+
+void simUartRx(const unsigned char *data, size_t len, SimTime delay) { // bytes back to back, the first one delay from now
+    SimTime at = simTime + delay;
+    size_t idx;
+
+    if(at < uartRxLast + SIM_UART_BYTE_NS) {
+        at = uartRxLast + SIM_UART_BYTE_NS; // behind what is already on the line
+    }
+    for(idx = 0; idx < len && uartRxCount < SIM_UART_RX_QUEUE; idx++) {
+        uartRxQueue[(uartRxHead + uartRxCount) % SIM_UART_RX_QUEUE].at = at;
+        uartRxQueue[(uartRxHead + uartRxCount) % SIM_UART_RX_QUEUE].byte = data[idx];
+        uartRxCount++;
+        uartRxLast = at;
+        at += SIM_UART_BYTE_NS;
+    }
+}
+
+void simButton(unsigned char button, unsigned char down) {
+    if(down && !buttonDown[button]) {
+        buttonIfg[button] = 1; // High -> Low edge
+    }
+    buttonDown[button] = down;
+}
+
+unsigned char simLedRed(void) {
+    return ledRed;
+}
+
+unsigned char simLedGreen(void) {
+    return ledGreen;
+}
+
+unsigned short simPwmPulseUs(unsigned char channel) { // width of the channel's last pulse, 0 if it is not pulsing
+    if(pwmLastPulse[channel] == 0 || simTime - pwmLastPulseAt[channel] > 2 * pwmCountsNs(pwmPeriod + 1UL)) {
+        return 0;
+    }
+    return (unsigned short)(pwmCountsNs(pwmLastPulse[channel]) / SIM_US);
+}
+
+unsigned char simPwmRunning(void) {
+    return pwmRunning;
+}
+
+// event loop
+
+static unsigned char uartIrqPending(void) {
+    return (uartRxIfg && uartRxIe) || (uartTxIfg && uartTxIe) || (uartCptIfg && uartCptIe);
+}
+
+static void dispatch(void (*isr)(void)) {
+    simGie = 0; // the CPU clears GIE on entry and restores it with the status register on exit
+    simInIsr = 1;
+    hostStart();
+    isr();
+    hostStop();
+    simInIsr = 0;
+    simGie = 1;
+    stats.irqs++;
+    stats.activeNs += SIM_ISR_NS;
+}
+
+static void serviceIrqs(void) { // highest priority vector first, until nothing is pending
+    unsigned long count = 0;
+
+    while(simGie) {
+        if(tickIfg) {
+            tickIfg = 0; // CCR0 flags are cleared when their interrupt is taken
+            dispatch(tickIsr);
+        } else if(alarmIfg && alarmIe) {
+            dispatch(buttonPollIsr);
+        } else if(pwmIfg && pwmIe) {
+            pwmIfg = 0;
+            dispatch(servoIsr);
+        } else if(uartIrqPending()) {
+            dispatch(uartIsr);
+        } else if(spiRxIfg && spiRxIe) {
+            dispatch(spiIsr);
+        } else if(adcIfg && adcIe) {
+            dispatch(adcIsr);
+        } else if(buttonIfg[SIM_BUTTON_REFILL] && buttonIe) {
+            dispatch(refillButtonIsr);
+        } else if(buttonIfg[SIM_BUTTON_THRES] && buttonIe) {
+            dispatch(thresButtonIsr);
+        } else {
+            break;
+        }
+        if(++count > SIM_STORM) {
+            fprintf(stderr, "sim: interrupt storm at %llu ns, a handler does not clear its flag\n",
+                    (unsigned long long)simTime);
+            abort();
+        }
+    }
+}
+
+static SimTime nextEvent(int *kind, int *timer) {
+    SimTime best = SIM_NEVER;
+    SimTime due;
+    int idx;
+
+    *kind = EV_NONE;
+#define SIM_CONSIDER(time, ev) do { due = (time); if(due < best) { best = due; *kind = (ev); } } while(0)
+    if(tickOn && !(stalls & SIM_STALL_TICK)) {
+        SIM_CONSIDER(countTime(tickStart, tickNext, CLOCK_REFO_HZ), EV_TICK);
+        if(alarmIe) {
+            SIM_CONSIDER(countTime(tickStart, alarmNext, CLOCK_REFO_HZ), EV_ALARM);
+        }
+    }
+    if(!(stalls & SIM_STALL_ADC)) {
+        SIM_CONSIDER(adcDue, EV_ADC); // MODOSC, runs in LPM3
+    }
+    if(uartRxCount) {
+        SIM_CONSIDER(uartRxQueue[uartRxHead].at, EV_UART_RX); // the gateway does not care how the node sleeps
+    }
+    SIM_CONSIDER(wdtDue, EV_WDT);
+    if(!simDeep) { // SMCLK
+        if(uartShift) {
+            SIM_CONSIDER(uartShiftEnd, EV_UART_TX);
+        }
+        if(pwmRunning) {
+            SIM_CONSIDER(pwmNext, EV_PWM);
+        }
+        SIM_CONSIDER(spiDue, EV_SPI);
+    }
+    for(idx = 0; idx < SIM_TIMERS; idx++) {
+        if(timers[idx].due < best) {
+            best = timers[idx].due;
+            *kind = EV_TIMER;
+            *timer = idx;
+        }
+    }
+#undef SIM_CONSIDER
+    return best;
+}
+
+static void runEvent(int kind, int timer) {
+    unsigned char channel;
+    SimFn fn;
+
+    switch(kind) {
+        case EV_TICK:
+            tickIfg = 1;
+            tickNext += tickLen;
+            break;
+        case EV_ALARM:
+            alarmIfg = 1;
+            alarmNext += tickLen; // CCR1 matches again a period later unless it is moved
+            break;
+        case EV_ADC:
+            adcMem = adcFn ? adcFn(adcConvMctl) & 0x0FFF : 0;
+            adcIfg = 1;
+            adcDue = SIM_NEVER;
+            stats.adcConversions++;
+            break;
+        case EV_UART_TX:
+            stats.uartTxBytes++;
+            if(uartTxFn) {
+                uartTxFn(uartShiftByte);
+            }
+            if(uartTxBufFull) { // next byte straight into the shift register
+                uartShiftByte = uartTxBuf;
+                uartTxBufFull = 0;
+                uartTxIfg = 1;
+                uartShiftEnd += SIM_UART_BYTE_NS;
+            } else {
+                uartShift = 0;
+                uartCptIfg = 1;
+            }
+            break;
+        case EV_UART_RX:
+            if(simDeep || !uartReady) {
+                stats.uartRxLost++; // no clock to sample the line with
+            } else {
+                if(uartRxIfg) {
+                    stats.uartRxOverrun++;
+                }
+                uartRxBuf = uartRxQueue[uartRxHead].byte;
+                uartRxIfg = 1;
+                stats.uartRxBytes++;
+            }
+            uartRxHead = (uartRxHead + 1) % SIM_UART_RX_QUEUE;
+            uartRxCount--;
+            break;
+        case EV_PWM: // CCR0 match: last pulse done, outputs in reset/set mode go high for the next
+            for(channel = 0; channel < 8; channel++) {
+                if(pwmSet[channel] && pwmCcr[channel] != 0) {
+                    pwmLastPulse[channel] = pwmCcr[channel] < pwmPeriod ? pwmCcr[channel] : pwmPeriod;
+                    pwmLastPulseAt[channel] = simTime;
+                }
+                pwmSet[channel] = pwmMode[channel] == OUTMOD_7;
+            }
+            pwmIfg = 1;
+            pwmPeriodStart = simTime;
+            pwmNext = simTime + pwmCountsNs(pwmPeriod + 1UL);
+            stats.pwmPeriods++;
+            break;
+        case EV_SPI:
+            spiRxBuf = spiFn ? spiFn(csLow, csSelected, spiTxByte) : 0xFF;
+            csSelected = 0;
+            spiRxIfg = 1;
+            spiDue = SIM_NEVER;
+            stats.spiBytes++;
+            break;
+        case EV_WDT:
+            stats.watchdogResets++;
+            if(resetFn) { // a PUC: the peripherals start over and the firmware runs from the top
+                resetPeripherals();
+                resetCause = SYSRSTIV_WDTTO;
+                hostStart();
+                resetFn(); // does not return
+            }
+            wdtDue = simTime + wdtPeriod;
+            break;
+        case EV_TIMER:
+            fn = timers[timer].fn;
+            if(timers[timer].period) {
+                timers[timer].due += timers[timer].period;
+            } else {
+                timers[timer].due = SIM_NEVER;
+            }
+            fn();
+            break;
+        default:
+            break;
+    }
+}
+
+static void simStep(SimTime until) { // runs the next event and the handlers it sets off, or moves time to until
+    int kind, timer = 0;
+    SimTime due = nextEvent(&kind, &timer);
+
+    if(stopFn && stopAt <= due && stopAt <= until) {
+        if(stopAt > simTime) {
+            simTime = stopAt;
+        }
+        stopFn(); // does not return
+        stopFn = 0;
+        return;
+    }
+    if(due > until) {
+        simTime = until;
+        return;
+    }
+    if(kind == EV_NONE) {
+        fprintf(stderr, "sim: CPU asleep at %llu ns with nothing left to wake it\n", (unsigned long long)simTime);
+        abort();
+    }
+    if(due > simTime) {
+        simTime = due;
+    }
+    runEvent(kind, timer);
+    serviceIrqs();
+}
+
+static void sleepEnter(unsigned char deep) {
+    if(deep) {
+        if(pwmRunning) {
+            stats.pwmFrozen++;
+            if(pwmHigh()) {
+                stats.pwmHeldHigh++;
+            }
+        }
+        if(uartShift) {
+            stats.uartTxFrozen++;
+        }
+    }
+    simDeep = deep;
+    simGie = 1;
+}
+
+static void sleepLeave(SimTime start) {
+    SimTime slept = simTime - start;
+
+    if(simDeep) { // SMCLK peripherals carry on from where they stopped
+        stats.lpm3Ns += slept;
+        if(uartShift) {
+            uartShiftEnd += slept;
+        }
+        if(pwmRunning) {
+            pwmNext += slept;
+            pwmPeriodStart += slept;
+        }
+        if(spiDue != SIM_NEVER) {
+            spiDue += slept;
+        }
+    } else {
+        stats.lpm0Ns += slept;
+    }
+    simDeep = 0;
+    simGie = 0;
+}
+
+void simRun(SimTime until, unsigned char deep) { // for tests: let the peripherals and handlers run until then
+    SimTime start = simTime;
+
+    hostStop();
+    sleepEnter(deep);
+    serviceIrqs();
+    while(simTime < until) {
+        simStep(until);
+    }
+    sleepLeave(start);
+}
+
+// hal.h
+
+void halWakeOnExit() {
+    simWoken = 1;
+}
+
+unsigned short halIrqSave() {
+    unsigned short state = simGie;
+
+    simGie = 0;
+    return state;
+}
+
+void halIrqRestore(unsigned short state) {
+    simGie = (unsigned char)state;
+    if(simGie && !simInIsr) {
+        serviceIrqs();
+    }
+}
+
+void halIrqOff() {
+    simGie = 0;
+}
+
+void halIrqOn() {
+    simGie = 1;
+    if(!simInIsr) {
+        serviceIrqs();
+    }
+}
+
+void halSleep(unsigned char deep) {
+    SimTime start = simTime;
+
+    hostStop();
+    sleepEnter(deep);
+    simWoken = 0;
+    serviceIrqs();
+    while(!simWoken) {
+        simStep(SIM_NEVER);
+    }
+    sleepLeave(start);
+    stats.wakeups++;
+    stats.activeNs += SIM_WAKE_NS;
+    hostStart();
+}
+
+void halClockInit(unsigned short dcorsel, unsigned short flln, unsigned short nwaits, unsigned short tries) {
+    (void)dcorsel; // the simulation runs at CLOCK_SMCLK_HZ whatever the settings
+    (void)flln;
+    (void)nwaits;
+    (void)tries;
+}
+
+void halClockDivide(unsigned short divm, unsigned short divs) {
+    (void)divm;
+    (void)divs;
+}
+
+unsigned short halResetCause() {
+    unsigned short cause = resetCause;
+
+    resetCause = SYSRSTIV_NONE;
+    return cause;
+}
+
+void halWatchdogSet(unsigned short ctl) {
+    static const uint64_t intervals[8] = {1ULL << 31, 1ULL << 27, 1ULL << 23, 1ULL << 19,
+                                             1ULL << 15, 1ULL << 13, 1ULL << 9, 1ULL << 6};
+    uint64_t hz;
+
+    if(ctl & WDTHOLD) {
+        wdtDue = SIM_NEVER;
+        return;
+    }
+    switch(ctl & WDTSSEL__VLO) {
+        case WDTSSEL__ACLK: hz = CLOCK_REFO_HZ; break;
+        case WDTSSEL__VLO: hz = SIM_VLO_HZ; break;
+        default: hz = CLOCK_SMCLK_HZ; break;
+    }
+    wdtPeriod = intervals[ctl & WDTIS] * SIM_S / hz;
+    wdtDue = simTime + wdtPeriod;
+}
+
+unsigned short halTlvWord(unsigned short addr) {
+    return tlv[((addr - 0x1A00) >> 1) & 0x3F];
+}
+
+unsigned short halCrc16(const unsigned char *data, unsigned char len) { // what the CRC16 module computes
+    unsigned short crc = 0xFFFF;
+    unsigned char idx, bit;
+
+    for(idx = 0; idx < len; idx++) {
+        crc ^= (unsigned short)data[idx] << 8;
+        for(bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (unsigned short)((crc << 1) ^ 0x1021) : (unsigned short)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+void halGpioInit() {
+    ledRed = 0;
+    ledGreen = 1;
+    csLow = csSelected = 0;
+}
+
+void halLedRed(unsigned char on) {
+    ledRed = on != 0;
+}
+
+void halLedGreen(unsigned char on) {
+    ledGreen = on != 0;
+}
+
+unsigned char halLedGreenIsOn() {
+    return ledGreen;
+}
+
+unsigned char halThresButtonDown() {
+    return buttonDown[SIM_BUTTON_THRES];
+}
+
+unsigned char halRefillButtonDown() {
+    return buttonDown[SIM_BUTTON_REFILL];
+}
+
+void halButtonIrq(unsigned char on) {
+    if(on) {
+        buttonIfg[0] = buttonIfg[1] = 0;
+    }
+    buttonIe = on;
+}
+
+void halThresButtonAck() {
+    buttonIfg[SIM_BUTTON_THRES] = 0;
+}
+
+void halRefillButtonAck() {
+    buttonIfg[SIM_BUTTON_REFILL] = 0;
+}
+
+void halSpiSelect(unsigned char pin) {
+    csLow |= pin;
+    csSelected |= pin;
+}
+
+void halSpiDeselect(unsigned char pin) {
+    csLow &= ~pin;
+}
+
+void halAdcPin(unsigned char input) {
+    (void)input;
+}
+
+void halAdcInit(unsigned short mctl) {
+    adcMctl = mctl;
+    adcIe = 1;
+}
+
+void halAdcSelect(unsigned short mctl) {
+    adcMctl = mctl;
+}
+
+void halAdcStart() {
+    adcConvMctl = adcMctl;
+    adcDue = simTime + SIM_ADC_NS;
+}
+
+unsigned short halAdcResult() {
+    adcIfg = 0;
+    return adcMem;
+}
+
+unsigned short halAdcIv() {
+    if(adcIfg && adcIe) {
+        adcIfg = 0;
+        return ADCIV_ADCIFG;
+    }
+    return ADCIV_NONE;
+}
+
+void halTickStart(unsigned short period) {
+    tickOn = 1;
+    tickStart = simTime;
+    tickLen = period + 1UL;
+    tickNext = period; // CCR0 matches when TB0R reaches it
+    tickIfg = 0;
+}
+
+void halTickAlarm(unsigned short at) {
+    uint64_t now = aclkCount();
+
+    alarmNext = now - now % tickLen + at;
+    if(alarmNext <= now) {
+        alarmNext += tickLen;
+    }
+    alarmIe = 1;
+    alarmIfg = 0; // writing TB0CCTL1 clears CCIFG
+}
+
+void halTickAlarmOff() {
+    alarmIe = 0;
+    alarmIfg = 0;
+}
+
+unsigned short halTickCount() {
+    return (unsigned short)(aclkCount() % tickLen);
+}
+
+unsigned short halTickIv() {
+    if(alarmIfg && alarmIe) {
+        alarmIfg = 0;
+        return TB0IV_TBCCR1;
+    }
+    return TB0IV_NONE;
+}
+
+void halProfStart() {
+}
+
+unsigned short halProfCount() { // host clock scaled to PROF_HZ
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned short)((uint64_t)now.tv_sec * CLOCK_SMCLK_HZ + (uint64_t)now.tv_nsec * CLOCK_SMCLK_HZ / SIM_S);
+}
+
+void halPwmOutputs(unsigned char channels, unsigned short mode) {
+    unsigned char channel;
+
+    for(channel = 0; channel < 8; channel++) {
+        if(channels & (1 << channel)) {
+            if(mode == OUTMOD_0) {
+                pwmSet[channel] = 0; // output follows the OUT bit, which is clear
+            }
+            pwmMode[channel] = mode;
+        }
+    }
+}
+
+void halPwmInit(unsigned char channels, unsigned short period, unsigned short id) {
+    (void)channels;
+    halPwmOutputs(0xFF, OUTMOD_0);
+    pwmPeriod = period;
+    pwmDiv = 1 << ((id >> 6) & 3);
+    pwmIe = 0;
+    pwmRunning = 0;
+}
+
+void halPwmRun(unsigned char on) {
+    if(on) { // TBCLR, the first CCR0 match is a whole period away
+        pwmRunning = 1;
+        pwmPeriodStart = simTime;
+        pwmNext = simTime + pwmCountsNs(pwmPeriod + 1UL);
+    } else {
+        if(pwmRunning && pwmHigh()) {
+            stats.pwmHeldHigh++; // the output stays at its level while the timer is halted
+        }
+        pwmRunning = 0;
+    }
+}
+
+void halPwmSet(unsigned char channel, unsigned short width) {
+    pwmCcr[channel & 7] = width;
+}
+
+void halPwmPeriodIrq(unsigned char on) {
+    pwmIe = on; // CCIFG is set every period whatever CCIE is, so one left from before fires right away
+}
+
+void halUartInit(unsigned short brw, unsigned short mctlw) {
+    (void)brw; // the line runs at 115200 baud, the dividers are checked by the host tests
+    (void)mctlw;
+    uartReady = 1;
+    uartRxIe = 1;
+}
+
+void halUartPut(unsigned char byte) {
+    uartTxIfg = 0;
+    if(!uartShift) { // empty transmitter, the byte goes straight into the shift register
+        uartShift = 1;
+        uartShiftByte = byte;
+        uartShiftEnd = simTime + SIM_UART_BYTE_NS;
+        uartTxIfg = 1;
+    } else {
+        uartTxBuf = byte; // overwrites a byte still waiting, as the eUSCI would
+        uartTxBufFull = 1;
+    }
+}
+
+unsigned char halUartGet() {
+    uartRxIfg = 0;
+    return uartRxBuf;
+}
+
+void halUartTxIrq(unsigned char on) {
+    uartTxIe = on;
+}
+
+void halUartTxDoneIrq(unsigned char on) {
+    if(on) {
+        uartCptIfg = 0;
+    }
+    uartCptIe = on;
+}
+
+unsigned short halUartIv() { // reading UCA1IV clears the flag it returns
+    if(uartRxIfg && uartRxIe) {
+        uartRxIfg = 0;
+        return USCI_UART_UCRXIFG;
+    }
+    if(uartTxIfg && uartTxIe) {
+        uartTxIfg = 0;
+        return USCI_UART_UCTXIFG;
+    }
+    if(uartCptIfg && uartCptIe) {
+        uartCptIfg = 0;
+        return USCI_UART_UCTXCPTIFG;
+    }
+    return USCI_NONE;
+}
+
+void halSpiInit(unsigned short brw) {
+    spiBrw = brw ? brw : 1;
+}
+
+void halSpiEnable(unsigned char on) {
+    spiOn = on;
+    if(!on) {
+        spiDue = SIM_NEVER;
+        spiRxIfg = 0;
+    }
+}
+
+void halSpiPut(unsigned char byte) {
+    if(spiOn) {
+        spiTxByte = byte;
+        spiDue = simTime + 8ULL * spiBrw * SIM_S / CLOCK_SMCLK_HZ;
+    }
+}
+
+unsigned char halSpiGet() {
+    spiRxIfg = 0;
+    return spiRxBuf;
+}
+
+void halSpiRxIrq(unsigned char on) {
+    spiRxIe = on;
+}
+
+unsigned short halSpiIv() {
+    if(spiRxIfg && spiRxIe) {
+        spiRxIfg = 0;
+        return USCI_SPI_UCRXIFG;
+    }
+    return USCI_NONE;
+}
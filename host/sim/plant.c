@@ -0,0 +1,167 @@
+#include <math.h>
+
+#include "filter.h"
+#include "hal.h"
+#include "plant.h"
+#include "reservoir.h"
+
+#define PLANT_DRY_RATE 14.0 // counts per hour at 20C in the dark
+#define PLANT_DRY_TEMP 0.06 // faster by this fraction per degree above 20C
+#define PLANT_SUN 1.8 // drying at midday, times the rate at night
+#define PLANT_COUNTS_PER_ML 0.4 // moisture change per mL soaked in
+#define PLANT_SOAK_S 240.0 // time constant of the surface water soaking in
+#define PLANT_PROBE_S 150.0 // time constant of the probe following the soil
+#define PLANT_NOISE 6 // probe noise, +/- counts
+#define PLANT_SERVO_US_PER_S 3000.0 // hatch servo speed, pulse width per second
+#define PLANT_CLOSED_US 550.0 // hatch servo travel, SERVO_CLOSED_POS and SERVO_OPEN_POS in servo.h
+#define PLANT_OPEN_US 2600.0
+#define PLANT_FLOW_MIN 0.1 // hatch opening below which nothing pours
+#define PLANT_PI 3.14159265358979
+
+static Plant plant;
+static unsigned long plantRng;
+static SimTime plantLast;
+
+static double plantRandom(void) { // 0 to 1
+    plantRng = plantRng * 1103515245UL + 12345UL;
+    return (double)((plantRng >> 8) & 0xFFFF) / 65535.0;
+}
+
+static double plantAmbient(SimTime now) { // 22C on average, warmest mid-afternoon
+    double day = (double)(now % SIM_DAY) / SIM_DAY;
+
+    return 22.0 + 6.0 * sin(2.0 * PLANT_PI * (day - 0.375));
+}
+
+static double plantSun(SimTime now) { // 0 at night, 1 at noon
+    double day = (double)(now % SIM_DAY) / SIM_DAY;
+    double sun = sin(2.0 * PLANT_PI * (day - 0.25));
+
+    return sun > 0.0 ? sun : 0.0;
+}
+
+void plantInit(unsigned long seed) {
+    unsigned char zone;
+    PlantZone *z;
+
+    plantRng = seed;
+    plantLast = simNow();
+    plant.reservoirMl = RES_CAPACITY_ML;
+    plant.drySoil = 2800.0;
+    plant.wetSoil = 900.0;
+    plant.refills = 0;
+    plant.ambientC = plantAmbient(plantLast);
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        z = &plant.zones[zone];
+        z->soil = 1100.0 + 20.0 * zone; // freshly watered pots
+        z->probe = z->soil;
+        z->surfaceMl = 0.0;
+        z->servoUs = PLANT_CLOSED_US;
+        z->pouredMl = z->drainedMl = 0.0;
+        z->dryHours = z->soakedHours = 0.0;
+        z->openings = 0;
+        z->open = 0;
+    }
+}
+
+void plantStep(void) { // advance the model to now
+    SimTime now = simNow();
+    double dt = (double)(now - plantLast) / SIM_S;
+    double rate, target, step, opening, pour, soak, sun;
+    unsigned char zone;
+    PlantZone *z;
+
+    if(dt <= 0.0) {
+        return;
+    }
+    plantLast = now;
+    plant.ambientC = plantAmbient(now);
+    sun = plantSun(now);
+
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        z = &plant.zones[zone];
+
+        // hatch follows the pulses, an unpowered servo stays where it is
+        target = simPwmPulseUs(zoneConfig[zone].servo);
+        if(target != 0.0) {
+            step = PLANT_SERVO_US_PER_S * dt;
+            if(fabs(target - z->servoUs) <= step) {
+                z->servoUs = target;
+            } else {
+                z->servoUs += (target > z->servoUs) ? step : -step;
+            }
+        }
+        opening = (z->servoUs - PLANT_CLOSED_US) / (PLANT_OPEN_US - PLANT_CLOSED_US);
+        opening = opening < 0.0 ? 0.0 : (opening > 1.0 ? 1.0 : opening);
+        if(opening > 0.5 && !z->open) {
+            z->openings++;
+        }
+        z->open = opening > 0.5;
+
+        // pour from the reservoir onto the surface
+        pour = (opening > PLANT_FLOW_MIN) ? RES_FLOW_ML_PER_MIN / 60.0 * opening * dt : 0.0;
+        if(pour > plant.reservoirMl) {
+            pour = plant.reservoirMl;
+        }
+        plant.reservoirMl -= pour;
+        z->pouredMl += pour;
+        z->surfaceMl += pour;
+
+        // soak in, anything past saturation drains through
+        soak = z->surfaceMl * (1.0 - exp(-dt / PLANT_SOAK_S));
+        z->surfaceMl -= soak;
+        z->soil -= soak * PLANT_COUNTS_PER_ML;
+        if(z->soil < plant.wetSoil) {
+            z->drainedMl += (plant.wetSoil - z->soil) / PLANT_COUNTS_PER_ML;
+            z->soil = plant.wetSoil;
+        }
+
+        // dry, slower as the soil gets closer to bone dry
+        rate = PLANT_DRY_RATE * (1.0 + PLANT_DRY_TEMP * (plant.ambientC - 20.0)) * (1.0 + (PLANT_SUN - 1.0) * sun);
+        rate *= (plant.drySoil - z->soil) / (plant.drySoil - plant.wetSoil);
+        z->soil += rate * dt / 3600.0;
+
+        z->probe += (z->soil - z->probe) * (1.0 - exp(-dt / PLANT_PROBE_S));
+
+        if(z->soil >= zones[zone].thres + moistureFilterConfig.hysteresis) {
+            z->dryHours += dt / 3600.0;
+        }
+        if(z->soil <= plant.wetSoil + 1.0) {
+            z->soakedHours += dt / 3600.0;
+        }
+    }
+}
+
+unsigned short plantAdc(unsigned short mctl) { // SimAdcFn
+    double value;
+    double adc30 = halTlvWord(HAL_TLV_ADC_30C);
+    double adc85 = halTlvWord(HAL_TLV_ADC_85C);
+    unsigned char zone;
+
+    if((mctl & 0x0F) == (ADCINCH_12 & 0x0F)) { // temperature sensor through the TLV calibration
+        value = adc30 + (plant.ambientC - 30.0) * (adc85 - adc30) / 55.0 + (plantRandom() - 0.5) * 4.0;
+        return (unsigned short)(value + 0.5);
+    }
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        if(zoneConfig[zone].adcChannel == mctl) {
+            value = plant.zones[zone].probe + (plantRandom() - 0.5) * 2.0 * PLANT_NOISE;
+            if(plantRandom() < 0.002) {
+                value += 600.0; // an occasional spike, for the median filter
+            }
+            if(value < 0.0) {
+                value = 0.0;
+            }
+            return value > 4095.0 ? 4095 : (unsigned short)(value + 0.5);
+        }
+    }
+    return 0; // unconnected input
+}
+
+void plantRefill(void) {
+    plant.reservoirMl = RES_CAPACITY_ML;
+    plant.refills++;
+}
+
+const Plant *plantState(void) {
+    return &plant;
+}
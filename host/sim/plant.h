@@ -0,0 +1,50 @@
+/*
+ plant.h
+ Pots, soil, hatches and reservoir the simulated firmware waters. Each zone's soil moisture is kept in probe
+ ADC counts, higher is drier like the real probe: it dries faster when it is warm and in daylight, water poured
+ through the hatch first pools on the surface and soaks in over a few minutes, and the probe follows the soil
+ with a lag and some noise, so the dose controller (dose.h) sees the same delayed response it has to learn on
+ the bench. A hatch follows the servo pulse width (sim.h) at a servo's speed and pours in proportion to how
+ far it is open, as long as the reservoir has water.
+
+ The internal temperature sensor reads the ambient temperature through the TLV calibration of hal_sim.c. The
+ model works in doubles, it is the world and not the firmware.
+ */
+
+#ifndef PLANT_H_
+#define PLANT_H_
+
+#include "sim.h"
+#include "zone.h"
+
+#define PLANT_STEP (100 * SIM_MS) // model time step, plantStep() is called this often
+
+typedef struct {
+    double soil; // true moisture, ADC counts
+    double probe; // what the probe reads before noise
+    double surfaceMl; // poured but not soaked in yet
+    double servoUs; // pulse width the hatch servo is at
+    double pouredMl; // through the hatch in total
+    double drainedMl; // ran through the pot, soil was already saturated
+    double dryHours; // soil past the firmware's dry point (threshold plus hysteresis)
+    double soakedHours; // soil saturated
+    unsigned long openings; // hatch went from closed to open
+    unsigned char open;
+} PlantZone;
+
+typedef struct {
+    PlantZone zones[ZONE_COUNT];
+    double reservoirMl;
+    double ambientC;
+    double drySoil; // counts of bone-dry soil, drying slows down towards it
+    double wetSoil; // counts of saturated soil
+    unsigned long refills;
+} Plant;
+
+void plantInit(unsigned long seed);
+void plantStep(void);
+unsigned short plantAdc(unsigned short mctl);
+void plantRefill(void);
+const Plant *plantState(void);
+
+#endif /* PLANT_H_ */
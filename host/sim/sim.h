@@ -0,0 +1,103 @@
+/*
+ sim.h
+ Simulated MSP430FR2355 peripherals behind the host hal.h (hal_host.h). Time is simulated, in nanoseconds, and
+ only moves while the firmware sleeps in halSleep() (or a test calls simRun()): the code between two sleeps
+ takes no simulated time, the way the control loop's bursts are short next to the 1 second tick. Each
+ peripheral schedules its next event (tick and alarm on ACLK, ADC conversion, UART shift register, PWM period,
+ SPI byte, watchdog), and the earliest one is run, interrupt handlers included, until a handler wakes the CPU.
+
+ What runs on SMCLK stops in LPM3 exactly as on the chip: the PWM timers and the UART transmitter freeze where
+ they are, and bytes arriving at the UART receiver are lost. Those are counted in SimStats, together with the
+ wake-ups, the simulated time spent in each mode, an estimate of the time awake and the host CPU time the
+ firmware code took, so a run can show both what the firmware did to the plant and what it cost.
+
+ The outside world is attached with callbacks: the ADC reads whatever simSetAdc() returns for a channel,
+ bytes sent on the UART go to simSetUartTx(), and simTimer() calls a model at fixed intervals of simulated
+ time, which is how the plant (plant.h) and the gateway (gateway.h) keep up with the firmware.
+
+ Faults are injected with simStall(): a stalled ADC never finishes its conversion and a stalled Timer_B0 never
+ matches, which is what the supervisor (supervisor.h) has to catch. With simSetReset() the watchdog running out
+ is a reset: the peripherals go back to their power-up state, halResetCause() reports SYSRSTIV_WDTTO and the
+ callback starts the firmware over. The firmware's variables all keep their contents, those in FRAM as on the
+ chip but also those in RAM, which the callback has to scribble over where it matters.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint64_t SimTime; // nanoseconds since simInit()
+
+#define SIM_US 1000ULL
+#define SIM_MS 1000000ULL
+#define SIM_S 1000000000ULL
+#define SIM_MINUTE (60ULL * SIM_S)
+#define SIM_HOUR (60ULL * SIM_MINUTE)
+#define SIM_DAY (24ULL * SIM_HOUR)
+
+#define SIM_TIMERS 8 // simTimer() slots
+#define SIM_ADC_NS (56 * SIM_US) // one conversion, ADCSHT_8 sampling, 256 MODOSC cycles, plus the 12-bit conversion
+#define SIM_UART_RX_QUEUE 256 // bytes on their way to the node
+
+// simButton()
+#define SIM_BUTTON_THRES 0 // P2.3
+#define SIM_BUTTON_REFILL 1 // P4.1
+
+// simStall()
+#define SIM_STALL_ADC 0x01 // conversions never complete
+#define SIM_STALL_TICK 0x02 // Timer_B0 tick and alarm never match
+
+typedef unsigned short (*SimAdcFn)(unsigned short mctl); // 12-bit result for ADCMCTL0 setting mctl
+typedef void (*SimByteFn)(unsigned char byte); // a byte that left the UART transmitter
+// MISO byte; csLow are the P1 pins held low, selected the ones pulled low since the last byte (a new transaction)
+typedef unsigned char (*SimSpiFn)(unsigned char csLow, unsigned char selected, unsigned char mosi);
+typedef void (*SimFn)(void);
+
+typedef struct {
+    uint64_t wakeups; // halSleep() returns
+    SimTime lpm0Ns; // simulated time asleep with SMCLK running
+    SimTime lpm3Ns; // and with it stopped
+    SimTime activeNs; // estimated CPU time awake, a fixed cost per wake-up and interrupt; code takes no simulated time
+    uint64_t hostNs; // host CPU time of firmware code, main() and interrupt handlers
+    uint64_t irqs; // interrupt handlers run
+    uint64_t uartTxBytes;
+    uint64_t uartRxBytes; // received into UCA1RXBUF
+    uint64_t uartRxLost; // arrived while SMCLK was stopped or the UART was not set up
+    uint64_t uartRxOverrun; // arrived before the last one was read
+    uint64_t uartTxFrozen; // LPM3 entered with a byte still in the transmitter
+    uint64_t pwmPeriods;
+    uint64_t pwmFrozen; // LPM3 entered with the PWM timers running
+    uint64_t pwmHeldHigh; // PWM timers halted or frozen with an output high
+    uint64_t spiBytes;
+    uint64_t adcConversions;
+    uint64_t watchdogResets; // the watchdog ran out; without simSetReset() the simulation carries on
+} SimStats;
+
+void simInit(void);
+SimTime simNow(void);
+const SimStats *simStats(void);
+
+void simSetAdc(SimAdcFn fn);
+void simSetUartTx(SimByteFn fn);
+void simSetSpi(SimSpiFn fn);
+void simSetTlv(unsigned short addr, unsigned short value);
+void simSetResetCause(unsigned short cause);
+void simSetStop(SimTime at, SimFn stop);
+void simSetReset(SimFn reset);
+void simStall(unsigned char what);
+
+int simTimer(SimTime first, SimTime period, SimFn fn);
+void simTimerCancel(int timer);
+
+void simUartRx(const unsigned char *data, size_t len, SimTime delay);
+void simButton(unsigned char button, unsigned char down);
+unsigned char simLedRed(void);
+unsigned char simLedGreen(void);
+unsigned short simPwmPulseUs(unsigned char channel);
+unsigned char simPwmRunning(void);
+
+void simRun(SimTime until, unsigned char deep);
+
+#endif /* SIM_H_ */
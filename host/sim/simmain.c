@@ -0,0 +1,271 @@
+/*
+ simmain.c
+ watersim: the unmodified firmware (main.c, built with main renamed to firmwareMain) run against the simulated
+ peripherals, plant and gateway for a number of simulated days, then a report of what it did to the plants,
+ how much water it used and what the sleep modes and the link cost. Someone looks after the reservoir: when
+ the red LED has been on for a while they refill it and press the refill button.
+
+ The energy per day is estimated from the time in LPM3, LPM0 and awake (SimStats) and the ADC conversions,
+ at the FR2355 datasheet's typical currents at 3 V; the UART, servos and ESP-01 are not counted. The reaction
+ latencies are from the refill button going down to the red LED going off, and from a probe reading past a
+ zone's dry point (threshold plus hysteresis) until its hatch starts to open.
+
+    watersim [-d days] [-s seed] [-r replay hour] [-p profile hour] [-a drop every nth ACK] [-t]
+             [-c host:port [-x speedup]]
+
+ -t prints an hourly trace. The exit status is 1 if the run broke one of the rules the firmware has to keep:
+ no byte from the gateway lost while the node slept in LPM3, no PWM timer or UART transmission frozen by LPM3,
+ no watchdog reset, no corrupted frame and no zone too dry for more than SIM_DRY_SHARE of the run. ctest runs
+ it as a smoke test, also built for ZONE_MAX zones (watersim_zones), and built with the bang-bang hatch logic
+ the dose controller replaced (watersim_bangbang) to hold the controller's water use and time out of band
+ against it (compare.cmake).
+
+ -c connects the node through a simulated ESP-01 (esp01.h) to a fleetd at host:port instead of the simulated
+ gateway, as fast as it runs or with -x at speedup times real time; the seed then also picks the die position
+ in the TLV, so each seed is a node with its own ID.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp01.h"
+#include "filter.h"
+#include "gateway.h"
+#include "hal.h"
+#include "plant.h"
+#include "protocol.h"
+#include "reservoir.h"
+#include "sim.h"
+#include "zone.h"
+
+#define SIM_REFILL_AFTER (2 * SIM_HOUR) // red LED on this long before someone refills
+#define SIM_PRESS (300 * SIM_MS) // refill button held down
+#define SIM_DRY_SHARE 0.25 // of the run a zone may spend too dry, more means it is not being watered
+#define SIM_VCC 3.0
+#define SIM_UA_ACTIVE 3600.0 // 24 MHz from FRAM, about 150 uA/MHz
+#define SIM_UA_LPM0 250.0 // DCO and FLL still running for SMCLK
+#define SIM_UA_LPM3 16.0 // REFO on as ACLK, most of it
+#define SIM_UA_ADC 190.0 // ADC and 1.5 V reference while converting
+
+void firmwareMain(void);
+
+static jmp_buf simEnd;
+static unsigned char refillPending;
+static unsigned char trace;
+static SimTime pressedAt; // refill button down, waiting for the red LED to go off
+static int ledWatch = -1; // timer slot while waiting
+static SimTime dryAt[ZONE_COUNT]; // probe went past the dry point, waiting for the hatch
+static unsigned char probeDry[ZONE_COUNT];
+static unsigned char hatchOpen[ZONE_COUNT];
+
+typedef struct {
+    SimTime sum, max;
+    unsigned long count;
+} Latency;
+
+static Latency buttonLatency, dryLatency;
+
+static void addLatency(Latency *latency, SimTime took) {
+    latency->sum += took;
+    latency->max = took > latency->max ? took : latency->max;
+    latency->count++;
+}
+
+static void stop(void) {
+    longjmp(simEnd, 1);
+}
+
+static void releaseButton(void) {
+    simButton(SIM_BUTTON_REFILL, 0);
+}
+
+static void watchLed(void) { // every millisecond while the refill press is being handled
+    if(!simLedRed()) {
+        addLatency(&buttonLatency, simNow() - pressedAt);
+        simTimerCancel(ledWatch);
+        ledWatch = -1;
+    }
+}
+
+static void refill(void) {
+    plantRefill();
+    simButton(SIM_BUTTON_REFILL, 1);
+    if(ledWatch < 0) {
+        pressedAt = simNow();
+        ledWatch = simTimer(simNow() + SIM_MS, SIM_MS, watchLed);
+    }
+    simTimer(simNow() + SIM_PRESS, 0, releaseButton);
+    refillPending = 0;
+}
+
+static void watchReservoir(void) { // every minute, the person looking after the plants
+    if(simLedRed() && !refillPending) {
+        refillPending = 1;
+        simTimer(simNow() + SIM_REFILL_AFTER, 0, refill);
+    }
+}
+
+static void watchProbes(void) { // every plant step, from a probe crossing the dry point to the hatch opening
+    const Plant *plant = plantState();
+    unsigned char zone, dry, open;
+
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        dry = plant->zones[zone].probe > zones[zone].thres + moistureFilterConfig.hysteresis;
+        open = plant->zones[zone].open;
+        if(dry && !probeDry[zone] && !open) {
+            dryAt[zone] = simNow();
+        } else if(!dry) {
+            dryAt[zone] = 0; // wet again without a dose
+        }
+        if(open && !hatchOpen[zone]) {
+            if(dryAt[zone]) {
+                addLatency(&dryLatency, simNow() - dryAt[zone]);
+            } else if(!dry) {
+                addLatency(&dryLatency, 0); // the noisy reading got there before the probe itself
+            } // else a further dose for a crossing already counted
+            dryAt[zone] = 0;
+        }
+        probeDry[zone] = dry;
+        hatchOpen[zone] = open;
+    }
+}
+
+static void printLatency(const char *what, const Latency *latency, SimTime unit, const char *unitName) {
+    if(latency->count == 0) {
+        printf(" %s none", what);
+        return;
+    }
+    printf(" %s %.1f %s mean, %.1f %s max over %lu", what, (double)latency->sum / latency->count / unit, unitName,
+           (double)latency->max / unit, unitName, latency->count);
+}
+
+static void hourly(void) {
+    const Plant *plant = plantState();
+
+    printf("%6.1f h  soil %6.0f  probe %6.0f  firmware %5u  thres %5u  reservoir %6.0f mL (%3u%%)  %4.1fC\n",
+           (double)simNow() / SIM_HOUR, plant->zones[0].soil, plant->zones[0].probe, zones[0].moisture,
+           zones[0].thres, plant->reservoirMl, resLevel(), plant->ambientC);
+}
+
+int main(int argc, char **argv) {
+    GatewayConfig gateway = {5 * SIM_MS, 0, 0, 0, 0};
+    unsigned long days = 3;
+    unsigned long seed = 1;
+    char *fleetd = 0, *port;
+    double speedup = 0.0;
+    const SimStats *stats;
+    const GatewayStats *link;
+    const Plant *plant;
+    double simDays;
+    double mj;
+    unsigned char zone;
+    unsigned char dryZones = 0;
+    int opt;
+    int failed;
+
+    while((opt = getopt(argc, argv, "d:s:r:p:a:tc:x:")) != -1) {
+        switch(opt) {
+            case 'd': days = strtoul(optarg, 0, 10); break;
+            case 's': seed = strtoul(optarg, 0, 10); break;
+            case 'r': gateway.replayAt = strtoull(optarg, 0, 10) * SIM_HOUR; break;
+            case 'p': gateway.profileAt = strtoull(optarg, 0, 10) * SIM_HOUR; break;
+            case 'a': gateway.dropAckEvery = strtoul(optarg, 0, 10); break;
+            case 't': trace = 1; break;
+            case 'c': fleetd = optarg; break;
+            case 'x': speedup = strtod(optarg, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-d days] [-s seed] [-r replay hour] [-p profile hour] [-a n] [-t] "
+                        "[-c host:port [-x speedup]]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    simInit();
+    plantInit(seed);
+    gatewayInit(&gateway);
+    simSetAdc(plantAdc);
+    if(fleetd) {
+        port = strrchr(fleetd, ':');
+        if(port == 0 || speedup < 0.0) {
+            fprintf(stderr, "watersim: -c needs host:port\n");
+            return 2;
+        }
+        *port++ = '\0';
+        simSetTlv(HAL_TLV_DIE_RECORD + 4, (unsigned short)seed); // die X
+        simSetTlv(HAL_TLV_DIE_RECORD + 6, (unsigned short)(seed >> 16)); // die Y
+        if(!esp01Connect(fleetd, port, speedup)) {
+            fprintf(stderr, "watersim: cannot connect to fleetd at %s:%s\n", fleetd, port);
+            return 1;
+        }
+        simSetUartTx(esp01Byte);
+        simTimer(ESP01_POLL, ESP01_POLL, esp01Poll);
+    } else {
+        simSetUartTx(gatewayByte);
+    }
+    simTimer(PLANT_STEP, PLANT_STEP, plantStep);
+    simTimer(SIM_MINUTE, SIM_MINUTE, watchReservoir);
+    simTimer(PLANT_STEP, PLANT_STEP, watchProbes);
+    if(trace) {
+        simTimer(SIM_HOUR, SIM_HOUR, hourly);
+    }
+    simSetStop(days * SIM_DAY, stop);
+
+    if(setjmp(simEnd) == 0) {
+        firmwareMain(); // returns through stop()
+    }
+
+    stats = simStats();
+    link = gatewayStats();
+    plant = plantState();
+    simDays = (double)simNow() / SIM_DAY;
+
+    printf("simulated %.2f days, %u zone(s), seed %lu\n", simDays, ZONE_COUNT, seed);
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        printf("zone %u: poured %.0f mL, drained %.0f mL, %lu hatch openings, %.1f h too dry, %.1f h saturated, "
+               "soil %.0f, threshold %u\n", zone, plant->zones[zone].pouredMl, plant->zones[zone].drainedMl,
+               plant->zones[zone].openings, plant->zones[zone].dryHours, plant->zones[zone].soakedHours,
+               plant->zones[zone].soil, zones[zone].thres);
+        dryZones += plant->zones[zone].dryHours > SIM_DRY_SHARE * simDays * 24.0;
+    }
+    printf("reservoir: %.0f mL left, %lu refill(s), firmware estimates %u%%\n", plant->reservoirMl,
+           plant->refills, resLevel());
+    printf("cpu: %.2f wake-ups/s, %.1f%% of the time in LPM0, %.1f%% in LPM3, %.3f ms host time per simulated hour,"
+           " %llu interrupts\n", stats->wakeups / (simDays * 86400.0),
+           100.0 * stats->lpm0Ns / (double)simNow(), 100.0 * stats->lpm3Ns / (double)simNow(),
+           stats->hostNs / 1e6 / (simDays * 24.0), (unsigned long long)stats->irqs);
+    mj = SIM_VCC / 1e3 * (SIM_UA_LPM3 * stats->lpm3Ns + SIM_UA_LPM0 * stats->lpm0Ns + SIM_UA_ACTIVE * stats->activeNs +
+                          SIM_UA_ADC * stats->adcConversions * (double)SIM_ADC_NS) / SIM_S / simDays; // uA*V*s
+    printf("energy: %.0f mJ/day estimated, %.1f uA average, %.2f%% of the time awake\n", mj,
+           mj / SIM_VCC / 86.4, 100.0 * stats->activeNs / (double)simNow());
+    printf("latency:");
+    printLatency("refill button to LED off", &buttonLatency, SIM_MS, "ms");
+    printf(",");
+    printLatency("dry probe to hatch opening", &dryLatency, SIM_S, "s");
+    printf("\n");
+    if(fleetd) { // the frames are counted by fleetd
+        printf("link: node %04X through the ESP-01 to %s:%s, %llu bytes out, %llu in, %llu replies late, behind "
+               "real time in %llu of %llu polls\n", protoNodeId(), fleetd, port,
+               (unsigned long long)esp01Stats()->bytesOut, (unsigned long long)esp01Stats()->bytesIn,
+               (unsigned long long)esp01Stats()->late, (unsigned long long)esp01Stats()->behind,
+               (unsigned long long)esp01Stats()->polls);
+    } else {
+        printf("link: node %04X, %lu frames (%lu telemetry, %lu log, %lu stats, %lu resent, %lu bad), %lu records, "
+               "%lu skipped, %llu bytes out, %llu in\n", link->node, link->frames, link->telemetryFrames,
+               link->logFrames, link->statsFrames, link->resent, link->badFrames, link->telemetryRecords,
+               link->recordsSkipped, (unsigned long long)stats->uartTxBytes, (unsigned long long)stats->uartRxBytes);
+    }
+    printf("rules: %llu bytes lost in LPM3, %llu overruns, %llu UART sends frozen, %llu PWM freezes, "
+           "%llu outputs held high, %llu watchdog resets, %u zone(s) left too dry\n",
+           (unsigned long long)stats->uartRxLost, (unsigned long long)stats->uartRxOverrun,
+           (unsigned long long)stats->uartTxFrozen, (unsigned long long)stats->pwmFrozen,
+           (unsigned long long)stats->pwmHeldHigh, (unsigned long long)stats->watchdogResets, dryZones);
+
+    failed = stats->uartRxLost || stats->uartTxFrozen || stats->pwmFrozen || stats->pwmHeldHigh ||
+             stats->watchdogResets || link->badFrames || dryZones;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+/*
+ check.h
+ The few assertions the host tests need. A failed CHECK() prints where and why and the test carries on, so one
+ run shows every mismatch; checkDone() is the exit status for ctest.
+ */
+
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static unsigned long checkCount;
+static unsigned long checkFailures;
+
+static void checkFailed(const char *file, int line, const char *format, ...) {
+    va_list args;
+
+    if(++checkFailures > 20) {
+        return; // a broken kernel fails the same way thousands of times
+    }
+    fprintf(stderr, "%s:%d: ", file, line);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+#define CHECK(cond, ...) do { \
+        checkCount++; \
+        if(!(cond)) { \
+            checkFailed(__FILE__, __LINE__, __VA_ARGS__); \
+        } \
+    } while(0)
+
+static int checkDone(const char *name) {
+    printf("%s: %lu checks, %lu failed\n", name, checkCount, checkFailures);
+    return checkFailures ? 1 : 0;
+}
+
+#endif /* CHECK_H_ */
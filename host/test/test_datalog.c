@@ -0,0 +1,214 @@
+/*
+ test_datalog.c
+ The FRAM log round trip: entries written with logSample(), for one to LOG_ZONES_MAX zones, logValve(),
+ logRefill() and logReset() come back unchanged from logDecodeBlock(), across a reset (logInit() on a log that
+ is already there), once the ring has wrapped, and after a replay, with the blocks rebuilt from the PROTO_LOG
+ frames the simulated gateway received.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "datalog.h"
+#include "gateway.h"
+#include "protocol.h"
+#include "sim.h"
+#include "uart.h"
+
+#define TEST_ENTRIES 20000
+
+typedef struct {
+    unsigned char type;
+    unsigned short moisture;
+    short temp;
+    unsigned short value;
+} Entry;
+
+extern LogBlock logBlocks[LOG_BLOCKS];
+
+static Entry written[TEST_ENTRIES];
+static unsigned writtenCount;
+static Entry decoded[TEST_ENTRIES];
+static unsigned decodedCount;
+static LogBlock replayed[LOG_BLOCKS]; // rebuilt from PROTO_LOG frames
+static unsigned short replayedLen[LOG_BLOCKS];
+
+static void decodedEntry(unsigned char type, unsigned short moisture, short temp, unsigned short value) { // LogEntryFn
+    if(decodedCount < TEST_ENTRIES) {
+        decoded[decodedCount] = (Entry){type, moisture, temp, value};
+    }
+    decodedCount++;
+}
+
+static void decodeAll(const LogBlock *blocks) { // every valid block, oldest first
+    unsigned char order[LOG_BLOCKS];
+    unsigned char count = 0, idx, pos, tmp;
+
+    for(idx = 0; idx < LOG_BLOCKS; idx++) {
+        if(blocks[idx].magic == LOG_MAGIC) {
+            order[count++] = idx;
+        }
+    }
+    for(idx = 1; idx < count; idx++) { // insertion sort by block seq
+        for(pos = idx; pos > 0 && (short)(blocks[order[pos]].seq - blocks[order[pos - 1]].seq) < 0; pos--) {
+            tmp = order[pos];
+            order[pos] = order[pos - 1];
+            order[pos - 1] = tmp;
+        }
+    }
+    decodedCount = 0;
+    for(idx = 0; idx < count; idx++) {
+        logDecodeBlock(&blocks[order[idx]], decodedEntry);
+    }
+}
+
+static void compareTail(const char *what) { // decoded entries are the last ones written
+    unsigned first, idx;
+    const Entry *want, *got;
+
+    CHECK(decodedCount > 0 && decodedCount <= writtenCount, "%s: %u entries decoded, %u written", what,
+          decodedCount, writtenCount);
+    if(decodedCount == 0 || decodedCount > writtenCount) {
+        return;
+    }
+    first = writtenCount - decodedCount;
+    for(idx = 0; idx < decodedCount; idx++) {
+        want = &written[first + idx];
+        got = &decoded[idx];
+        CHECK(memcmp(want, got, sizeof *want) == 0, "%s: entry %u is %u %u %d %u, written %u %u %d %u", what,
+              first + idx, got->type, got->moisture, got->temp, got->value, want->type, want->moisture, want->temp,
+              want->value);
+    }
+}
+
+static unsigned short moisture[LOG_ZONES_MAX];
+static short temp;
+
+static void writeEntries(unsigned count) {
+    unsigned idx;
+    unsigned char kind, zone, zoneCount;
+
+    for(idx = 0; idx < count && writtenCount + LOG_ZONES_MAX <= TEST_ENTRIES; idx++) {
+        kind = rand() % 20;
+        if(kind == 0) { // zone 0 to 7 opens or closes
+            unsigned char zone = rand() % 8, open = rand() % 2;
+            logValve(zone, open);
+            written[writtenCount++] = (Entry){LOG_VALVE, moisture[0], temp, (unsigned short)(zone << 1 | open)};
+        } else if(kind == 1) { // up to the largest refill
+            unsigned short used = rand() % 0x4000;
+            logRefill(used);
+            written[writtenCount++] = (Entry){LOG_REFILL, moisture[0], temp, used};
+        } else if(kind == 2) {
+            unsigned short cause = rand() % 0x40;
+            logReset(cause);
+            written[writtenCount++] = (Entry){LOG_RESET, moisture[0], temp, cause};
+        } else {
+            zoneCount = (idx % 3 == 0) ? 1 + rand() % LOG_ZONES_MAX : 1; // mostly the single zone build
+            for(zone = 0; zone < zoneCount; zone++) {
+                if(kind == 3) { // a jump across the whole range, the longest varints
+                    moisture[zone] = (moisture[zone] < 2048) ? 4095 : 0;
+                } else { // usually a small step
+                    moisture[zone] = (unsigned short)(moisture[zone] + rand() % 41 - 20) & 0x0FFF;
+                }
+            }
+            if(kind == 3) { // past the range, logged clamped
+                temp = (temp < 0) ? LOG_TEMP_MAX + 500 : LOG_TEMP_MIN - 500;
+            } else {
+                temp = (short)(temp + rand() % 7 - 3);
+            }
+            logSample(moisture, zoneCount, temp, LOG_PERIOD);
+            temp = temp < LOG_TEMP_MIN ? LOG_TEMP_MIN : (temp > LOG_TEMP_MAX ? LOG_TEMP_MAX : temp);
+            for(zone = 0; zone < zoneCount; zone++) {
+                written[writtenCount++] = (Entry){LOG_SAMPLE, moisture[zone], temp, zone};
+            }
+        }
+    }
+}
+
+static void testRoundTrip(void) {
+    unsigned char zone;
+
+    logInit(); // blank FRAM
+    for(zone = 0; zone < LOG_ZONES_MAX; zone++) {
+        moisture[zone] = 1500 + 40 * zone;
+    }
+    temp = 215;
+    writeEntries(1000);
+    decodeAll(logBlocks);
+    CHECK(decodedCount == writtenCount, "%u entries decoded, %u written", decodedCount, writtenCount);
+    compareTail("round trip");
+
+    logInit(); // a reset, carries on from the newest block
+    writeEntries(500);
+    decodeAll(logBlocks);
+    CHECK(decodedCount == writtenCount, "after a reset: %u entries decoded, %u written", decodedCount, writtenCount);
+    compareTail("after a reset");
+
+    writeEntries(TEST_ENTRIES); // several times around the ring
+    decodeAll(logBlocks);
+    CHECK(decodedCount < writtenCount, "ring did not wrap after %u entries", writtenCount);
+    compareTail("wrapped");
+}
+
+static void replayFrame(const Frame *frame) { // GatewayConfig.frameFn
+    unsigned char block;
+    unsigned char offset;
+    size_t len;
+
+    if(frame->type != PROTO_LOG || frame->len < 2) {
+        return;
+    }
+    block = frame->payload[0];
+    offset = frame->payload[1];
+    len = frame->len - 2;
+    CHECK(block < LOG_BLOCKS && offset + len <= LOG_BLOCK_LEN, "PROTO_LOG chunk of block %u at %u, %u bytes", block,
+          offset, (unsigned)len);
+    if(block >= LOG_BLOCKS || offset + len > LOG_BLOCK_LEN) {
+        return;
+    }
+    CHECK(offset == replayedLen[block], "block %u chunk at %u, expected %u", block, offset, replayedLen[block]);
+    memcpy((unsigned char *)&replayed[block] + offset, &frame->payload[2], len);
+    replayedLen[block] = offset + len;
+}
+
+static void testReplay(void) {
+    GatewayConfig gateway = {2 * SIM_MS, 0, 0, 0, replayFrame};
+    SimTime until;
+    unsigned char idx;
+
+    simInit();
+    gatewayInit(&gateway);
+    simSetUartTx(gatewayByte);
+    uartInit();
+    protoInit();
+
+    logReplayStart();
+    for(until = SIM_MS; logReplaying() || protoWindowFree() < PROTO_WINDOW; until += SIM_MS) {
+        simRun(until, 0);
+        protoReceive(); // ACKs free the window for the next chunks
+        logReplayStep();
+        CHECK(until < 60 * SIM_S, "replay still running after %llu ms", (unsigned long long)(until / SIM_MS));
+        if(until >= 60 * SIM_S) {
+            break;
+        }
+    }
+
+    for(idx = 0; idx < LOG_BLOCKS; idx++) {
+        CHECK(replayedLen[idx] == 10 + logBlocks[idx].used, "block %u: %u bytes replayed, %u in FRAM", idx,
+              replayedLen[idx], 10 + logBlocks[idx].used);
+        CHECK(memcmp(&replayed[idx], &logBlocks[idx], replayedLen[idx]) == 0, "block %u differs after the replay", idx);
+    }
+    decodeAll(replayed);
+    compareTail("replayed");
+    CHECK(gatewayStats()->badFrames == 0, "%lu bad frames", gatewayStats()->badFrames);
+    CHECK(simStats()->uartRxOverrun == 0 && simStats()->uartRxLost == 0, "%llu ACK bytes overrun, %llu lost",
+          (unsigned long long)simStats()->uartRxOverrun, (unsigned long long)simStats()->uartRxLost);
+}
+
+int main(void) {
+    srand(7);
+    testRoundTrip();
+    testReplay();
+    return checkDone("test_datalog");
+}
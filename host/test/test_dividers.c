@@ -0,0 +1,86 @@
+/*
+ test_dividers.c
+ Clock dividers worked out at init from the SMCLK frequency. uartDividers() against rows of the user's guide
+ baud rate table, and for the SMCLK of every DCO range (clock.h) against the bit timing it produces: each bit
+ of a frame is UCBRx (times 16 plus UCBRFx when oversampling) SMCLK cycles long, plus one when its UCBRSx bit
+ is set, and no bit edge may be further than TEST_UART_ERROR of a bit from where it belongs at UART_BAUD.
+ uart.c refuses to build for the 1 and 2 MHz ranges, whose SMCLK is too slow for that.
+ spiDivider() has to give the fastest SPI clock that is not above SPI_HZ.
+ */
+
+#include <math.h>
+
+#include "check.h"
+#include "clock.h"
+#include "hal.h"
+#include "spi.h"
+#include "uart.h"
+
+#define TEST_UART_ERROR 0.2 // worst bit edge, fraction of a bit; the far end samples in the middle of a bit
+
+static double uartEdgeError(unsigned long clockHz, unsigned short brw, unsigned short mctlw) { // largest, in bits
+    double bit = (double)clockHz / UART_BAUD; // SMCLK cycles per bit
+    double edge = 0.0;
+    double worst = 0.0;
+    unsigned char idx;
+
+    for(idx = 0; idx < 10; idx++) { // start bit, 8 data bits, stop bit
+        edge += (mctlw & UCOS16) ? 16.0 * brw + ((mctlw >> 4) & 0x0F) : brw;
+        edge += (mctlw >> (15 - idx % 8)) & 1; // UCBRSx bit for this bit, MSB first, with the start bit
+        if(fabs(edge - bit * (idx + 1)) > worst) {
+            worst = fabs(edge - bit * (idx + 1));
+        }
+    }
+    return worst / bit;
+}
+
+static void testUartTable(void) {
+    static const struct {
+        unsigned long clockHz;
+        unsigned short brw, mctlw;
+    } table[] = { // user's guide baud rate table, 115200 baud
+        {1000000, 8, 0xD600}, {1048576, 9, 0x0800}, {4000000, 2, 0xBB21}, {8000000, 4, 0x5551},
+        {12000000, 6, 0x2081}, {16000000, 8, 0xF7A1}
+    };
+    unsigned short brw, mctlw;
+    unsigned char idx;
+
+    for(idx = 0; idx < sizeof table / sizeof table[0]; idx++) {
+        uartDividers(table[idx].clockHz, UART_BAUD, &brw, &mctlw);
+        CHECK(brw == table[idx].brw && mctlw == table[idx].mctlw, "%lu Hz: UCBRW %u UCA1MCTLW %04X, table %u %04X",
+              table[idx].clockHz, brw, mctlw, table[idx].brw, table[idx].mctlw);
+    }
+}
+
+static void testDcoRanges(void) {
+    static const unsigned long dco[] = {4000000, 8000000, 12000000, 16000000, 20000000, 24000000}; // 1 and 2 MHz: uart.c
+    unsigned long mclk, smclk;
+    unsigned short brw, mctlw, div;
+    double error;
+    unsigned char idx;
+
+    for(idx = 0; idx < sizeof dco / sizeof dco[0]; idx++) { // CLOCK_SMCLK_HZ as clock.h works it out
+        mclk = (dco[idx] / CLOCK_REFO_HZ - 1 + 1) * CLOCK_REFO_HZ;
+        smclk = mclk / CLOCK_SMCLK_DIV;
+
+        uartDividers(smclk, UART_BAUD, &brw, &mctlw);
+        error = uartEdgeError(smclk, brw, mctlw);
+        CHECK(error <= TEST_UART_ERROR, "%lu Hz DCO, SMCLK %lu Hz: UCBRW %u UCA1MCTLW %04X, bit edge off by %.0f%%",
+              dco[idx], smclk, brw, mctlw, 100.0 * error);
+
+        div = spiDivider(smclk);
+        CHECK(div >= 1 && smclk / div <= SPI_HZ && (div == 1 || smclk / (div - 1) > SPI_HZ),
+              "SMCLK %lu Hz: UCB0BRW %u gives %lu Hz SPI", smclk, div, smclk / div);
+    }
+
+    uartDividers(CLOCK_SMCLK_HZ, UART_BAUD, &brw, &mctlw); // the build's own clock
+    CHECK(uartEdgeError(CLOCK_SMCLK_HZ, brw, mctlw) <= TEST_UART_ERROR, "CLOCK_SMCLK_HZ %lu: bit edge off by %.0f%%",
+          CLOCK_SMCLK_HZ, 100.0 * uartEdgeError(CLOCK_SMCLK_HZ, brw, mctlw));
+    CHECK(spiDivider(1000000) == 1, "BME280_FR.c SMCLK: UCB0BRW %u, SPI at 1 MHz needs 1", spiDivider(1000000));
+}
+
+int main(void) {
+    testUartTable();
+    testDcoRanges();
+    return checkDone("test_dividers");
+}
@@ -0,0 +1,87 @@
+/*
+ test_filter.c
+ A probe trace replayed through filterUpdate() with moistureFilterConfig, one decimated reading per control
+ cycle: noisy dry soil, single-reading spikes of the size a servo or pump switching puts on the probe line, then
+ the step of a dose soaking in, with more spikes on the new level. Every spike has to be dropped by the median
+ (the output moves no more than the noise would move it), the output has to settle within the band of the new
+ level in the cycles the median delay and the IIR weight allow and stay there without overshoot, and
+ filterDry() on a threshold between the two levels has to switch exactly once.
+ */
+
+#include <stdlib.h>
+
+#include "check.h"
+#include "filter.h"
+
+#define TRACE_LEN 240
+#define TRACE_STEP 100 // first reading at the new level
+#define TRACE_DRY 1600 // ADC counts, higher is drier
+#define TRACE_WET 1200
+#define TRACE_NOISE 6 // +/- counts on every reading
+#define TRACE_SPIKE 900
+#define TRACE_BAND 20 // settled once within this of the new level, 5% of the step
+#define TRACE_SETTLE_MAX 13 // one reading of median delay, then (3/4)^n of the step below TRACE_BAND
+
+static unsigned short trace[TRACE_LEN];
+static unsigned char spike[TRACE_LEN]; // 1 where the reading is a spike
+
+static void makeTrace(void) {
+    static const unsigned short spikes[] = {20, 41, 43, 70, 150, 187, 220}; // never two in a row
+    unsigned char idx;
+    unsigned short pos;
+
+    for(pos = 0; pos < TRACE_LEN; pos++) {
+        trace[pos] = (pos < TRACE_STEP ? TRACE_DRY : TRACE_WET) + rand() % (2 * TRACE_NOISE + 1) - TRACE_NOISE;
+    }
+    for(idx = 0; idx < sizeof spikes / sizeof spikes[0]; idx++) {
+        trace[spikes[idx]] += (idx & 1) ? TRACE_SPIKE : -TRACE_SPIKE;
+        spike[spikes[idx]] = 1;
+    }
+}
+
+int main(void) {
+    FilterState state;
+    unsigned short out[TRACE_LEN];
+    unsigned short pos, settled = 0;
+    unsigned char switches = 0;
+    char dry, lastDry;
+    int level;
+
+    srand(5);
+    makeTrace();
+    filterInit(&state);
+    for(pos = 0; pos < TRACE_LEN; pos++) {
+        out[pos] = filterUpdate(&state, &moistureFilterConfig, trace[pos]);
+    }
+
+    for(pos = 1; pos < TRACE_LEN; pos++) { // spikes rejected: no bigger move than noise makes
+        if(spike[pos] && pos != TRACE_STEP) {
+            CHECK(abs(out[pos] - out[pos - 1]) <= TRACE_NOISE && abs(out[pos + 1] - out[pos - 1]) <= TRACE_NOISE,
+                  "spike of %d at %u moved the output from %u to %u, %u", trace[pos] - trace[pos - 1], pos,
+                  out[pos - 1], out[pos], out[pos + 1]);
+        }
+    }
+
+    for(pos = TRACE_STEP; pos < TRACE_LEN; pos++) { // settling: last reading outside the band, then inside for good
+        level = out[pos] - TRACE_WET;
+        if(abs(level) > TRACE_BAND) {
+            settled = pos + 1 - TRACE_STEP;
+        }
+        CHECK(level >= -TRACE_NOISE, "output %u at %u overshoots the new level %u", out[pos], pos, TRACE_WET);
+    }
+    printf("step of %d counts settled within %d counts after %u readings\n", TRACE_WET - TRACE_DRY, TRACE_BAND,
+           settled);
+    CHECK(settled >= 2 && settled <= TRACE_SETTLE_MAX, "settled after %u readings, %u allowed", settled,
+          TRACE_SETTLE_MAX);
+
+    filterInit(&state);
+    lastDry = 0;
+    for(pos = 0; pos < TRACE_LEN; pos++) { // dry soil, then watered past a threshold between the levels
+        dry = filterDry(&state, &moistureFilterConfig, filterUpdate(&state, &moistureFilterConfig, trace[pos]),
+                        (TRACE_DRY + TRACE_WET) / 2);
+        switches += pos > 0 && dry != lastDry;
+        lastDry = dry;
+    }
+    CHECK(switches == 1, "filterDry() switched %u times over one step", switches);
+    return checkDone("test_filter");
+}
@@ -0,0 +1,451 @@
+/*
+ test_fleet.c
+ The fleet aggregator. Records appended for a hundred nodes, enough for the file to grow twice, come back
+ from range queries exactly as a scan of what was appended gives them, with and without a zone filter, and
+ downsample buckets match the same scan, also once the file is opened again read-only. Frames through
+ ingestBytes(), split at random, are acknowledged with their seq; a resent frame stores nothing, a corrupted
+ one is not acknowledged, and records are dated back from the frame's arrival by their cycle counts, or after
+ the node's newest record when frames come in faster than that.
+
+    test_fleet [fleetd fleetload [watersim]]
+
+ Given the binaries, fleetd is started on a free port, fleetload sends it TEST_LOAD_BATCHES frames from each of
+ TEST_LOAD_NODES nodes and watersim runs a day of one node through its ESP-01 bridge; after SIGTERM the file
+ has to hold every record, each load node's 60 seconds apart.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "frame.h"
+#include "ingest.h"
+#include "protocol.h"
+#include "store.h"
+#include "telemetry.h"
+
+#define TEST_NODES 100
+#define TEST_RECORDS_MAX 10000 // per node, up to 79 chunks, so StoreChunk.ahead is used
+#define TEST_T0 1790000000000LL // ms, an autumn 2026 afternoon
+#define TEST_LOAD_NODES 10000
+#define TEST_LOAD_BATCHES 4
+#define TEST_SIM_SEED "3" // watersim node ID 51C4, above the load generator's 1 to TEST_LOAD_NODES
+
+static StoreRecord written[TEST_NODES][TEST_RECORDS_MAX];
+static unsigned writtenCount[TEST_NODES];
+static StoreRecord found[TEST_RECORDS_MAX];
+static unsigned foundCount;
+
+static uint16_t nodeId(unsigned node) {
+    return (uint16_t)(node * 211 + 7);
+}
+
+static int collect(const StoreRecord *record, void *arg) { // StoreRecordFn
+    (void)arg;
+    if(foundCount < TEST_RECORDS_MAX) {
+        found[foundCount] = *record;
+    }
+    foundCount++;
+    return 0;
+}
+
+static int sameRecord(const StoreRecord *a, const StoreRecord *b) {
+    return a->time == b->time && a->seq == b->seq && a->moisture == b->moisture && a->temp == b->temp &&
+           a->zone == b->zone && a->valve == b->valve && a->level == b->level && a->hoursLeft == b->hoursLeft &&
+           a->cycles == b->cycles;
+}
+
+static void checkRange(const Store *store, unsigned node, int zone, int64_t from, int64_t to) {
+    unsigned idx, want = 0;
+    uint64_t count;
+
+    foundCount = 0;
+    count = storeRange(store, nodeId(node), zone, from, to, collect, 0);
+    CHECK(count == foundCount, "node %u: storeRange() returned %llu, %u records", node, (unsigned long long)count,
+          foundCount);
+    for(idx = 0; idx < writtenCount[node]; idx++) {
+        if(written[node][idx].time < from || written[node][idx].time >= to ||
+           (zone != STORE_ZONE_ANY && written[node][idx].zone != zone)) {
+            continue;
+        }
+        CHECK(want < foundCount && sameRecord(&found[want], &written[node][idx]),
+              "node %u zone %d [%lld, %lld): record %u differs or is missing", node, zone, (long long)from,
+              (long long)to, want);
+        want++;
+    }
+    CHECK(want == foundCount, "node %u zone %d [%lld, %lld): %u records, %u expected", node, zone, (long long)from,
+          (long long)to, foundCount, want);
+}
+
+static void checkDownsample(const Store *store, unsigned node, int zone, int64_t from, int64_t to, int64_t width) {
+    static StoreBucket buckets[1000], want[1000];
+    size_t count, expected, bucket, idx;
+    const StoreRecord *record;
+
+    count = storeDownsample(store, nodeId(node), zone, from, to, width, buckets, 1000);
+    expected = (size_t)((to - from + width - 1) / width);
+    expected = expected > 1000 ? 1000 : expected;
+    CHECK(count == expected, "node %u: %lu buckets of %lld ms, %lu expected", node, (unsigned long)count,
+          (long long)width, (unsigned long)expected);
+    memset(want, 0, sizeof want);
+    for(idx = 0; idx < writtenCount[node]; idx++) {
+        record = &written[node][idx];
+        if(record->time < from || record->time >= to || record->time >= from + (int64_t)expected * width ||
+           (zone != STORE_ZONE_ANY && record->zone != zone)) {
+            continue;
+        }
+        bucket = (size_t)((record->time - from) / width);
+        if(want[bucket].count == 0 || record->moisture < want[bucket].moistureMin) {
+            want[bucket].moistureMin = record->moisture;
+        }
+        if(want[bucket].count == 0 || record->moisture > want[bucket].moistureMax) {
+            want[bucket].moistureMax = record->moisture;
+        }
+        if(want[bucket].count == 0 || record->temp < want[bucket].tempMin) {
+            want[bucket].tempMin = record->temp;
+        }
+        if(want[bucket].count == 0 || record->temp > want[bucket].tempMax) {
+            want[bucket].tempMax = record->temp;
+        }
+        want[bucket].count++;
+        want[bucket].valveOpen += record->valve;
+        want[bucket].moistureMean += record->moisture;
+        want[bucket].tempMean += record->temp;
+    }
+    for(bucket = 0; bucket < count && bucket < expected; bucket++) {
+        if(want[bucket].count) {
+            want[bucket].moistureMean /= want[bucket].count;
+            want[bucket].tempMean /= want[bucket].count;
+        }
+        CHECK(buckets[bucket].start == from + (int64_t)bucket * width && buckets[bucket].count == want[bucket].count &&
+              buckets[bucket].valveOpen == want[bucket].valveOpen &&
+              buckets[bucket].moistureMin == want[bucket].moistureMin &&
+              buckets[bucket].moistureMax == want[bucket].moistureMax &&
+              buckets[bucket].tempMin == want[bucket].tempMin && buckets[bucket].tempMax == want[bucket].tempMax &&
+              fabs(buckets[bucket].moistureMean - want[bucket].moistureMean) < 1e-6 &&
+              fabs(buckets[bucket].tempMean - want[bucket].tempMean) < 1e-6,
+              "node %u zone %d: bucket %lu of %lld ms has %u records, mean %.2f, %u expected, mean %.2f", node, zone,
+              (unsigned long)bucket, (long long)width, buckets[bucket].count, buckets[bucket].moistureMean,
+              want[bucket].count, want[bucket].moistureMean);
+    }
+}
+
+static void randomQueries(const Store *store, unsigned queries) {
+    unsigned query, node;
+    int64_t first, span, from, to;
+    int zone;
+
+    for(query = 0; query < queries; query++) {
+        node = rand() % TEST_NODES;
+        first = written[node][0].time;
+        span = written[node][writtenCount[node] - 1].time - first + 1;
+        from = first - span / 10 + (int64_t)(rand() / (RAND_MAX + 1.0) * span);
+        to = from + (int64_t)(rand() / (RAND_MAX + 1.0) * span / 2);
+        zone = rand() % 4 - 1; // STORE_ZONE_ANY or zone 0 to 2
+        checkRange(store, node, zone, from, to);
+        if(query % 8 == 0) {
+            checkDownsample(store, node, zone, from, to + 1, 1 + rand() % 3600000);
+        }
+    }
+    checkRange(store, 0, STORE_ZONE_ANY, written[0][0].time, written[0][writtenCount[0] - 1].time + 1); // all of it
+}
+
+static void testStore(const char *path) {
+    Store store;
+    StoreRecord *record;
+    unsigned wanted[TEST_NODES];
+    unsigned node, left, zones, zone;
+    int64_t time;
+    uint32_t grown;
+
+    unlink(path);
+    CHECK(storeOpen(&store, path, 1), "cannot create %s", path);
+    grown = store.header->chunks;
+    for(node = 0, left = 0; node < TEST_NODES; node++) {
+        wanted[node] = 200 + rand() % (TEST_RECORDS_MAX - 200);
+        left += wanted[node];
+    }
+    while(left) { // the nodes' records interleaved, as they arrive
+        node = rand() % TEST_NODES;
+        zones = 1 + rand() % 3;
+        time = writtenCount[node] ? written[node][writtenCount[node] - 1].time + rand() % 120000 : TEST_T0 + node;
+        for(zone = 0; zone < zones && writtenCount[node] < wanted[node]; zone++, left--) { // one sample
+            record = &written[node][writtenCount[node]];
+            *record = (StoreRecord){time, (uint16_t)writtenCount[node], (uint16_t)(rand() % 4096),
+                                    (int16_t)(rand() % 1250 - 400), (uint8_t)zone, (uint8_t)(rand() % 2),
+                                    (uint8_t)(rand() % 101), (uint16_t)rand(), 60};
+            CHECK(storeAppend(&store, nodeId(node), record) == 1, "node %u: record %u not stored", node,
+                  writtenCount[node]);
+            writtenCount[node]++;
+        }
+    }
+    CHECK(store.header->chunks >= 4 * grown, "the file grew from %u to %u chunks, should have doubled twice", grown,
+          store.header->chunks);
+    record = &written[5][writtenCount[5] - 1];
+    record->time--;
+    CHECK(storeAppend(&store, nodeId(5), record) == 0, "a record older than the node's newest was stored");
+    record->time++;
+    CHECK(storeNode(&store, nodeId(5))->records == writtenCount[5], "node 5 has %llu records, %u appended",
+          (unsigned long long)storeNode(&store, nodeId(5))->records, writtenCount[5]);
+    CHECK(storeRange(&store, 1, STORE_ZONE_ANY, 0, TEST_T0 * 2, 0, 0) == 0, "records of a node never written");
+    randomQueries(&store, 2000);
+    storeClose(&store);
+
+    CHECK(storeOpen(&store, path, 0), "cannot open %s again", path);
+    CHECK(store.header->nodes == TEST_NODES, "%u nodes after reopening, %u written", store.header->nodes, TEST_NODES);
+    randomQueries(&store, 500);
+    storeClose(&store);
+}
+
+static uint8_t replies[4096];
+static size_t repliesLen;
+
+static void collectReply(const uint8_t *data, size_t len, void *arg) { // IngestReplyFn
+    (void)arg;
+    if(repliesLen + len <= sizeof replies) {
+        memcpy(&replies[repliesLen], data, len);
+        repliesLen += len;
+    }
+}
+
+static void sendFrame(Ingest *ingest, IngestStream *stream, uint8_t type, uint8_t seq, const uint8_t *payload,
+                      size_t len, int64_t now, int corrupt) { // in random pieces, checks the ACK
+    uint8_t out[FRAME_COBS_MAX];
+    size_t outLen = frameEncode(type, seq, 1, 0x0BEE, payload, len, out);
+    size_t done, piece, idx;
+    FrameReader reader;
+    Frame ack;
+    unsigned acks = 0;
+
+    if(corrupt) {
+        out[outLen / 2] ^= 0x01;
+    }
+    repliesLen = 0;
+    for(done = 0; done < outLen; done += piece) {
+        piece = 1 + rand() % (outLen - done);
+        ingestBytes(ingest, stream, &out[done], piece, now, collectReply, 0);
+    }
+    frameReaderInit(&reader);
+    for(idx = 0; idx < repliesLen; idx++) {
+        if(frameReaderPush(&reader, replies[idx], 0, &ack)) {
+            acks++;
+            CHECK(ack.type == PROTO_ACK && ack.len == 1 && ack.payload[0] == seq, "reply %02X of %u bytes to seq %u",
+                  ack.type, (unsigned)ack.len, seq);
+        }
+    }
+    CHECK(acks == (corrupt ? 0U : 1U), "%u ACKs for frame seq %u%s", acks, seq, corrupt ? ", corrupted" : "");
+}
+
+static void telemetryBatch(uint8_t *payload, uint16_t seq, unsigned char zones) { // TELEMETRY_BATCH records
+    unsigned char idx;
+    uint8_t *record;
+
+    for(idx = 0; idx < TELEMETRY_BATCH; idx++, seq++) {
+        record = &payload[idx * TELEMETRY_RECORD_LEN];
+        memset(record, 0, TELEMETRY_RECORD_LEN);
+        record[0] = (uint8_t)seq;
+        record[1] = (uint8_t)(seq >> 8);
+        record[2] = (uint8_t)seq; // moisture, so the record can be told apart
+        record[6] = (uint8_t)((seq % zones) << 4);
+        record[10] = 60; // cycles
+    }
+}
+
+static void checkTimes(const Store *store, uint16_t seq, const int64_t *times) { // TELEMETRY_BATCH records from seq
+    unsigned idx;
+
+    foundCount = 0;
+    storeRange(store, 0x0BEE, STORE_ZONE_ANY, 0, TEST_T0 * 2, collect, 0);
+    for(idx = 0; idx < foundCount && found[idx].seq != seq; idx++) {
+    }
+    CHECK(idx + TELEMETRY_BATCH <= foundCount, "records from seq %u not stored", seq);
+    for(; idx < foundCount && found[idx].seq < seq + TELEMETRY_BATCH; idx++) {
+        CHECK(found[idx].time == times[found[idx].seq - seq], "record %u at %lld ms, expected %lld", found[idx].seq,
+              (long long)(found[idx].time - TEST_T0), (long long)(times[found[idx].seq - seq] - TEST_T0));
+    }
+}
+
+static void testIngest(const char *path) {
+    uint8_t payload[TELEMETRY_BATCH * TELEMETRY_RECORD_LEN];
+    IngestStream stream;
+    Ingest ingest;
+    Store store;
+    const int64_t t = TEST_T0;
+
+    unlink(path);
+    CHECK(storeOpen(&store, path, 1), "cannot create %s", path);
+    ingestInit(&ingest, &store);
+    ingestStreamInit(&stream);
+
+    telemetryBatch(payload, 0, 2); // two samples of zones 0 and 1
+    sendFrame(&ingest, &stream, PROTO_TELEMETRY, 10, payload, sizeof payload, t, 0);
+    checkTimes(&store, 0, (const int64_t[]){t - 60000, t - 60000, t, t});
+
+    sendFrame(&ingest, &stream, PROTO_TELEMETRY, 10, payload, sizeof payload, t + 5000, 0); // its ACK was lost
+    CHECK(ingest.stats.duplicates == TELEMETRY_BATCH && ingest.stats.records == TELEMETRY_BATCH,
+          "resent frame: %llu duplicates, %llu records", (unsigned long long)ingest.stats.duplicates,
+          (unsigned long long)ingest.stats.records);
+
+    telemetryBatch(payload, 4, 2); // right behind the first, faster than the node's clock
+    sendFrame(&ingest, &stream, PROTO_TELEMETRY, 11, payload, sizeof payload, t + 10, 0);
+    checkTimes(&store, 4, (const int64_t[]){t + 60000, t + 60000, t + 120000, t + 120000});
+
+    telemetryBatch(payload, 8, 2); // an hour later, dated from its arrival again
+    sendFrame(&ingest, &stream, PROTO_TELEMETRY, 12, payload, sizeof payload, t + 3600000, 0);
+    checkTimes(&store, 8, (const int64_t[]){t + 3540000, t + 3540000, t + 3600000, t + 3600000});
+
+    telemetryBatch(payload, 12, 2);
+    sendFrame(&ingest, &stream, PROTO_TELEMETRY, 13, payload, sizeof payload, t + 3660000, 1);
+    CHECK(ingest.stats.badFrames == 1 && ingest.stats.records == 3 * TELEMETRY_BATCH,
+          "corrupted frame: %llu bad, %llu records", (unsigned long long)ingest.stats.badFrames,
+          (unsigned long long)ingest.stats.records);
+
+    telemetryBatch(payload, 1000, 2); // records skipped while the window was full
+    sendFrame(&ingest, &stream, PROTO_TELEMETRY, 14, payload, sizeof payload, t + 7200000, 0);
+    telemetryBatch(payload, 0, 2); // the node restarted
+    sendFrame(&ingest, &stream, PROTO_TELEMETRY, 0, payload, sizeof payload, t + 7300000, 0);
+    checkTimes(&store, 0, (const int64_t[]){t - 60000, t - 60000, t, t}); // the first ones are still there
+    CHECK(ingest.stats.records == 5 * TELEMETRY_BATCH && storeNode(&store, 0x0BEE)->lastSeq == 3,
+          "after a restart: %llu records, newest seq %u", (unsigned long long)ingest.stats.records,
+          storeNode(&store, 0x0BEE)->lastSeq);
+
+    sendFrame(&ingest, &stream, PROTO_LOG, 1, payload, 10, t + 7300000, 0);
+    sendFrame(&ingest, &stream, PROTO_STATS, 2, payload, 10, t + 7300000, 0);
+    CHECK(ingest.stats.logFrames == 1 && ingest.stats.statsFrames == 1 && ingest.stats.frames == 8,
+          "%llu log, %llu stats frames of %llu", (unsigned long long)ingest.stats.logFrames,
+          (unsigned long long)ingest.stats.statsFrames, (unsigned long long)ingest.stats.frames);
+    storeClose(&store);
+}
+
+static pid_t spawn(char *const argv[], int *out) { // stdout into *out if given
+    int pipeFd[2];
+    pid_t pid;
+
+    if(out && pipe(pipeFd) != 0) {
+        return -1;
+    }
+    pid = fork();
+    if(pid == 0) {
+        if(out) {
+            dup2(pipeFd[1], STDOUT_FILENO);
+            close(pipeFd[0]);
+            close(pipeFd[1]);
+        }
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    if(out) {
+        close(pipeFd[1]);
+        *out = pipeFd[0];
+    }
+    return pid;
+}
+
+static int run(char *const argv[]) { // exit status, -1 if it did not exit
+    int status;
+    pid_t pid = spawn(argv, 0);
+
+    if(pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+static uint16_t simNode;
+static unsigned loadNodes;
+
+static int countNode(const StoreRecord *record, void *arg) { // StoreRecordFn, checks the spacing too
+    int64_t *last = arg;
+
+    CHECK(*last == 0 || record->time - *last == 60000, "load node record %u is %lld ms after the one before",
+          record->seq, (long long)(record->time - *last));
+    *last = record->time;
+    return 0;
+}
+
+static void testFleetd(const char *path, char *fleetd, char *fleetload, char *watersim) {
+    char line[256], port[16] = "", address[32], nodes[16], batches[16];
+    char *fleetdArgs[] = {fleetd, "-f", (char *)path, "-p", "0", "-t", "300", 0};
+    char *loadArgs[] = {fleetload, "-n", nodes, "-c", "500", "-b", batches, "-p", port, 0};
+    char *simArgs[] = {watersim, "-d", "1", "-s", TEST_SIM_SEED, "-c", address, 0};
+    Store store;
+    const StoreNode *entry;
+    unsigned node;
+    int64_t last;
+    int out, status;
+    FILE *log;
+    pid_t pid;
+
+    unlink(path);
+    pid = spawn(fleetdArgs, &out);
+    log = fdopen(out, "r");
+    while(pid > 0 && log && fgets(line, sizeof line, log)) {
+        fputs(line, stdout);
+        if(sscanf(line, "fleetd: listening on port %15[0-9]", port) == 1) {
+            break;
+        }
+    }
+    CHECK(port[0] != '\0', "fleetd did not start");
+    if(port[0] == '\0') {
+        return;
+    }
+    snprintf(address, sizeof address, "127.0.0.1:%s", port);
+    snprintf(nodes, sizeof nodes, "%u", TEST_LOAD_NODES);
+    snprintf(batches, sizeof batches, "%u", TEST_LOAD_BATCHES);
+    fflush(stdout);
+
+    CHECK(run(loadArgs) == 0, "fleetload failed");
+    loadNodes = TEST_LOAD_NODES;
+    if(watersim) {
+        CHECK(run(simArgs) == 0, "watersim through the ESP-01 bridge failed");
+    }
+    kill(pid, SIGTERM);
+    while(fgets(line, sizeof line, log)) {
+        fputs(line, stdout);
+    }
+    fclose(log);
+    CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0, "fleetd failed");
+
+    CHECK(storeOpen(&store, path, 0), "cannot open what fleetd wrote");
+    for(node = 1; node <= loadNodes; node++) {
+        entry = storeNode(&store, (uint16_t)node);
+        last = 0;
+        CHECK(entry->records == TEST_LOAD_BATCHES * TELEMETRY_BATCH &&
+              storeRange(&store, (uint16_t)node, STORE_ZONE_ANY, entry->firstTime, entry->lastTime + 1, countNode,
+                         &last) == entry->records,
+              "load node %u: %llu records, %u sent", node, (unsigned long long)entry->records,
+              TEST_LOAD_BATCHES * TELEMETRY_BATCH);
+    }
+    if(watersim) {
+        for(node = loadNodes + 1; node < STORE_NODES && storeNode(&store, (uint16_t)node)->records == 0; node++) {
+        }
+        simNode = (uint16_t)node;
+        CHECK(node < STORE_NODES && storeNode(&store, simNode)->records >= 24 * 60,
+              "watersim node %04X: %llu records from a day", node,
+              node < STORE_NODES ? (unsigned long long)storeNode(&store, simNode)->records : 0ULL);
+    }
+    CHECK(store.header->nodes == loadNodes + (watersim ? 1 : 0), "%u nodes in the file", store.header->nodes);
+    storeClose(&store);
+}
+
+int main(int argc, char **argv) {
+    char path[] = "/tmp/test_fleet.XXXXXX";
+    int fd = mkstemp(path);
+
+    srand(11);
+    CHECK(fd >= 0, "no temporary file");
+    close(fd);
+    testStore(path);
+    testIngest(path);
+    if(argc >= 3) {
+        testFleetd(path, argv[1], argv[2], argc >= 4 ? argv[3] : 0);
+    }
+    unlink(path);
+    return checkDone("test_fleet");
+}
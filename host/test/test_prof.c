@@ -0,0 +1,90 @@
+/*
+ test_prof.c
+ Stage budgets of the control loop on the host. The whole firmware (main.c as firmwareMain, like watersim) runs
+ its first control cycles against the plant, each a tick and an ADC half, with the profiling macros backed by
+ the host clock through halProfCount(); then the gateway asks for the table and every stage that ran has to
+ have stayed within its profBudget (prof.h). The host is much faster than the MSP430, so this does not show
+ the firmware keeps its budgets on the chip; it catches a stage that starts blocking or looping, which blows
+ the budget on any machine. The table is checked through its PROTO_STATS frames, so the dump is tested too.
+ */
+
+#include <setjmp.h>
+
+#include "check.h"
+#include "gateway.h"
+#include "plant.h"
+#include "prof.h"
+#include "protocol.h"
+#include "sim.h"
+
+#define TEST_RUN (10 * SIM_MINUTE) // some control cycles, up to a minute apart while the soil is far from dry
+
+void firmwareMain(void);
+
+static const char *const stageNames[PROF_STAGES] = {
+    "tick", "average", "control", "report", "replay", "tick latency", "ADC latency", "ADC interrupt",
+    "UART interrupt", "servo interrupt", "button interrupt"
+};
+
+static jmp_buf finish;
+static unsigned short maxTicks[PROF_STAGES];
+static unsigned short counts[PROF_STAGES];
+static unsigned char dumped[PROF_STAGES];
+
+static void stop(void) {
+    longjmp(finish, 1);
+}
+
+static unsigned short getShort(const unsigned char *src) {
+    return (unsigned short)(src[0] | src[1] << 8);
+}
+
+static void statsFrame(const Frame *frame) { // GatewayConfig.frameFn
+    unsigned char stage;
+
+    if(frame->type != PROTO_STATS) {
+        return;
+    }
+    stage = frame->payload[0];
+    CHECK(frame->len == 1 + 10 + 2 * PROF_BUCKETS && stage < PROF_STAGES, "PROTO_STATS of %u bytes, stage %u",
+          (unsigned)frame->len, stage);
+    if(frame->len != 1 + 10 + 2 * PROF_BUCKETS || stage >= PROF_STAGES) {
+        return;
+    }
+    maxTicks[stage] = getShort(&frame->payload[3]);
+    counts[stage] = getShort(&frame->payload[9]);
+    dumped[stage] = 1;
+}
+
+int main(void) {
+    GatewayConfig gateway = {5 * SIM_MS, 0, 0, TEST_RUN, statsFrame};
+    unsigned char stage;
+
+    simInit();
+    plantInit(1);
+    gatewayInit(&gateway);
+    simSetAdc(plantAdc);
+    simSetUartTx(gatewayByte);
+    simTimer(PLANT_STEP, PLANT_STEP, plantStep);
+    simSetStop(TEST_RUN + 2 * SIM_MINUTE, stop); // the request goes out behind the next ACK
+
+    if(setjmp(finish) == 0) {
+        firmwareMain(); // returns through stop()
+    }
+
+    for(stage = 0; stage < PROF_STAGES; stage++) {
+        CHECK(dumped[stage], "stage %u (%s) not dumped", stage, stageNames[stage]);
+        if(counts[stage] == 0) {
+            printf("%-16s  did not run\n", stageNames[stage]);
+            continue;
+        }
+        printf("%-16s  %5u runs, longest %5u ticks, budget %5u\n", stageNames[stage], counts[stage],
+               maxTicks[stage], profBudget[stage]);
+        CHECK(maxTicks[stage] <= profBudget[stage], "%s took %u ticks, budget %u", stageNames[stage],
+              maxTicks[stage], profBudget[stage]);
+    }
+    CHECK(counts[PROF_TICK] > 0 && counts[PROF_AVERAGE] > 0 && counts[PROF_CONTROL] > 0 && counts[PROF_REPORT] > 0,
+          "no complete control cycle: %u ticks, %u averages, %u control, %u reports", counts[PROF_TICK],
+          counts[PROF_AVERAGE], counts[PROF_CONTROL], counts[PROF_REPORT]);
+    return checkDone("test_prof");
+}
@@ -0,0 +1,165 @@
+/*
+ test_protocol.c
+ The link protocol over the simulated UART, with the simulated gateway (frame.c) at the other end: every
+ payload length with and without zero bytes survives the firmware's COBS encoder and CRC, the window holds
+ PROTO_WINDOW frames and refuses the next one, unacknowledged frames are sent again every PROTO_RETRY_TICKS
+ control cycles until PROTO_RETRIES sends, an ACK frees exactly its slot and a corrupted one frees nothing, the
+ receiver keeps SMCLK for PROTO_LISTEN_TICKS after the window has emptied, and requests from the gateway
+ come out of protoReceive().
+ */
+
+#include <string.h>
+
+#include "check.h"
+#include "gateway.h"
+#include "hal.h"
+#include "protocol.h"
+#include "scheduler.h"
+#include "sim.h"
+#include "uart.h"
+
+static uint8_t sent[PROTO_PAYLOAD_MAX];
+static size_t sentLen;
+static uint8_t sentType;
+static uint8_t sentSeq;
+static unsigned long received;
+
+static void checkFrame(const Frame *frame) { // GatewayConfig.frameFn, the frame protoSend() was just given
+    received++;
+    CHECK(frame->type == sentType && frame->seq == sentSeq && frame->node == protoNodeId(),
+          "frame type %02X seq %u node %04X, sent %02X %u %04X", frame->type, frame->seq, frame->node, sentType,
+          sentSeq, protoNodeId());
+    CHECK(frame->len == sentLen && memcmp(frame->payload, sent, sentLen) == 0, "payload of %u bytes differs, sent %u",
+          (unsigned)frame->len, (unsigned)sentLen);
+}
+
+static void recordSeq(const Frame *frame) { // GatewayConfig.frameFn
+    sentSeq = frame->seq;
+}
+
+static SimTime now;
+
+static void advance(SimTime time) { // the link side of the main loop, in 1 ms steps
+    SimTime until = now + time;
+
+    while(now < until) {
+        now += SIM_MS;
+        simRun(now, 0);
+        protoReceive();
+    }
+}
+
+static void gatewaySend(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len) {
+    uint8_t out[FRAME_COBS_MAX];
+
+    simUartRx(out, frameEncode(type, seq, 0, 0, payload, len, out), SIM_MS);
+}
+
+static void start(GatewayConfig *gateway) {
+    simInit();
+    gatewayInit(gateway);
+    simSetUartTx(gatewayByte);
+    uartInit();
+    protoInit();
+    now = 0;
+}
+
+static void testCobs(void) {
+    GatewayConfig gateway = {SIM_MS, 0, 0, 0, checkFrame};
+    unsigned char len, fill, idx;
+
+    start(&gateway);
+    for(len = 0; len <= PROTO_PAYLOAD_MAX; len++) {
+        for(fill = 0; fill < 4; fill++) { // all zeros, no zeros, alternating, zeros at the ends
+            for(idx = 0; idx < len; idx++) {
+                sent[idx] = fill == 0 ? 0 : fill == 1 ? (uint8_t)(0xFF - idx) : fill == 2 ? (uint8_t)(idx & 1) * 0x55 :
+                            (uint8_t)((idx == 0 || idx == len - 1) ? 0 : idx);
+            }
+            sentLen = len;
+            sentType = PROTO_TELEMETRY + fill % 3;
+            CHECK(protoSend(sentType, sent, len), "protoSend() of %u bytes refused with an empty window", len);
+            advance(20 * SIM_MS); // sent and acknowledged
+            CHECK(protoWindowFree() == PROTO_WINDOW, "frame %u not acknowledged", sentSeq);
+            sentSeq++;
+        }
+    }
+    CHECK(received == (PROTO_PAYLOAD_MAX + 1) * 4UL, "gateway decoded %lu frames, %lu sent", received,
+          (PROTO_PAYLOAD_MAX + 1) * 4UL);
+    CHECK(gatewayStats()->badFrames == 0, "%lu bad frames", gatewayStats()->badFrames);
+    CHECK(!protoSend(PROTO_TELEMETRY, sent, PROTO_PAYLOAD_MAX + 1), "payload over PROTO_PAYLOAD_MAX accepted");
+}
+
+static void testWindow(void) {
+    GatewayConfig gateway = {SIM_MS, 1, 0, 0, recordSeq}; // every ACK dropped
+    unsigned char slot, tick;
+    uint8_t seq[PROTO_WINDOW];
+    uint8_t bad[FRAME_COBS_MAX];
+    size_t len;
+
+    start(&gateway);
+    memset(sent, 0xA5, sizeof sent);
+    for(slot = 0; slot < PROTO_WINDOW; slot++) {
+        CHECK(protoSend(PROTO_TELEMETRY, sent, 12), "frame %u refused with %u slots free", slot, protoWindowFree());
+        advance(5 * SIM_MS);
+        seq[slot] = sentSeq;
+    }
+    CHECK(protoWindowFree() == 0, "%u slots free after %u frames", protoWindowFree(), PROTO_WINDOW);
+    CHECK(!protoSend(PROTO_TELEMETRY, sent, 12), "frame accepted with the window full");
+
+    gatewaySend(PROTO_ACK, 0, &seq[1], 1); // the second frame, by hand
+    advance(5 * SIM_MS);
+    CHECK(protoWindowFree() == 1, "%u slots free after one ACK", protoWindowFree());
+
+    len = frameEncode(PROTO_ACK, 1, 0, 0, &seq[2], 1, bad); // the third frame, corrupted
+    bad[1] ^= 0x40;
+    simUartRx(bad, len, SIM_MS);
+    advance(5 * SIM_MS);
+    CHECK(protoWindowFree() == 1, "corrupted ACK freed a slot");
+
+    for(tick = 1; tick < PROTO_RETRY_TICKS * PROTO_RETRIES; tick++) { // resends of the three left
+        protoTick();
+        advance(20 * SIM_MS);
+        CHECK(protoWindowFree() == 1, "tick %u: %u slots free while frames are being resent", tick, protoWindowFree());
+    }
+    CHECK(gatewayStats()->resent == (PROTO_WINDOW - 1) * (PROTO_RETRIES - 1UL), "%lu resends, expected %lu",
+          gatewayStats()->resent, (PROTO_WINDOW - 1) * (PROTO_RETRIES - 1UL));
+    protoTick(); // given up after PROTO_RETRIES sends
+    CHECK(protoWindowFree() == PROTO_WINDOW, "%u slots free after the last retry", protoWindowFree());
+    CHECK(gatewayStats()->badFrames == 0, "%lu bad frames", gatewayStats()->badFrames);
+
+    for(tick = 1; tick < PROTO_LISTEN_TICKS; tick++) { // the tick that gave up is the first one listening
+        CHECK(schedSmclkUsers & SMCLK_LINK, "receiver stopped %u ticks after the window emptied", tick);
+        protoTick();
+    }
+    CHECK(!(schedSmclkUsers & SMCLK_LINK), "receiver still clocked %u ticks after the window emptied",
+          PROTO_LISTEN_TICKS);
+}
+
+static void testRequests(void) {
+    GatewayConfig gateway = {SIM_MS, 0, 0, 0, 0};
+    uint8_t node[2] = {0x34, 0x12};
+    unsigned char request;
+    SimTime until;
+
+    start(&gateway);
+    CHECK(protoNodeId() != 0, "no node ID after protoInit()");
+
+    gatewaySend(PROTO_SET_NODE, 0, node, 2);
+    advance(5 * SIM_MS);
+    CHECK(protoNodeId() == 0x1234, "node ID %04X after PROTO_SET_NODE 1234", protoNodeId());
+
+    gatewaySend(PROTO_REPLAY, 1, 0, 0);
+    for(request = 0, until = now + 5 * SIM_MS; now < until && request == 0; ) {
+        now += SIM_MS;
+        simRun(now, 0);
+        request = protoReceive();
+    }
+    CHECK(request == PROTO_REPLAY, "protoReceive() returned %02X for PROTO_REPLAY", request);
+}
+
+int main(void) {
+    testCobs();
+    testWindow();
+    testRequests();
+    return checkDone("test_protocol");
+}
@@ -0,0 +1,342 @@
+/*
+ test_sensor.c
+ The sensor math against references worked out another way: tempFromAdc() against the TLV calibration formula
+ the firmware started with, in floating point, over every 12-bit reading; fmtUnsigned() and fmtFixed() against
+ snprintf(); the BME280 compensation against the data sheet's worked example and its floating point formulas,
+ BME280CompensateBatch() bit for bit against CalcTemp(), CalcHumid() and CalcPress(), and GetCompData() and
+ ReadTHsensor() against a simulated sensor on the SPI bus.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BME280.h"
+#include "check.h"
+#include "clock.h"
+#include "format.h"
+#include "sim.h"
+#include "spi.h"
+#include "tempsense.h"
+
+#define TEST_CS 0x10 // P1.4
+
+// data sheet worked example (BMP280 data sheet 3.12, same T and P formulas as the BME280)
+static const BME280Cal sheetCal = {
+    BME280_CAL_MAGIC, TEST_CS,
+    75, 0, 30, // dig_H1, dig_H3, dig_H6: typical humidity coefficients, the sheet has no humidity example
+    27504, 36477, // dig_T1, dig_P1
+    26435, -1000, // dig_T2, dig_T3
+    -10685, 3024, 2855, 140, -7, 15500, -14600, 6000, // dig_P2 to dig_P9
+    362, 324, 0 // dig_H2, dig_H4, dig_H5
+};
+#define SHEET_RAW_T 519888
+#define SHEET_RAW_P 415148
+#define SHEET_T_FINE 128422
+#define SHEET_T 2508 // 25.08C
+#define SHEET_P 100656 // Pa, 32-bit integer formula; 100653.27 in double precision
+#define PRESS_TOLERANCE 8.0 // Pa, rounding of the 32-bit formula against the double precision one, 0.08 hPa
+
+static double refTFine(const BME280Cal *cal, int32_t rawTemp) { // data sheet 8.1, double precision
+    double var1 = ((double)rawTemp / 16384.0 - (double)cal->dig_T1 / 1024.0) * (double)cal->dig_T2;
+    double var2 = ((double)rawTemp / 131072.0 - (double)cal->dig_T1 / 8192.0);
+
+    var2 = var2 * var2 * (double)cal->dig_T3;
+    return var1 + var2;
+}
+
+static double refPress(const BME280Cal *cal, double tFine, int32_t rawPress) { // Pa
+    double var1 = tFine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * (double)cal->dig_P6 / 32768.0;
+    double p;
+
+    var2 = var2 + var1 * (double)cal->dig_P5 * 2.0;
+    var2 = var2 / 4.0 + (double)cal->dig_P4 * 65536.0;
+    var1 = ((double)cal->dig_P3 * var1 * var1 / 524288.0 + (double)cal->dig_P2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * (double)cal->dig_P1;
+    if(var1 == 0.0) {
+        return 0.0;
+    }
+    p = 1048576.0 - (double)rawPress;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = (double)cal->dig_P9 * p * p / 2147483648.0;
+    var2 = p * (double)cal->dig_P8 / 32768.0;
+    return p + (var1 + var2 + (double)cal->dig_P7) / 16.0;
+}
+
+static double refHumid(const BME280Cal *cal, double tFine, int32_t rawHumid) { // %RH
+    double h = tFine - 76800.0;
+
+    h = ((double)rawHumid - ((double)cal->dig_H4 * 64.0 + (double)cal->dig_H5 / 16384.0 * h)) *
+        ((double)cal->dig_H2 / 65536.0 * (1.0 + (double)cal->dig_H6 / 67108864.0 * h *
+        (1.0 + (double)cal->dig_H3 / 67108864.0 * h)));
+    h = h * (1.0 - (double)cal->dig_H1 * h / 524288.0);
+    return h < 0.0 ? 0.0 : (h > 100.0 ? 100.0 : h);
+}
+
+static long testRandom(long lo, long hi) { // lo to hi inclusive
+    return lo + (long)(((unsigned long)rand() << 15 ^ (unsigned long)rand()) % (unsigned long)(hi - lo + 1));
+}
+
+static void testTempSense(void) {
+    static const unsigned short cal[][2] = { // 30C and 85C readings: simulated TLV, spread of real parts
+        {1950, 2335}, {1800, 2190}, {2100, 2470}, {2050, 2600}
+    };
+    static const unsigned short blank[][2] = { // erased TLV, only one point erased, 85C reading not above 30C
+        {0xFFFF, 0xFFFF}, {0xFFFF, 2335}, {1950, 0xFFFF}, {2000, 1900}, {2000, 2000}
+    };
+    unsigned char set;
+    unsigned short adc;
+    double ref;
+    short got;
+
+    for(set = 0; set < sizeof cal / sizeof cal[0]; set++) {
+        tempLutBuild(cal[set][0], cal[set][1]);
+        for(adc = 0; adc < 4096; adc++) {
+            ref = ((double)adc - cal[set][0]) * (85 - 30) / (cal[set][1] - cal[set][0]) + 30; // the pre-LUT float formula
+            got = tempFromAdc(adc);
+            CHECK(fabs(got - ref * 10.0) <= 1.0, "TLV %u/%u adc %u: %d, formula %.2f", cal[set][0], cal[set][1], adc,
+                  got, ref * 10.0);
+        }
+    }
+
+    for(set = 0; set < sizeof blank / sizeof blank[0]; set++) { // typical calibration instead
+        tempLutBuild(blank[set][0], blank[set][1]);
+        for(adc = 0; adc < 4096; adc++) {
+            ref = ((double)adc - 1950) * (85 - 30) / (2335 - 1950) + 30;
+            got = tempFromAdc(adc);
+            CHECK(fabs(got - ref * 10.0) <= 1.0, "TLV %04X/%04X adc %u: %d, typical %.2f", blank[set][0],
+                  blank[set][1], adc, got, ref * 10.0);
+            CHECK(adc == 0 || got >= tempFromAdc(adc - 1), "TLV %04X/%04X adc %u: %d after %d", blank[set][0],
+                  blank[set][1], adc, got, tempFromAdc(adc - 1));
+        }
+    }
+}
+
+static void testFormat(void) {
+    static const unsigned long edges[] = {
+        0, 1, 9, 10, 99, 100, 65535, 65536, 999999999UL, 1000000000UL, 4294967294UL, 4294967295UL
+    };
+    char got[FMT_FIXED_MAX + 1];
+    char ref[32];
+    unsigned char len, digits, decimals;
+    unsigned long num, pow10;
+    long value, mag;
+    unsigned idx;
+
+    for(idx = 0; idx < 20000; idx++) {
+        num = idx < sizeof edges / sizeof edges[0] ? edges[idx] : (unsigned long)testRandom(0, 0xFFFFFFFFL) >> (idx % 32);
+        for(digits = 0; digits <= FMT_DIGITS_MAX; digits++) {
+            len = fmtUnsigned(got, num, digits);
+            got[len] = '\0';
+            snprintf(ref, sizeof ref, "%0*lu", digits ? digits : 1, num);
+            CHECK(strcmp(got, ref) == 0, "fmtUnsigned(%lu, %u): \"%s\", expected \"%s\"", num, digits, got, ref);
+        }
+    }
+
+    for(idx = 0; idx < 20000; idx++) {
+        value = testRandom(-2147483647L, 2147483647L) >> (idx % 32);
+        for(decimals = 0, pow10 = 1; decimals <= 4; decimals++, pow10 *= 10) {
+            len = fmtFixed(got, value, decimals);
+            got[len] = '\0';
+            mag = value < 0 ? -value : value;
+            if(decimals == 0) {
+                snprintf(ref, sizeof ref, "%ld", value);
+            } else {
+                snprintf(ref, sizeof ref, "%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)mag / pow10, decimals,
+                         (unsigned long)mag % pow10);
+            }
+            CHECK(strcmp(got, ref) == 0, "fmtFixed(%ld, %u): \"%s\", expected \"%s\"", value, decimals, got, ref);
+        }
+    }
+}
+
+static void testBme280Sheet(void) {
+    BME280Cal cal = sheetCal;
+    BME280 dev = {0};
+    int32_t temp;
+    uint32_t press, humid;
+    double tFine, ref;
+    int32_t raw;
+
+    dev.cal = &cal;
+    dev.RawTemp = SHEET_RAW_T;
+    dev.RawPress = SHEET_RAW_P;
+    temp = CalcTemp(&dev);
+    press = CalcPress(&dev);
+    CHECK(dev.t_fine == SHEET_T_FINE, "t_fine %ld, data sheet %d", (long)dev.t_fine, SHEET_T_FINE);
+    CHECK(temp == SHEET_T, "temperature %ld, data sheet %d", (long)temp, SHEET_T);
+    CHECK(press == SHEET_P, "pressure %lu Pa, data sheet %d", (unsigned long)press, SHEET_P);
+
+    for(raw = 380000; raw <= 640000; raw += 500) { // about -20C to 70C with these coefficients
+        dev.RawTemp = raw;
+        temp = CalcTemp(&dev);
+        tFine = refTFine(&cal, raw);
+        CHECK(fabs(temp - tFine / 51.20) <= 1.0, "raw T %ld: %ld, formula %.2f", (long)raw, (long)temp, tFine / 51.20);
+
+        for(dev.RawPress = 250000; dev.RawPress <= 550000; dev.RawPress += 25000) { // 1100 to 300 hPa
+            press = CalcPress(&dev);
+            ref = refPress(&cal, dev.t_fine, dev.RawPress);
+            CHECK(fabs(press - ref) <= PRESS_TOLERANCE, "raw T %ld P %ld: %lu Pa, formula %.2f", (long)raw, (long)dev.RawPress,
+                  (unsigned long)press, ref);
+        }
+        for(dev.RawHumid = 20000; dev.RawHumid <= 50000; dev.RawHumid += 1000) {
+            humid = CalcHumid(&dev);
+            ref = refHumid(&cal, dev.t_fine, dev.RawHumid);
+            CHECK(fabs(humid / 1024.0 - ref) <= 0.05, "raw T %ld H %ld: %.3f %%RH, formula %.3f", (long)raw,
+                  (long)dev.RawHumid, humid / 1024.0, ref);
+        }
+    }
+}
+
+static void testBme280Batch(void) {
+    enum { COUNT = 512 };
+    static int32_t rawT[COUNT], rawP[COUNT], rawH[COUNT], temp[COUNT];
+    static uint32_t press[COUNT], humid[COUNT];
+    BME280Cal cal;
+    BME280 dev = {0};
+    unsigned round;
+    int32_t t;
+    uint32_t p, h;
+    unsigned k;
+
+    for(round = 0; round < 200; round++) { // coefficients spread around the data sheet's
+        cal = sheetCal;
+        cal.dig_T1 += testRandom(-2000, 2000);
+        cal.dig_T2 += testRandom(-1000, 1000);
+        cal.dig_T3 = -testRandom(0, 3000);
+        cal.dig_P1 += testRandom(-2000, 2000);
+        cal.dig_P2 += testRandom(-500, 500);
+        cal.dig_P4 += testRandom(-2000, 6000);
+        cal.dig_P5 = testRandom(-200, 200);
+        cal.dig_P8 += testRandom(-500, 500);
+        cal.dig_H1 = testRandom(0, 100);
+        cal.dig_H2 = testRandom(300, 420);
+        cal.dig_H3 = testRandom(0, 60);
+        cal.dig_H4 = testRandom(280, 360);
+        cal.dig_H5 = testRandom(0, 60);
+        cal.dig_H6 = testRandom(20, 40);
+        for(k = 0; k < COUNT; k++) {
+            rawT[k] = testRandom(380000, 640000);
+            rawP[k] = testRandom(250000, 550000);
+            rawH[k] = testRandom(0, 65535);
+        }
+        BME280CompensateBatch(&cal, rawT, rawP, rawH, temp, press, humid, COUNT);
+
+        dev.cal = &cal;
+        for(k = 0; k < COUNT; k++) {
+            dev.RawTemp = rawT[k];
+            dev.RawPress = rawP[k];
+            dev.RawHumid = rawH[k];
+            t = CalcTemp(&dev);
+            h = CalcHumid(&dev);
+            p = CalcPress(&dev);
+            CHECK(temp[k] == t && press[k] == p && humid[k] == h,
+                  "batch %ld %lu %lu, single %ld %lu %lu (raw %ld %ld %ld)", (long)temp[k], (unsigned long)press[k],
+                  (unsigned long)humid[k], (long)t, (unsigned long)p, (unsigned long)h, (long)rawT[k],
+                  (long)rawP[k], (long)rawH[k]);
+        }
+    }
+}
+
+static unsigned char bmeRegs[256]; // simulated BME280 register file
+static unsigned char bmeAddr;
+static unsigned char bmeWrite; // next byte of a write transaction is data
+static unsigned char bmeStarted; // address byte of this transaction seen
+
+static void bmeSet16(unsigned char addr, uint16_t value) { // little endian, like the compensation registers
+    bmeRegs[addr] = (unsigned char)value;
+    bmeRegs[addr + 1] = (unsigned char)(value >> 8);
+}
+
+static unsigned char bmeSpi(unsigned char csLow, unsigned char selected, unsigned char mosi) { // SimSpiFn
+    unsigned char miso = 0xFF;
+
+    if(!(csLow & TEST_CS)) {
+        return 0xFF;
+    }
+    if(selected & TEST_CS) {
+        bmeStarted = 0;
+    }
+    if(!bmeStarted || bmeWrite == 2) { // control byte: address, bit 7 set to read
+        bmeStarted = 1;
+        bmeAddr = mosi | 0x80;
+        bmeWrite = (mosi & 0x80) ? 0 : 1;
+    } else if(bmeWrite) { // register writes are address/value pairs
+        bmeRegs[bmeAddr] = mosi;
+        bmeWrite = 2;
+    } else {
+        miso = bmeRegs[bmeAddr++]; // burst read, auto increment
+    }
+    return miso;
+}
+
+static void testBme280Spi(void) {
+    static BME280Cal cal; // blank, like a fresh FRAM block
+    const int16_t pressCal[8] = {
+        sheetCal.dig_P2, sheetCal.dig_P3, sheetCal.dig_P4, sheetCal.dig_P5, sheetCal.dig_P6, sheetCal.dig_P7,
+        sheetCal.dig_P8, sheetCal.dig_P9
+    };
+    BME280 dev;
+    unsigned char idx;
+
+    bmeRegs[0xD0] = BME280_ID;
+    bmeSet16(0x88, sheetCal.dig_T1);
+    bmeSet16(0x8A, (uint16_t)sheetCal.dig_T2);
+    bmeSet16(0x8C, (uint16_t)sheetCal.dig_T3);
+    bmeSet16(0x8E, sheetCal.dig_P1);
+    for(idx = 0; idx < 8; idx++) {
+        bmeSet16(0x90 + 2 * idx, (uint16_t)pressCal[idx]);
+    }
+    bmeRegs[0xA1] = sheetCal.dig_H1;
+    bmeSet16(0xE1, (uint16_t)sheetCal.dig_H2);
+    bmeRegs[0xE3] = sheetCal.dig_H3;
+    bmeRegs[0xE4] = (unsigned char)(sheetCal.dig_H4 >> 4);
+    bmeRegs[0xE5] = (unsigned char)((sheetCal.dig_H4 & 0x0F) | (sheetCal.dig_H5 << 4));
+    bmeRegs[0xE6] = (unsigned char)(sheetCal.dig_H5 >> 4);
+    bmeRegs[0xE7] = (unsigned char)sheetCal.dig_H6;
+    bmeRegs[0xF7] = (unsigned char)(SHEET_RAW_P >> 12); // 20-bit readings, MSB first, left aligned
+    bmeRegs[0xF8] = (unsigned char)(SHEET_RAW_P >> 4);
+    bmeRegs[0xF9] = (unsigned char)(SHEET_RAW_P << 4);
+    bmeRegs[0xFA] = (unsigned char)(SHEET_RAW_T >> 12);
+    bmeRegs[0xFB] = (unsigned char)(SHEET_RAW_T >> 4);
+    bmeRegs[0xFC] = (unsigned char)(SHEET_RAW_T << 4);
+    bmeRegs[0xFD] = 0x6A;
+    bmeRegs[0xFE] = 0x5C;
+
+    simInit();
+    simSetSpi(bmeSpi);
+    spiInit(CLOCK_SMCLK_HZ);
+
+    CHECK(BME280Init(&dev, TEST_CS, &cal, &BME280Indoor), "no BME280 found on the simulated bus");
+    CHECK(cal.magic == BME280_CAL_MAGIC && cal.cs == TEST_CS, "calibration block not marked as read");
+    CHECK(cal.dig_T1 == sheetCal.dig_T1 && cal.dig_T2 == sheetCal.dig_T2 && cal.dig_T3 == sheetCal.dig_T3,
+          "dig_T %u %d %d", cal.dig_T1, cal.dig_T2, cal.dig_T3);
+    CHECK(cal.dig_P1 == sheetCal.dig_P1 && cal.dig_P2 == sheetCal.dig_P2 && cal.dig_P3 == sheetCal.dig_P3 &&
+          cal.dig_P4 == sheetCal.dig_P4 && cal.dig_P5 == sheetCal.dig_P5 && cal.dig_P6 == sheetCal.dig_P6 &&
+          cal.dig_P7 == sheetCal.dig_P7 && cal.dig_P8 == sheetCal.dig_P8 && cal.dig_P9 == sheetCal.dig_P9,
+          "dig_P %u %d %d %d %d %d %d %d %d", cal.dig_P1, cal.dig_P2, cal.dig_P3, cal.dig_P4, cal.dig_P5,
+          cal.dig_P6, cal.dig_P7, cal.dig_P8, cal.dig_P9);
+    CHECK(cal.dig_H1 == sheetCal.dig_H1 && cal.dig_H2 == sheetCal.dig_H2 && cal.dig_H3 == sheetCal.dig_H3 &&
+          cal.dig_H4 == sheetCal.dig_H4 && cal.dig_H5 == sheetCal.dig_H5 && cal.dig_H6 == sheetCal.dig_H6,
+          "dig_H %u %d %u %d %d %d", cal.dig_H1, cal.dig_H2, cal.dig_H3, cal.dig_H4, cal.dig_H5, cal.dig_H6);
+    CHECK(bmeRegs[0xF2] == BME280Indoor.ctrlHum && bmeRegs[0xF4] == BME280Indoor.ctrlMeas &&
+          bmeRegs[0xF5] == BME280Indoor.config, "profile registers %02X %02X %02X", bmeRegs[0xF2], bmeRegs[0xF4],
+          bmeRegs[0xF5]);
+
+    ReadTHsensor(&dev);
+    CHECK(dev.RawTemp == SHEET_RAW_T && dev.RawPress == SHEET_RAW_P && dev.RawHumid == 0x6A5C,
+          "raw readings %ld %ld %ld", (long)dev.RawTemp, (long)dev.RawPress, (long)dev.RawHumid);
+    CHECK(CalcTemp(&dev) == SHEET_T, "temperature over SPI %ld", (long)CalcTemp(&dev));
+}
+
+int main(void) {
+    srand(22);
+    testTempSense();
+    testFormat();
+    testBme280Sheet();
+    testBme280Batch();
+    testBme280Spi();
+    return checkDone("test_sensor");
+}
@@ -0,0 +1,152 @@
+/*
+ test_servo.c
+ Eight hatches told to move at once: no more than SERVO_MAX_MOVING servos change position in any PWM period,
+ waiting moves start in channel order, every servo reaches its target, and once the last one has arrived the
+ PWM timers are halted with all outputs low and SMCLK_SERVO is released.
+
+ Then the latency from a zone crossing its threshold to its hatch servo's PWM pulse reaching the open position,
+ in control ticks, for several travel distances: it has to follow the trapezoidal profile, and while the hatch
+ moves the control loop still gets every tick on time, however far it has to go.
+ */
+
+#include <math.h>
+
+#include "check.h"
+#include "datalog.h"
+#include "filter.h"
+#include "hal.h"
+#include "scheduler.h"
+#include "servo.h"
+#include "sim.h"
+#include "zone.h"
+
+#define TEST_PERIOD (SERVO_PERIOD_US * SIM_US)
+#define TEST_TICK ((TICK_PERIOD + 1ULL) * SIM_S / ACLK_HZ)
+#define TEST_TRAVELS 5
+
+static SimTime now;
+
+static void moveAll(unsigned short target) {
+    unsigned short last[SERVO_CHANNELS];
+    unsigned char channel, moving, most = 0, waiting, busy;
+
+    for(channel = 0; channel < SERVO_CHANNELS; channel++) {
+        last[channel] = servoPosition(channel);
+        servoMoveTo(channel, target, &servoHatchProfile);
+    }
+
+    do {
+        now += TEST_PERIOD;
+        simRun(now, 0);
+        moving = waiting = busy = 0;
+        for(channel = 0; channel < SERVO_CHANNELS; channel++) {
+            if(servoPosition(channel) != last[channel]) {
+                moving++;
+                CHECK(!waiting, "channel %u moves while a lower channel waits (%02X waiting)", channel, waiting);
+            } else if(servoBusy(channel)) {
+                waiting |= 1 << channel;
+            }
+            busy |= servoBusy(channel);
+            last[channel] = servoPosition(channel);
+        }
+        CHECK(moving <= SERVO_MAX_MOVING, "%u servos moving at %llu ms", moving, (unsigned long long)(now / SIM_MS));
+        most = moving > most ? moving : most;
+    } while(busy && now < 120 * SIM_S);
+
+    CHECK(!busy, "servos still busy after 120 s");
+    CHECK(most == SERVO_MAX_MOVING, "at most %u servos moved at once, %u allowed", most, SERVO_MAX_MOVING);
+    for(channel = 0; channel < SERVO_CHANNELS; channel++) {
+        CHECK(servoPosition(channel) == target, "channel %u at %u, target %u", channel, servoPosition(channel), target);
+    }
+
+    now += 3 * TEST_PERIOD; // the parking pulse, then the timers stop
+    simRun(now, 0);
+    CHECK(!simPwmRunning(), "PWM timers still running after the last move");
+    CHECK(!(schedSmclkUsers & SMCLK_SERVO), "SMCLK_SERVO not released");
+    CHECK(simStats()->pwmHeldHigh == 0, "%llu outputs held high", (unsigned long long)simStats()->pwmHeldHigh);
+}
+
+static double travelPeriods(unsigned short counts) { // PWM periods of the ideal trapezoid, the engine steps and creeps
+    double accel = servoHatchProfile.accel, top = servoHatchProfile.maxSpeed;
+    double ramp = top * top / accel; // counts to get up to speed and back down
+
+    if(counts >= ramp) {
+        return 2.0 * top / accel + (counts - ramp) / top;
+    }
+    return 2.0 * sqrt(counts / accel);
+}
+
+static unsigned short openUs; // pulse width of the open hatch, as simPwmPulseUs() gives it
+static unsigned char opened; // hatch commanded open
+static SimTime reachedAt; // first pulse at the open position
+
+static void watchPwm(void) { // every millisecond
+    if(opened && reachedAt == 0 && simPwmPulseUs(zoneConfig[0].servo) == openUs) {
+        reachedAt = simNow();
+    }
+}
+
+static void testLatency(void) {
+    static const unsigned short travels[TEST_TRAVELS] = {SERVO_COUNTS(50), SERVO_COUNTS(250), SERVO_COUNTS(500),
+                                                         SERVO_COUNTS(1000), SERVO_OPEN_POS - SERVO_CLOSED_POS};
+    unsigned char idx;
+    unsigned short ticks;
+    SimTime crossedAt, lastTick, late, took, expect, lastTook = 0;
+
+    openUs = (unsigned short)((uint64_t)SERVO_OPEN_POS * SERVO_TIMER_DIV * SIM_S / CLOCK_SMCLK_HZ / SIM_US);
+    for(idx = 0; idx < TEST_TRAVELS; idx++) {
+        simInit();
+        logInit();
+        zoneInit();
+        schedInit();
+        zones[0].thres = 1200;
+        servoSetPosition(zoneConfig[0].servo, SERVO_OPEN_POS - travels[idx]); // where a move cut short left it
+        simTimer(SIM_MS, SIM_MS, watchPwm);
+
+        ticks = 0;
+        opened = 0;
+        crossedAt = reachedAt = late = 0;
+        lastTick = simNow();
+        while((reachedAt == 0 || simNow() < reachedAt) && ticks < 120) {
+            if(!(schedWait() & EVENT_TICK)) {
+                continue;
+            }
+            ticks++;
+            if(simNow() - lastTick > TEST_TICK + late) {
+                late = simNow() - lastTick - TEST_TICK; // a tick handled after the next one was due
+            }
+            lastTick = simNow();
+            zoneUpdate(0, ticks < 10 ? 1100 : 1400); // wet, then dry
+            if(crossedAt == 0 && zones[0].moisture > zones[0].thres + moistureFilterConfig.hysteresis) {
+                crossedAt = simNow();
+                CHECK(zones[0].valveOpen, "travel %u: hatch not commanded in the control cycle that crossed",
+                      travels[idx]);
+            }
+            opened = zones[0].valveOpen;
+        }
+
+        took = reachedAt - crossedAt;
+        expect = (SimTime)(travelPeriods(travels[idx]) * TEST_PERIOD);
+        printf("travel %4u counts: PWM at the target %.2f ticks after the threshold crossing, %.2f expected\n",
+               travels[idx], (double)took / TEST_TICK, (double)expect / TEST_TICK);
+        CHECK(crossedAt != 0 && reachedAt > crossedAt, "travel %u: crossed at %llu ms, at the target at %llu ms",
+              travels[idx], (unsigned long long)(crossedAt / SIM_MS), (unsigned long long)(reachedAt / SIM_MS));
+        CHECK(took + TEST_PERIOD >= expect * 9 / 10 && took <= expect * 13 / 10 + 2 * TEST_PERIOD, // stepped ramps
+              "travel %u: %llu ms from the crossing to the target, the profile takes %llu ms", travels[idx],
+              (unsigned long long)(took / SIM_MS), (unsigned long long)(expect / SIM_MS));
+        CHECK(took > lastTook, "travel %u: %llu ms, no longer than the shorter travel before", travels[idx],
+              (unsigned long long)(took / SIM_MS));
+        CHECK(late == 0, "travel %u: a tick handled %llu us late while the hatch moved", travels[idx],
+              (unsigned long long)(late / SIM_US));
+        lastTook = took;
+    }
+}
+
+int main(void) {
+    simInit();
+    servoInit(0xFF);
+    moveAll(SERVO_OPEN_POS);
+    moveAll(SERVO_CLOSED_POS);
+    testLatency();
+    return checkDone("test_servo");
+}
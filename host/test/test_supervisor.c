@@ -0,0 +1,176 @@
+/*
+ test_supervisor.c
+ The supervisor against injected faults: the whole firmware (main.c as firmwareMain, like watersim) waters the
+ simulated plant until a hatch is open in the middle of a dose, then the ADC stops finishing its conversions,
+ and an hour after that restart Timer_B0 stops ticking. Each time the watchdog has to reset the node within
+ its timeout, and the warm restart has to carry on from FRAM: the reset counted and logged, the learned dose
+ gain and lag of every zone back from the checkpoint, the open hatch closed and logged, and the reservoir count
+ where it was. The zones in RAM are scribbled over at the reset, so what they learned can only come back from the
+ checkpoint; the other modules' RAM is set up again by their init functions.
+ */
+
+#include <setjmp.h>
+#include <string.h>
+
+#include "check.h"
+#include "datalog.h"
+#include "gateway.h"
+#include "hal.h"
+#include "plant.h"
+#include "reservoir.h"
+#include "sample.h"
+#include "sim.h"
+#include "supervisor.h"
+#include "zone.h"
+
+#define TEST_FAULTS 2
+#define TEST_WDT_NS (SUP_WDT_COUNTS * SIM_S / 10000) // at the typical VLO
+#define TEST_RESET_MAX ((SAMPLE_MAX_CYCLES + 1) * SIM_S + TEST_WDT_NS) // next conversion started, then the timeout
+
+void firmwareMain(void);
+
+extern LogBlock logBlocks[LOG_BLOCKS];
+
+static const unsigned char faults[TEST_FAULTS] = {SIM_STALL_ADC, SIM_STALL_TICK};
+static const char *const faultNames[TEST_FAULTS] = {"ADC stall", "tick stall"};
+
+static jmp_buf restart;
+static jmp_buf finish;
+
+static unsigned char faultIdx; // next fault to inject
+static unsigned char stalled; // faults[faultIdx] injected, waiting for the watchdog
+static SimTime faultAt; // when it was injected, or the earliest time for the next one
+static short initGain; // zone 0 before anything was learned
+static short gain[ZONE_COUNT]; // learned when the fault was injected
+static unsigned short lag[ZONE_COUNT];
+static char valveOpen; // zone 0 at the ADC stall
+static unsigned short resets;
+static unsigned short dispensed; // reservoir count at the reset
+static unsigned short hoursLeft;
+
+static unsigned resetsLogged; // LOG_RESET entries with the watchdog as the cause
+static unsigned closesLogged; // zone 0 closed right after one of them
+static unsigned samplesAfter; // samples logged after the last one
+static unsigned char lastType;
+static unsigned short lastValue;
+
+static void stop(void) {
+    longjmp(finish, 1);
+}
+
+static void injectFault(void) { // every second
+    const Plant *plant = plantState();
+    unsigned char zone;
+
+    if(faultIdx == 0 && initGain == 0) {
+        initGain = zones[0].dose.gain;
+    }
+    if(stalled || faultIdx >= TEST_FAULTS || simNow() < faultAt) {
+        return;
+    }
+    if(faultIdx == 0 && (plant->zones[0].openings < 2 || !zones[0].valveOpen)) {
+        return; // the first dose has settled and the second one is pouring
+    }
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        gain[zone] = zones[zone].dose.gain;
+        lag[zone] = zones[zone].dose.lag;
+    }
+    if(faultIdx == 0) {
+        valveOpen = zones[0].valveOpen;
+    }
+    resets = supResetCount();
+    stalled = 1;
+    faultAt = simNow();
+    simStall(faults[faultIdx]);
+}
+
+static void checkRestart(void) { // right after the firmware's init, before the first tick
+    unsigned char zone;
+    const char *name = faultNames[faultIdx];
+
+    CHECK(supResetCount() == resets + 1, "%s: %u resets counted, %u before", name, supResetCount(), resets);
+    CHECK(supResetCause() == SYSRSTIV_WDTTO, "%s: reset cause %04X", name, supResetCause());
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        CHECK(zones[zone].dose.gain == gain[zone] && zones[zone].dose.lag == lag[zone],
+              "%s: zone %u restarted with gain %d lag %u, learned %d %u", name, zone, zones[zone].dose.gain,
+              zones[zone].dose.lag, gain[zone], lag[zone]);
+        CHECK(zones[zone].valveOpen == 0 && zones[zone].dose.state == DOSE_IDLE,
+              "%s: zone %u restarted open %d in dose state %u", name, zone, zones[zone].valveOpen,
+              zones[zone].dose.state);
+    }
+    CHECK(resDispensed() == dispensed && resHoursLeft() == hoursLeft,
+          "%s: reservoir at %u mL, %u h left after the reset, %u mL, %u h before", name, resDispensed(),
+          resHoursLeft(), dispensed, hoursLeft);
+
+    stalled = 0;
+    faultAt = simNow() + SIM_HOUR;
+    if(++faultIdx == TEST_FAULTS) {
+        simSetStop(faultAt, stop); // an hour to show the node runs on
+    }
+}
+
+static void watchdogReset(void) { // SimFn, the peripherals are in their power-up state
+    const char *name = faultNames[faultIdx];
+
+    CHECK(stalled, "watchdog reset at %.1f s without a fault", (double)simNow() / SIM_S);
+    CHECK(simNow() > faultAt && simNow() - faultAt <= TEST_RESET_MAX, "%s: reset %.1f s after the fault", name,
+          (double)(simNow() - faultAt) / SIM_S);
+    simStall(0);
+    dispensed = resDispensed();
+    hoursLeft = resHoursLeft();
+    memset(zones, 0xA5, sizeof zones); // RAM does not survive a reset, FRAM does
+    simTimer(simNow(), 0, checkRestart);
+    longjmp(restart, 1);
+}
+
+static void logEntry(unsigned char type, unsigned short moisture, short temp, unsigned short value) { // LogEntryFn
+    (void)moisture;
+    (void)temp;
+    if(type == LOG_RESET && value == SYSRSTIV_WDTTO) {
+        resetsLogged++;
+        samplesAfter = 0;
+    } else if(type == LOG_VALVE && value == 0 && lastType == LOG_RESET && lastValue == SYSRSTIV_WDTTO) {
+        closesLogged++;
+    } else if(type == LOG_SAMPLE && value == 0) {
+        samplesAfter++;
+    }
+    lastType = type;
+    lastValue = value;
+}
+
+int main(void) {
+    GatewayConfig gateway = {5 * SIM_MS, 0, 0, 0, 0};
+    unsigned char idx;
+
+    simInit();
+    plantInit(1);
+    gatewayInit(&gateway);
+    simSetAdc(plantAdc);
+    simSetUartTx(gatewayByte);
+    simSetReset(watchdogReset);
+    simTimer(PLANT_STEP, PLANT_STEP, plantStep);
+    simTimer(SIM_S, SIM_S, injectFault);
+    simSetStop(3 * SIM_DAY, stop); // moved to an hour after the last fault
+
+    if(setjmp(finish) == 0) {
+        setjmp(restart); // every reset comes back here
+        firmwareMain(); // returns through stop()
+    }
+
+    CHECK(faultIdx == TEST_FAULTS, "%u of %u faults injected and recovered from by %.1f h", faultIdx, TEST_FAULTS,
+          (double)simNow() / SIM_HOUR);
+    CHECK(gain[0] != initGain, "zone 0 learned nothing before the first fault, gain %d", gain[0]);
+    CHECK(valveOpen, "zone 0 was not pouring when the ADC stalled");
+    CHECK(simStats()->watchdogResets == TEST_FAULTS, "%llu watchdog resets, %u faults",
+          (unsigned long long)simStats()->watchdogResets, TEST_FAULTS);
+
+    for(idx = 0; idx < LOG_BLOCKS; idx++) { // the log has not wrapped, blocks are in order
+        if(logBlocks[idx].magic == LOG_MAGIC) {
+            logDecodeBlock(&logBlocks[idx], logEntry);
+        }
+    }
+    CHECK(resetsLogged == TEST_FAULTS, "%u watchdog resets logged", resetsLogged);
+    CHECK(closesLogged >= 1, "the hatch open at the ADC stall was not closed after the reset");
+    CHECK(samplesAfter > 0, "nothing logged in the hour after the last reset");
+    return checkDone("test_supervisor");
+}
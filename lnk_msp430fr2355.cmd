@@ -123,6 +123,13 @@ MEMORY
 /* SPECIFY THE SECTIONS ALLOCATION INTO MEMORY                              */
 /****************************************************************************/
 
+/* #pragma PERSISTENT variables go in .TI.persistent. Their initial values  */
+/* are written when the program is loaded, not by the C startup code, so    */
+/* they keep their contents across resets and power cycles and only start   */
+/* over on a new download. Thresholds, zone checkpoints, reservoir          */
+/* counters, reset statistics and the node ID live there; writes need no    */
+/* unlocking, the group is below fram_rx_start.                             */
+
 SECTIONS
 {
     GROUP(ALL_FRAM)
@@ -130,6 +137,7 @@ SECTIONS
         GROUP(READ_WRITE_MEMORY)
         {
             .TI.persistent : {}              /* For #pragma persistent            */
+            .datalog       : {} type = NOINIT /* FRAM sensor log, kept across resets */
             .cio           : {}              /* C I/O Buffer                      */
             .sysmem        : {}              /* Dynamic memory allocation area    */
         } PALIGN(0x0400), RUN_START(fram_rw_start) RUN_END(fram_rx_start)
@@ -1,214 +1,175 @@
-#include <msp430.h>
+#include "adc.h"
+#include "button.h"
+#include "clock.h"
+#include "datalog.h"
+#include "hal.h"
+#include "prof.h"
+#include "protocol.h"
+#include "reservoir.h"
+#include "sample.h"
+#include "scheduler.h"
+#include "servo.h"
+#include "supervisor.h"
+#include "telemetry.h"
+#include "tempsense.h"
+#include "uart.h"
+#include "zone.h"
 
-#define MOISTURE_STR_LEN 4 // number of digits of moisture value to be sent through UART
-#define WATER_OPEN_THRES 100 // a count of how many while loops can occur with the water hatch is open before the water runs out
 #define TEMP_THRES 30 // the threshold temperature in celsius where it is too hot for a plant
-#define CALADC_15V_30C *((unsigned int *)0x1A1A) // Temperature Sensor Calibration-30C //6682 // See device datasheet for TLV table memory mapping
-#define CALADC_15V_85C *((unsigned int *)0x1A1C) // Temperature Sensor Calibration-High Temperature (85 for Industrial, 105 for Extended)
-
-
-char moistureStr[MOISTURE_STR_LEN];
-char waterOpen = 0x00; // 0 for closed, 1 for opened
-
-void gpioInit();
-void adcInit();
-void adcTempInit();
-void adcMoistureInit();
-void timerInit();
-void uartInit();
-void rotateServo();
-void shortToCharArr(unsigned short num);
 
 void main(void) {
-    WDTCTL = WDTPW | WDTHOLD; // stop watchdog timer
-    PM5CTL0 &= ~LOCKLPM5; // disable the GPIO power-on default high-impedance mode
-
-    unsigned char strIdx;
-    unsigned char waterOpenCount = 0;
-    unsigned short moisture;
-    unsigned short moistureThres = 1200; // 2400
-    volatile long temp;
-    volatile float calTemp;
-
-    gpioInit();
+    halWatchdogSet(WDTHOLD); // stop watchdog timer
+    clockInit(); // 24 MHz DCO, everything timed on SMCLK is derived from it
+    profInit(); // profiling timer, before any interrupt handler can record
+
+    unsigned char events;
+    unsigned char button;
+    unsigned char request;
+    unsigned char sampleIdx;
+    unsigned char zone;
+    const volatile AdcSample *samples;
+    unsigned long moistureSum;
+    unsigned short moisture[ZONE_COUNT]; // averaged probe readings of this cycle, then the filtered ones for the log
+    unsigned short cycles; // control cycles since the last sample
+    unsigned long tempSum;
+    short calTemp; // tenths of a degree celsius
+
+    halGpioInit(); // buttons and LEDs, then the pins leave their power-on high-impedance state
     adcInit();
-    timerInit();
+    tempLutInit(); // build the temperature table from the TLV calibration values
+    logInit(); // continue the FRAM log from before the reset
+    supInit(); // log why the last reset happened
+    zoneInit(); // filters, dose controllers and servos of every zone, closes hatches left open by a reset
     uartInit();
-
-    _delay_cycles(5); // Wait for ADC ref to settle
+    protoInit();
+    schedInit();
+    buttonInit();
+    sampleInit();
+    supStart(); // watchdog from here on, serviced once per complete control cycle
 
     while(1){
 
-        // send ';' to end last sent value
-        _delay_cycles(20000);
-        while((UCA1IFG & UCTXIFG)==0); //Wait until the UART transmitter is ready //UCTXIFG
-        UCA1TXBUF = ';'; // transmit ';'
-
-        // read ADC for moisture level
-        adcMoistureInit(); // set ADC to A1 for reading moisture sensor
-        ADCCTL0 |= ADCENC | ADCSC; // sampling and conversion start
-        while((ADCCTL0 & ADCIFG) == 0); // check the ADC interrupt flag, while it's low, wait
-        _delay_cycles(200000);
-        moisture = ADCMEM0;
-        ADCCTL0 &= ~ADCIFG; // clear ADC interrupt flag
-
-        // change moisture threshold to current moisture if P2.3 button is pressed
-        if(!(P2IN & BIT3)) {
-                moistureThres = moisture;
-        }
-
-        // convert moisture to string and send over UART
-        shortToCharArr(moisture);
-        strIdx = 0;
-        while(strIdx < MOISTURE_STR_LEN) { // go from start of string to end of string
-            while((UCA1IFG & UCTXIFG)==0); // wait until the UART transmitter is ready //UCTXIFG
-            UCA1TXBUF = moistureStr[strIdx]; // transmit the character at strIdx in moistureStr
-            strIdx++; // go to next character in moistureStr
+        events = schedWait(); // sleep in LPM3 until an interrupt has something for us
+        supFeed(); // the last cycle ran through every stage
+
+        while((events & EVENT_BUTTON) && buttonRead(&button)) {
+            switch(button) {
+                case BUTTON_THRES | BUTTON_SHORT: // change moisture thresholds to the next moisture readings
+                    zoneThresNext();
+                    sampleNow(); // don't make the user wait for a long interval
+                    break;
+                case BUTTON_THRES | BUTTON_LONG: // keep the current thresholds across resets
+                    zoneThresSave();
+                    break;
+                case BUTTON_THRES | BUTTON_DOUBLE: // pots or soil changed, learn their response to water again
+                    zoneRelearn();
+                    sampleNow();
+                    break;
+                case BUTTON_REFILL | BUTTON_SHORT: // water has been replaced
+                    logRefill(resDispensed() / 10); // record how much had been used, in 10 mL
+                    resRefill(); // start the volume count over
+                    halLedRed(0); // turn off P1.0 red LED
+                    break;
+                default:
+                    break;
+            }
         }
 
-        // check current moisture to open or close water
-        if(moisture > moistureThres) { // lower values is more moist, so a current ADC reading above threshold is too dry
-            if(!waterOpen) { // if water is not already open
-                rotateServo(); // open
+        // ACKs free the protocol window, and the gateway asks for the FRAM log once its link is back up
+        if(events & EVENT_UART_RX) {
+            request = protoReceive();
+            if(request == PROTO_REPLAY && !logReplaying()) {
+                logReplayStart();
+            } else if(request == PROTO_PROFILE && !profDumping()) {
+                profDumpStart(); // cycle statistics since the last dump
             }
-            waterOpenCount++; // increment water open count to keep track of water level
-        } else if(waterOpen) { // if water is open but moisture is below threshold
-            rotateServo(); // close
         }
 
-        // if waterOpenCount is above threshold, water is probably empty
-        if(waterOpenCount > WATER_OPEN_THRES) {
-            P1OUT |= BIT0; // turn on P1.0 red LED
+        // keep a log replay or profile dump going as ACKs come back
+        if((events & (EVENT_UART_RX | EVENT_UART_TX)) && logReplaying()) {
+            clockFast(); // frames and CRCs of a whole window
+            PROF_START(PROF_REPLAY);
+            logReplayStep();
+            PROF_END(PROF_REPLAY);
         }
-
-        // if P4.1 button pressed, water has been replaced
-        if(!(P4IN & BIT1)) {
-            waterOpenCount = 0; // reset how long water hatch has been opened
-            P1OUT &= ~BIT0; // turn off P1.0 red LED
+        if((events & (EVENT_UART_RX | EVENT_UART_TX)) && profDumping()) {
+            profDumpStep();
         }
 
-        // read temperature
-        adcTempInit(); // set ADC to A12 for reading temperature senor
-        ADCCTL0 |= ADCENC | ADCSC; // sampling and conversion start
-        while((ADCCTL0 & ADCIFG) == 0); // check the flag, while its low just wait
-        _delay_cycles(200000);
-        temp = ADCMEM0;
-        ADCCTL0 &= ~ADCIFG;
-        calTemp = (temp-CALADC_15V_30C)*(85-30)/(CALADC_15V_85C-CALADC_15V_30C)+30; // convert raw ADC value into celsius
-
-        // turn off green LED if temperature is too high
-        if(calTemp > TEMP_THRES) { // if current temperature is greater than threshold
-            P6OUT &= ~BIT6; // turn off P6.6 green LED
-        } else if(!(P6OUT & BIT6)) { // if P6.6 is 0 and temperature is less than threshold
-            P6OUT |= BIT6; // turn on P6.6 green LED
+        // start of a control cycle, oversample every probe and the temperature in one ADC sequence when a sample is due
+        if(events & EVENT_TICK) {
+            PROF_END(PROF_TICK_LATENCY);
+            PROF_START(PROF_TICK);
+            resTick(zoneOpenCount()); // account for the water poured this tick
+            if(sampleTick()) {
+                adcStartSequence(); // ADC interrupt wakes us when half of the ring is full
+            } else if(!adcBusy()) { // nothing due this cycle, a hung sequence still starves the watchdog
+                supCheckin(SUP_STAGE_ADC | SUP_STAGE_CONTROL);
+            }
+            protoTick(); // resend frames the gateway has not acknowledged
+            PROF_END(PROF_TICK);
+            supCheckin(SUP_STAGE_TICK);
         }
 
-    }
-}
-
-void gpioInit(){
-
-    // moisture sensor, P1.1
-    P1DIR |= BIT1;
-    P1OUT |= BIT1;
-    P1SEL0 |= BIT1; // ADC A1
-    P1SEL1 |= BIT1; // ADC A1
-
-    // button, P2.3
-    P2DIR &= ~BIT3; // set P2.3 to input
-    P2REN |= BIT3; // enable P2.3 resistor
-    P2OUT |= BIT3; // set P2.3 resistor to pull-up
-    P2IES |= BIT3; // P2.3 High -> Low edge
-
-    // button, P4.1
-    P4DIR &= ~BIT1; // set P4.1 to input
-    P4REN |= BIT1; // enable P4.1 resistor
-    P4OUT |= BIT1; // set P4.1 resistor to pull-up
-    P4IES |= BIT1; // P4.1 High -> Low edge
-
-    // servo, P6.3
-    P6OUT &= ~BIT3; // reset P6.3 output
-    P6DIR |= BIT3; // set P6.3 to output
-    P6SEL0 |= BIT3; // PWM mode for P6.3
-    P6SEL1 &= ~BIT3; // PWM mode for P6.3
-
-    // red LED, P1.0
-    P1OUT &= ~BIT0; // Clear P1.0 output latch for a defined power-on state
-    P1DIR |= BIT0; // Set P1.0 to output direction
-
-    // green LED, P6.6
-    P6OUT |= BIT6; // start P6.6 on
-    P6DIR |= BIT6; // Set P6.6 to output direction
-
-}
-
-void adcInit() {
-    ADCCTL0 |= ADCSHT_8 | ADCON; // ADC ON, sample period>30us
-    ADCCTL1 |= ADCSHP;  // software trigger, single channel conversion, MODOSC
-    ADCCTL2 &= ~ADCRES;  // clear ADCRES in ADCCTL
-    ADCCTL2 |= ADCRES_2;  // 12-bit conversion results
-    ADCIE |= ADCIE0; // enable the interrupt request for a completed ADC_B conversion
-}
-
-void adcTempInit() {
-    ADCMCTL0 = ADCSREF_1 | ADCINCH_12; // ADC input ch A12 => temp sense
-
-    // Configure reference
-    PMMCTL0_H = PMMPW_H; // unlock the PMM registers
-    PMMCTL2 |= INTREFEN | TSENSOREN; // enable internal reference and temperature sensor
-    __delay_cycles(400);  // delay for reference settling
-}
-
-void adcMoistureInit() {
-    ADCMCTL0 = ADCINCH_1;  // A1 ADC input select; Vref=AVCC
-}
-
-void timerInit() { // timer B3 for servo PWM
-    TB3CCR0 = 23260-1; // PWM period
-    TB3CTL = TBSSEL_2 | MC_1; // SMCLK, up mode
-    TB3CCTL4 = OUTMOD_7; // CCR4 reset/set
-}
-
-void uartInit() {
+        if(!(events & (EVENT_ADC_HALF | EVENT_ADC_FULL))) {
+            continue;
+        }
 
-    // configure UART pins
-    P4SEL0 |= BIT2 | BIT3; // set 2-UART pin as second function
-    P4SEL1 &= ~BIT2; // set 2-UART pin as second function
-    P4SEL1 &= ~ BIT3; // set 2-UART pin as second function
+        // average the half of the ring that just finished, then filter and water each zone
+        PROF_END(PROF_ADC_LATENCY);
+        clockFast(); // the burst of work of the control cycle, back to slow in schedWait()
+        PROF_START(PROF_AVERAGE);
+        samples = adcReadyHalf(events);
+        for(zone = 0; zone < ZONE_COUNT; zone++) {
+            moistureSum = 0;
+            for(sampleIdx = 0; sampleIdx < ADC_HALF_LEN; sampleIdx++) {
+                moistureSum += samples[sampleIdx].moisture[zone];
+            }
+            moisture[zone] = moistureSum >> ADC_HALF_SHIFT; // oversampled and decimated
+        }
+        tempSum = 0;
+        for(sampleIdx = 0; sampleIdx < ADC_HALF_LEN; sampleIdx++) {
+            tempSum += samples[sampleIdx].temp;
+        }
+        PROF_END(PROF_AVERAGE);
+        supCheckin(SUP_STAGE_ADC);
 
-    // configure eUSCI_A1 for UART
-    UCA1CTLW0 |= UCSWRST;
-    UCA1CTLW0 |= UCSSEL__SMCLK;
-    UCA1BRW = 8; // 115200
-    UCA1MCTLW = 0xD600;
-    UCA1CTLW0 &= ~UCSWRST; // Initialize eUSCI
-    UCA1IE |= UCRXIE; // Enable USCI_A0 RX interrupt
+        PROF_START(PROF_CONTROL);
+        for(zone = 0; zone < ZONE_COUNT; zone++) {
+            zoneUpdate(zone, moisture[zone]);
+        }
+        cycles = sampleAdapt(); // next sampling interval from how this sample compares to the last
+        PROF_END(PROF_CONTROL);
 
-}
+        PROF_START(PROF_REPORT);
 
-void rotateServo() {
-    if(TB3CCR4 > 2000) { // servo is to the right, rotate servo CCW
-        for(TB3CCR4 = 2600; TB3CCR4 > 550; TB3CCR4--) { // rotate servo CCW, less than 180 degrees because the motor gets stuck
-                _delay_cycles(500); // speed of rotation
+        // if the estimated level is low, water is probably empty
+        if(resLevel() < RES_LOW_PERCENT) {
+            halLedRed(1); // turn on P1.0 red LED
         }
-    } else { // servo is to the left, rotate servo CW
-        for(TB3CCR4 = 350; TB3CCR4 < 2600; TB3CCR4++) { // rotate servo 190 degrees CW
-            _delay_cycles(500); // speed of rotation
-        }
-    }
-    waterOpen ^= 0x01; // toggle water open
 
-}
+        // read temperature
+        calTemp = tempFromAdc(tempSum >> ADC_HALF_SHIFT); // convert raw ADC value into tenths of a degree celsius
 
-void shortToCharArr(unsigned short num) {
+        // turn off green LED if temperature is too high
+        if(calTemp > TEMP_THRES * 10) { // if current temperature is greater than threshold
+            halLedGreen(0); // turn off P6.6 green LED
+        } else if(!halLedGreenIsOn()) { // if P6.6 is 0 and temperature is less than threshold
+            halLedGreen(1); // turn on P6.6 green LED
+        }
 
-    static char chars[] = "0123456789abcdefghijklmnopqrstuvwxyz";
-    unsigned char strIdx = MOISTURE_STR_LEN;
+        // keep history of every zone in FRAM in case the Wi-Fi link is down
+        for(zone = 0; zone < ZONE_COUNT; zone++) {
+            moisture[zone] = zones[zone].moisture; // filtered now, the averaged readings have been used
+        }
+        logSample(moisture, ZONE_COUNT, calTemp, cycles);
 
-    do { // goes from end of moistureStr to beginning
-        strIdx--;
-        moistureStr[strIdx] = chars[num%10]; // convert least significant digit in num to its ASCII value
-        num/=10; // integer divide num by 10
-    } while(strIdx > 0);
+        // queue this cycle's records, a frame is sent to the ESP-01 once a batch is full
+        for(zone = 0; zone < ZONE_COUNT; zone++) {
+            telemetryAdd(zone, zones[zone].moisture, calTemp, zones[zone].valveOpen, resLevel(), resHoursLeft(), cycles);
+        }
+        PROF_END(PROF_REPORT);
+        supCheckin(SUP_STAGE_CONTROL);
 
+    }
 }
@@ -0,0 +1,124 @@
+#include "hal.h"
+#include "prof.h"
+#include "protocol.h"
+
+typedef struct {
+    unsigned short min;
+    unsigned short max;
+    unsigned long sum;
+    unsigned short count;
+    unsigned short hist[PROF_BUCKETS];
+} ProfStage;
+
+volatile unsigned short profStart[PROF_STAGES];
+
+const unsigned short profBudget[PROF_STAGES] = {
+    PROF_BUDGET_US(500), // PROF_TICK
+    PROF_BUDGET_US(500), // PROF_AVERAGE, every zone's half of the ring
+    PROF_BUDGET_US(1000), // PROF_CONTROL
+    PROF_BUDGET_US(2000), // PROF_REPORT, FRAM log and a telemetry frame
+    PROF_BUDGET_US(5000), // PROF_REPLAY, a protocol window of log chunks
+    PROF_BUDGET_US(1000), // PROF_TICK_LATENCY
+    PROF_BUDGET_US(1000), // PROF_ADC_LATENCY
+    PROF_BUDGET_US(50), // PROF_ISR_ADC
+    PROF_BUDGET_US(50), // PROF_ISR_UART
+    PROF_BUDGET_US(100), // PROF_ISR_SERVO, every moving servo
+    PROF_BUDGET_US(50) // PROF_ISR_BUTTON
+};
+
+static ProfStage profStages[PROF_STAGES];
+static unsigned char profDumpNext = PROF_STAGES; // next stage to send, PROF_STAGES when not dumping
+
+static void profClear(ProfStage *stage) {
+    unsigned char bucket;
+
+    stage->min = 0xFFFF;
+    stage->max = 0;
+    stage->sum = 0;
+    stage->count = 0;
+    for(bucket = 0; bucket < PROF_BUCKETS; bucket++) {
+        stage->hist[bucket] = 0;
+    }
+}
+
+void profInit() { // after clockInit()
+    unsigned char stage;
+
+    for(stage = 0; stage < PROF_STAGES; stage++) {
+        profClear(&profStages[stage]);
+    }
+    halProfStart(); // Timer_B1 free running on SMCLK
+}
+
+void profRecord(unsigned char stage, unsigned short ticks) { // called from main() and from interrupts
+    ProfStage *s = &profStages[stage];
+    unsigned char bucket = 0;
+    unsigned short rest = ticks;
+
+    while(rest != 0 && bucket < PROF_BUCKETS - 1) { // bit length of ticks
+        rest >>= 1;
+        bucket++;
+    }
+
+    if(ticks < s->min) {
+        s->min = ticks;
+    }
+    if(ticks > s->max) {
+        s->max = ticks;
+    }
+    s->sum += ticks;
+    if(s->count < 0xFFFF) { // saturate, the sum is still right for the mean of a dump taken in time
+        s->count++;
+    }
+    if(s->hist[bucket] < 0xFFFF) {
+        s->hist[bucket]++;
+    }
+}
+
+void profDumpStart() {
+    profDumpNext = 0;
+    profDumpStep();
+}
+
+static unsigned char putShort(unsigned char *dest, unsigned short num) {
+    dest[0] = (unsigned char)num;
+    dest[1] = (unsigned char)(num >> 8);
+    return 2;
+}
+
+void profDumpStep() { // call when the protocol window frees up, sends as many stages as it takes
+    unsigned char frame[1 + 10 + 2 * PROF_BUCKETS];
+    ProfStage copy;
+    unsigned char len;
+    unsigned char bucket;
+    unsigned short state;
+
+    while(profDumpNext < PROF_STAGES) {
+        state = halIrqSave(); // interrupt handlers record into the table too
+        copy = profStages[profDumpNext];
+        halIrqRestore(state);
+
+        frame[0] = profDumpNext;
+        len = 1;
+        len += putShort(&frame[len], copy.count ? copy.min : 0);
+        len += putShort(&frame[len], copy.max);
+        len += putShort(&frame[len], (unsigned short)copy.sum);
+        len += putShort(&frame[len], (unsigned short)(copy.sum >> 16));
+        len += putShort(&frame[len], copy.count);
+        for(bucket = 0; bucket < PROF_BUCKETS; bucket++) {
+            len += putShort(&frame[len], copy.hist[bucket]);
+        }
+        if(!protoSend(PROTO_STATS, frame, len)) {
+            return; // window full, try again after the next ACK
+        }
+
+        state = halIrqSave();
+        profClear(&profStages[profDumpNext]); // records since the copy are lost, a dump is a sample
+        halIrqRestore(state);
+        profDumpNext++;
+    }
+}
+
+unsigned char profDumping() {
+    return profDumpNext < PROF_STAGES;
+}
@@ -0,0 +1,70 @@
+/*
+ prof.h
+ Cycle profiling of the control loop. Timer_B1 runs free on SMCLK, which keeps the same frequency in both
+ clock modes (clock.h), and PROF_START()/PROF_END() take the difference of two readings of it. Each stage keeps
+ its minimum, maximum, sum and count (the mean is sum / count, worked out by the gateway so the node never
+ divides) and a histogram of the durations in powers of two: bucket n counts durations of 2^(n-1) to 2^n - 1
+ ticks, the last bucket everything longer. Durations must stay under 2^16 ticks, about 21 ms.
+
+ Stages are either code in main(), an interrupt handler from entry to exit, or the latency of an event: from
+ the interrupt posting it (PROF_START in the ISR) to main() starting on it (PROF_END). SMCLK runs whenever the
+ CPU does, so every interval measured is counted in full even though the timer stops in LPM3.
+
+ The gateway asks for the table with PROTO_PROFILE and gets one PROTO_STATS frame per stage:
+
+    stage, min (2 bytes), max (2), sum (4), count (2), histogram (PROF_BUCKETS x 2), all little endian
+
+ A stage is cleared once its frame is sent, so each dump covers the time since the last one. The timer is read
+ through halProfCount(); a host build's hal.h can back it with clock_gettime(CLOCK_MONOTONIC) scaled to
+ PROF_HZ, so the same macros and table time the host build. PROF_ENABLE 0 compiles the macros out.
+
+ profBudget holds the longest each stage may take, in PROF_HZ ticks. The host tests hold the simulated
+ firmware's stages to the same budgets (test_prof), which catches a stage that starts blocking or looping.
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include "clock.h"
+#include "hal.h"
+
+#define PROF_ENABLE 1 // 0 removes all instrumentation
+#define PROF_HZ CLOCK_SMCLK_HZ // timer ticks per second
+#define PROF_BUCKETS 16
+
+// stages, code in main()
+#define PROF_TICK 0 // control tick: reservoir, ADC start, protocol resends
+#define PROF_AVERAGE 1 // averaging the ready half of the ADC ring
+#define PROF_CONTROL 2 // filters, dose controllers and valves of all zones
+#define PROF_REPORT 3 // LEDs, FRAM log and telemetry
+#define PROF_REPLAY 4 // a step of the FRAM log replay
+// event latencies, interrupt to main()
+#define PROF_TICK_LATENCY 5
+#define PROF_ADC_LATENCY 6
+// interrupt handlers
+#define PROF_ISR_ADC 7
+#define PROF_ISR_UART 8
+#define PROF_ISR_SERVO 9
+#define PROF_ISR_BUTTON 10
+#define PROF_STAGES 11
+
+#define PROF_BUDGET_US(us) ((unsigned short)((us) * (PROF_HZ / 1000) / 1000)) // below 21 ms
+
+#if PROF_ENABLE
+#define PROF_START(stage) (profStart[stage] = halProfCount())
+#define PROF_END(stage) profRecord(stage, halProfCount() - profStart[stage])
+#else
+#define PROF_START(stage)
+#define PROF_END(stage)
+#endif
+
+extern volatile unsigned short profStart[PROF_STAGES]; // timer reading at the start of each stage
+extern const unsigned short profBudget[PROF_STAGES]; // longest allowed, PROF_HZ ticks
+
+void profInit();
+void profRecord(unsigned char stage, unsigned short ticks);
+void profDumpStart();
+void profDumpStep();
+unsigned char profDumping();
+
+#endif /* PROF_H_ */
@@ -0,0 +1,237 @@
+#include "hal.h"
+#include "protocol.h"
+#include "scheduler.h"
+#include "uart.h"
+
+#define PROTO_RAW_MAX (PROTO_PAYLOAD_MAX + 6) // type, seq, node ID, payload, CRC
+#define PROTO_COBS_MAX (PROTO_RAW_MAX + 2) // COBS adds one byte, plus one per 254
+#define PROTO_RX_MAX 16 // gateway frames are short
+#define PROTO_RX_DISCARD 0xFF // protoRxLen while skipping an overlong frame
+
+typedef struct {
+    unsigned char len; // bytes in raw, 0 while the slot is free
+    unsigned char age; // control cycles since it was last sent
+    unsigned char tries; // times it has been sent
+    unsigned char raw[PROTO_RAW_MAX];
+} ProtoSlot;
+
+static ProtoSlot protoWindow[PROTO_WINDOW];
+static unsigned char protoSeq = 0;
+static unsigned char protoRxBuf[PROTO_RX_MAX]; // COBS bytes of the frame being received
+static unsigned char protoRxLen = 0;
+static unsigned char protoListen; // control cycles the receiver stays clocked once the window is empty
+
+#pragma PERSISTENT(protoNode)
+unsigned short protoNode = 0; // 0 until set at first boot
+
+static unsigned char cobsEncode(const unsigned char *src, unsigned char len, unsigned char *dest) {
+    unsigned char codeIdx = 0; // where the current block's length code goes
+    unsigned char code = 1;
+    unsigned char out = 1;
+    unsigned char idx;
+
+    for(idx = 0; idx < len; idx++) {
+        if(src[idx] == 0) { // zero ends a block
+            dest[codeIdx] = code;
+            codeIdx = out++;
+            code = 1;
+        } else {
+            dest[out++] = src[idx];
+            code++;
+            if(code == 0xFF) { // longest block without a zero
+                dest[codeIdx] = code;
+                codeIdx = out++;
+                code = 1;
+            }
+        }
+    }
+    dest[codeIdx] = code;
+    return out;
+}
+
+static unsigned char cobsDecode(const unsigned char *src, unsigned char len, unsigned char *dest) { // 0 if malformed
+    unsigned char idx = 0;
+    unsigned char out = 0;
+    unsigned char code, copy;
+
+    while(idx < len) {
+        code = src[idx++];
+        if(code == 0 || idx + code - 1 > len) {
+            return 0;
+        }
+        for(copy = 1; copy < code; copy++) {
+            dest[out++] = src[idx++];
+        }
+        if(code < 0xFF && idx < len) { // a zero was removed here
+            dest[out++] = 0;
+        }
+    }
+    return out;
+}
+
+static unsigned char transmit(const ProtoSlot *slot) { // 1 if the whole frame fit in the UART ring
+    unsigned char frame[PROTO_COBS_MAX + 1];
+    unsigned char len;
+
+    len = cobsEncode(slot->raw, slot->len, frame);
+    frame[len++] = 0; // frame delimiter
+    return uartWrite((const char *)frame, len) != 0;
+}
+
+void protoInit() {
+    unsigned char die[8];
+    unsigned char idx;
+
+    for(idx = 0; idx < PROTO_WINDOW; idx++) {
+        protoWindow[idx].len = 0;
+    }
+    protoRxLen = 0;
+    protoListen = PROTO_LISTEN_TICKS; // the gateway may have something for a node that just started
+    schedSmclkUsers |= SMCLK_LINK;
+
+    if(protoNode == 0) { // first boot, an ID from what makes this chip different from the others
+        for(idx = 0; idx < sizeof die; idx += 2) {
+            die[idx] = (unsigned char)halTlvWord(HAL_TLV_DIE_RECORD + idx);
+            die[idx + 1] = (unsigned char)(halTlvWord(HAL_TLV_DIE_RECORD + idx) >> 8);
+        }
+        protoNode = halCrc16(die, sizeof die);
+        if(protoNode == 0) {
+            protoNode = 1;
+        }
+    }
+}
+
+unsigned short protoNodeId() {
+    return protoNode;
+}
+
+unsigned char protoWindowFree() {
+    unsigned char idx, free = 0;
+
+    for(idx = 0; idx < PROTO_WINDOW; idx++) {
+        if(protoWindow[idx].len == 0) {
+            free++;
+        }
+    }
+    return free;
+}
+
+unsigned char protoSend(unsigned char type, const unsigned char *payload, unsigned char len) { // 1 if sent
+    ProtoSlot *slot = 0;
+    unsigned short crc;
+    unsigned char idx;
+
+    for(idx = 0; idx < PROTO_WINDOW; idx++) {
+        if(protoWindow[idx].len == 0) {
+            slot = &protoWindow[idx];
+            break;
+        }
+    }
+    if(slot == 0 || len > PROTO_PAYLOAD_MAX) {
+        return 0; // window full, wait for an ACK
+    }
+
+    slot->raw[0] = type;
+    slot->raw[1] = protoSeq;
+    slot->raw[2] = (unsigned char)protoNode;
+    slot->raw[3] = (unsigned char)(protoNode >> 8);
+    for(idx = 0; idx < len; idx++) {
+        slot->raw[4 + idx] = payload[idx];
+    }
+    crc = halCrc16(slot->raw, len + 4);
+    slot->raw[len + 4] = (unsigned char)crc;
+    slot->raw[len + 5] = (unsigned char)(crc >> 8);
+    slot->len = len + 6;
+
+    if(!transmit(slot)) {
+        slot->len = 0; // UART ring full, the caller tries again later with the same seq
+        return 0;
+    }
+    slot->age = 0;
+    slot->tries = 1;
+    protoSeq++;
+    protoListen = PROTO_LISTEN_TICKS; // the ACK comes back on SMCLK
+    schedSmclkUsers |= SMCLK_LINK;
+    return 1;
+}
+
+void protoTick() { // call once per control cycle, resends frames that were not acknowledged in time
+    unsigned char idx;
+    ProtoSlot *slot;
+
+    for(idx = 0; idx < PROTO_WINDOW; idx++) {
+        slot = &protoWindow[idx];
+        if(slot->len == 0) {
+            continue;
+        }
+        protoListen = PROTO_LISTEN_TICKS; // still waiting for an ACK
+        slot->age++;
+        if(slot->age < PROTO_RETRY_TICKS) {
+            continue;
+        }
+        if(slot->tries >= PROTO_RETRIES) {
+            slot->len = 0; // give up, the data is still in the FRAM log
+        } else if(transmit(slot)) {
+            slot->age = 0;
+            slot->tries++;
+        }
+    }
+
+    if(protoListen > 0 && --protoListen == 0) { // window empty for PROTO_LISTEN_TICKS, LPM3 from here
+        schedSmclkUsers &= ~SMCLK_LINK;
+    }
+}
+
+static unsigned char handleFrame() { // returns the frame type, 0 if the frame was bad or already handled
+    unsigned char raw[PROTO_RX_MAX];
+    unsigned char len, idx;
+    unsigned short crc;
+
+    len = cobsDecode(protoRxBuf, protoRxLen, raw);
+    if(len < 4) {
+        return 0;
+    }
+    crc = halCrc16(raw, len - 2);
+    if(raw[len - 2] != (unsigned char)crc || raw[len - 1] != (unsigned char)(crc >> 8)) {
+        return 0; // corrupted, the gateway will send it again
+    }
+
+    if(raw[0] == PROTO_ACK && len == 5) {
+        for(idx = 0; idx < PROTO_WINDOW; idx++) {
+            if(protoWindow[idx].len != 0 && protoWindow[idx].raw[1] == raw[2]) {
+                protoWindow[idx].len = 0; // acknowledged, slot is free again
+            }
+        }
+        return 0;
+    }
+    if(raw[0] == PROTO_SET_NODE && len == 6) {
+        if(raw[2] != 0 || raw[3] != 0) { // 0 means unset, not a valid ID
+            protoNode = raw[2] | ((unsigned short)raw[3] << 8);
+        }
+        return 0;
+    }
+    return raw[0];
+}
+
+unsigned char protoReceive() { // call on EVENT_UART_RX, returns the last request frame type received or 0
+    unsigned char byte;
+    unsigned char request = 0;
+    unsigned char type;
+
+    while(uartRead(&byte)) {
+        if(byte == 0) { // end of frame
+            if(protoRxLen != 0 && protoRxLen != PROTO_RX_DISCARD) {
+                type = handleFrame();
+                if(type != 0) {
+                    request = type;
+                }
+            }
+            protoRxLen = 0;
+        } else if(protoRxLen < PROTO_RX_MAX) {
+            protoRxBuf[protoRxLen++] = byte;
+        } else {
+            protoRxLen = PROTO_RX_DISCARD; // too long for any gateway frame, skip to the next delimiter
+        }
+    }
+    return request;
+}
@@ -0,0 +1,55 @@
+/*
+ protocol.h
+ Binary link protocol to the ESP-01 over eUSCI_A1. Frames from the node are
+
+    type, seq, node ID low byte, node ID high byte, payload (0 to PROTO_PAYLOAD_MAX bytes), CRC-16 low, CRC-16 high
+
+ and frames from the gateway the same without the node ID. Both are COBS encoded and ended with a 0x00 byte,
+ so a receiver can resync on any 0x00. The CRC is CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF)
+ over everything before it, computed by the CRC16 module.
+
+ The node ID lets a gateway or aggregator that hears many nodes keep their streams apart. It is kept in FRAM;
+ on first boot it is the CRC-16 of the TLV die record (lot, wafer and die position), which differs from chip to
+ chip, and the gateway can assign one of its own with PROTO_SET_NODE.
+
+ Data frames (PROTO_TELEMETRY, PROTO_LOG, PROTO_STATS) are kept in a window of PROTO_WINDOW frames until the
+ gateway sends PROTO_ACK with their seq as the payload, and are sent again every PROTO_RETRY_TICKS control cycles until
+ then, up to PROTO_RETRIES times. While the window is full protoSend() refuses new frames, which is the
+ backpressure the telemetry and log replay code waits on; nothing is lost because every sample is also in the
+ FRAM log. The gateway sends PROTO_REPLAY to ask for the FRAM log and PROTO_PROFILE for the profiling table.
+
+ eUSCI_A1 is clocked from SMCLK, which stops in LPM3, so bytes from the gateway are only received while
+ SMCLK_LINK (scheduler.h) keeps the CPU in LPM0: from boot and from every data frame sent until the window
+ is empty again, then for PROTO_LISTEN_TICKS more control cycles. ACKs always fall in that time, and log
+ replays and profile dumps keep frames in the window until they are done. The gateway has to send its
+ requests (PROTO_REPLAY, PROTO_PROFILE, PROTO_SET_NODE) in the same time, e.g. right behind an ACK; a request
+ sent while the node sleeps in LPM3 is lost. A receiver on ACLK is no option, 32768 Hz is too slow for
+ 115200 baud.
+ */
+
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#define PROTO_PAYLOAD_MAX 48 // largest payload in a frame
+#define PROTO_WINDOW 4 // unacknowledged data frames
+#define PROTO_RETRY_TICKS 3 // control cycles before an unacknowledged frame is sent again
+#define PROTO_RETRIES 5 // sends of a frame before it is given up on
+#define PROTO_LISTEN_TICKS 5 // control cycles the receiver keeps listening after the window has emptied
+
+// frame types
+#define PROTO_TELEMETRY 0x01 // node to gateway, batch of telemetry records (telemetry.h)
+#define PROTO_LOG 0x02 // node to gateway, FRAM log block chunk
+#define PROTO_STATS 0x03 // node to gateway, profiling statistics of one stage (prof.h)
+#define PROTO_ACK 0x81 // gateway to node, payload is the acknowledged seq
+#define PROTO_REPLAY 0x82 // gateway to node, send the FRAM log
+#define PROTO_PROFILE 0x83 // gateway to node, send the profiling table
+#define PROTO_SET_NODE 0x84 // gateway to node, payload is the new node ID, little endian
+
+void protoInit();
+unsigned short protoNodeId();
+unsigned char protoSend(unsigned char type, const unsigned char *payload, unsigned char len);
+void protoTick();
+unsigned char protoReceive();
+unsigned char protoWindowFree();
+
+#endif /* PROTOCOL_H_ */
@@ -0,0 +1,57 @@
+#include "reservoir.h"
+
+typedef struct {
+    unsigned short dispensed; // mL since the last refill
+    unsigned short flowAcc; // flow not yet whole mL, in mL/RES_TICKS_PER_MIN
+    unsigned short minutes; // since the last refill, stops at 0xFFFF
+    unsigned char minuteTicks; // ticks into the current minute
+} ReservoirState;
+
+#pragma PERSISTENT(resState)
+ReservoirState resState = {0, 0, 0, 0};
+
+void resTick(unsigned char open) { // once per control tick, with the number of open hatches
+    if(open) {
+        resState.flowAcc += RES_FLOW_ML_PER_MIN * open;
+        resState.dispensed += resState.flowAcc / RES_TICKS_PER_MIN; // constant divisor
+        resState.flowAcc %= RES_TICKS_PER_MIN;
+        if(resState.dispensed > RES_CAPACITY_ML) {
+            resState.dispensed = RES_CAPACITY_ML; // cannot pour more than is there
+        }
+    }
+    if(++resState.minuteTicks >= RES_TICKS_PER_MIN) {
+        resState.minuteTicks = 0;
+        if(resState.minutes != 0xFFFF) {
+            resState.minutes++;
+        }
+    }
+}
+
+void resRefill() {
+    resState.dispensed = 0;
+    resState.flowAcc = 0;
+    resState.minutes = 0;
+    resState.minuteTicks = 0;
+}
+
+unsigned short resDispensed() {
+    return resState.dispensed;
+}
+
+unsigned char resLevel() { // percent of RES_CAPACITY_ML left
+    return (unsigned char)(((unsigned long)(RES_CAPACITY_ML - resState.dispensed) * 100) / RES_CAPACITY_ML);
+}
+
+unsigned short resHoursLeft() { // at the average rate since the refill
+    unsigned long hours;
+
+    if(resState.dispensed == 0) {
+        return RES_HOURS_UNKNOWN;
+    }
+    // both factors fit in 16 bits, so the product fits in 32
+    hours = (unsigned long)(RES_CAPACITY_ML - resState.dispensed) * resState.minutes / resState.dispensed / 60;
+    if(hours >= RES_HOURS_UNKNOWN) {
+        return RES_HOURS_UNKNOWN - 1;
+    }
+    return (unsigned short)hours;
+}
@@ -0,0 +1,27 @@
+/*
+ reservoir.h
+ Water reservoir accounting, one reservoir shared by all zones. Every control tick (scheduler.h, timed by
+ REFO rather than by how long the loop took) adds RES_FLOW_ML_PER_MIN worth of water for each open hatch to the volume dispensed since the
+ last refill. The level left and a prediction of when the reservoir runs dry, from the average use since the
+ refill, come from that. The counters are in FRAM (#pragma PERSISTENT), so a reset does not lose track of
+ how much water is left; they only start over when the refill button is pressed.
+ */
+
+#ifndef RESERVOIR_H_
+#define RESERVOIR_H_
+
+#include "scheduler.h"
+
+#define RES_CAPACITY_ML 2000 // full reservoir
+#define RES_FLOW_ML_PER_MIN 600 // flow through the fully open hatch, measure for the actual setup
+#define RES_LOW_PERCENT 10 // level at which the reservoir counts as empty
+#define RES_TICKS_PER_MIN ((60UL * ACLK_HZ) / (TICK_PERIOD + 1)) // control ticks per minute
+#define RES_HOURS_UNKNOWN 0xFFFF // no water used since the refill, nothing to predict from
+
+void resTick(unsigned char open);
+void resRefill();
+unsigned short resDispensed();
+unsigned char resLevel();
+unsigned short resHoursLeft();
+
+#endif /* RESERVOIR_H_ */
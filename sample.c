@@ -0,0 +1,66 @@
+#include "sample.h"
+#include "servo.h"
+#include "zone.h"
+
+static unsigned short sampleInterval; // control cycles between samples
+static unsigned short sampleAge; // control cycles since the last sample
+static unsigned short sampleLast[ZONE_COUNT]; // filtered moisture at the last sample
+
+void sampleInit() { // after zoneInit()
+    unsigned char zone;
+
+    sampleInterval = 1;
+    sampleAge = 0;
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        sampleLast[zone] = zones[zone].moisture;
+    }
+}
+
+unsigned char sampleTick() { // call once per control tick, 1 when this tick should sample
+    sampleAge++;
+    return sampleAge >= sampleInterval;
+}
+
+void sampleNow() { // next tick samples, whatever the interval
+    sampleInterval = 1;
+}
+
+unsigned short sampleAdapt() { // call after each sample has been handled, returns control cycles it covered
+    unsigned short covered = sampleAge;
+    unsigned short limit = SAMPLE_MAX_CYCLES;
+    unsigned short dryAt;
+    unsigned short change;
+    unsigned char flat = 1;
+    unsigned char zone;
+    Zone *z;
+
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        z = &zones[zone];
+        if(z->dose.state != DOSE_IDLE || z->valveOpen || z->setThres || servoBusy(zoneConfig[zone].servo)) {
+            limit = 1; // the controller counts cycles, it has to see all of them
+        }
+
+        change = (z->moisture > sampleLast[zone]) ? z->moisture - sampleLast[zone] : sampleLast[zone] - z->moisture;
+        if(change > SAMPLE_FLAT_BAND) {
+            flat = 0;
+        }
+        sampleLast[zone] = z->moisture;
+
+        dryAt = z->thres + moistureFilterConfig.hysteresis; // higher readings are drier
+        if(z->moisture >= dryAt) {
+            limit = 1;
+        } else if(((dryAt - z->moisture) >> SAMPLE_NEAR_SHIFT) < limit) {
+            limit = (dryAt - z->moisture) >> SAMPLE_NEAR_SHIFT;
+        }
+    }
+
+    sampleInterval = flat ? sampleInterval << 1 : 1;
+    if(sampleInterval > limit) {
+        sampleInterval = limit;
+    }
+    if(sampleInterval == 0) {
+        sampleInterval = 1;
+    }
+    sampleAge = 0;
+    return covered;
+}
@@ -0,0 +1,30 @@
+/*
+ sample.h
+ Adaptive sampling interval. The control tick (scheduler.h) stays at 1 second on the ACLK timer, as
+ it is the time base of the reservoir estimate, the dose pulses, protocol resends and the button alarm, but the
+ ADC sequence, filters, controllers, FRAM log and telemetry frame only run every sampleTick() that says a
+ sample is due. The interval, in control cycles, is adapted after every sample:
+
+    any zone pouring, settling, with a hatch open or moving, or waiting to take a threshold: every cycle
+    readings changed by more than SAMPLE_FLAT_BAND since the last sample: every cycle
+    readings flat: the interval doubles, up to SAMPLE_MAX_CYCLES
+    but never longer than 1 cycle per 2^SAMPLE_NEAR_SHIFT counts the driest zone still has to go before it
+    counts as too dry, so the interval shortens as a zone nears its threshold
+
+ Button gestures and UART frames still wake main() straight away; sampleNow() makes the next tick sample
+ when one of them changes what the controllers do.
+ */
+
+#ifndef SAMPLE_H_
+#define SAMPLE_H_
+
+#define SAMPLE_MAX_CYCLES 64 // longest interval, about a minute
+#define SAMPLE_FLAT_BAND 8 // filtered moisture change between samples that still counts as flat, ADC counts
+#define SAMPLE_NEAR_SHIFT 2 // interval is at most the distance to the dry point / 2^SAMPLE_NEAR_SHIFT
+
+void sampleInit();
+unsigned char sampleTick();
+void sampleNow();
+unsigned short sampleAdapt();
+
+#endif /* SAMPLE_H_ */
@@ -0,0 +1,34 @@
+#include "clock.h"
+#include "hal.h"
+#include "prof.h"
+#include "scheduler.h"
+
+volatile unsigned char schedEvents = 0;
+volatile unsigned char schedSmclkUsers = 0;
+
+void schedInit() { // after clockInit(), which puts ACLK on REFO
+
+    halTickStart(TICK_PERIOD); // Timer B0 counts up to TICK_PERIOD and interrupts once per control cycle
+
+}
+
+unsigned char schedWait() {
+    unsigned char events;
+
+    clockSlow(); // only interrupts run until main() asks for a burst again
+    halIrqOff();
+    while(schedEvents == 0) { // sleep until an interrupt posts an event
+        halSleep(schedSmclkUsers == 0); // LPM0 while SMCLK is still needed for PWM or UART, else LPM3
+    }
+    events = schedEvents;
+    schedEvents = 0;
+    halIrqOn();
+
+    return events;
+}
+
+HAL_ISR(TIMER0_B0_VECTOR, tickIsr) {
+    schedEvents |= EVENT_TICK;
+    PROF_START(PROF_TICK_LATENCY);
+    HAL_WAKE_ON_EXIT();
+}
@@ -0,0 +1,37 @@
+/*
+ scheduler.h
+ Event-driven main loop for the watering system. Timer_B0 is clocked from ACLK (REFO, 32768 Hz) and wakes the
+ CPU from LPM3 once per control cycle, the same way BME280_FR.c uses TIMER0_A0_VECTOR. The ADC, UART and
+ the buttons (button.h) post events from their interrupts, and main() handles them before going back
+ to sleep. Modules that need SMCLK while the CPU sleeps (servo PWM, UART) keep the CPU in LPM0 instead.
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "clock.h"
+
+#define ACLK_HZ CLOCK_REFO_HZ // REFO, clock.h
+#define TICK_PERIOD (ACLK_HZ - 1) // TB0CCR0, ACLK counts per control cycle minus one: 1 second; maximum is 65535
+
+// event bits posted by the interrupts and returned by schedWait()
+#define EVENT_TICK BIT0 // control cycle timer expired
+#define EVENT_ADC_HALF BIT1 // first half of the ADC ring is full
+#define EVENT_UART_TX BIT2 // UART transmit ring has drained
+#define EVENT_BUTTON BIT3 // button gestures are waiting in the button queue
+#define EVENT_SERVO BIT5 // servo reached its target position
+#define EVENT_ADC_FULL BIT6 // second half of the ADC ring is full
+#define EVENT_UART_RX BIT7 // UART byte received
+
+// bits of schedSmclkUsers, set while a module needs SMCLK running
+#define SMCLK_UART BIT0
+#define SMCLK_SERVO BIT1
+#define SMCLK_LINK BIT2 // UART receiver listening for the gateway, protocol.h
+
+extern volatile unsigned char schedEvents; // pending events, written by interrupts
+extern volatile unsigned char schedSmclkUsers; // modules that need LPM0 instead of LPM3
+
+void schedInit();
+unsigned char schedWait();
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,192 @@
+#include "hal.h"
+#include "prof.h"
+#include "scheduler.h"
+#include "servo.h"
+
+// servo states
+#define SERVO_IDLE 0
+#define SERVO_WAITING 1 // has a new target, waiting for a free moving slot
+#define SERVO_MOVING 2
+
+// PWM output states
+#define SERVO_PWM_OFF 0 // timers halted, outputs held low, SMCLK not needed
+#define SERVO_PWM_ON 1 // pulses every period
+#define SERVO_PWM_PARKING 2 // last pulse finishing, outputs stay low after it
+
+const ServoProfile servoHatchProfile = {
+    SERVO_COUNTS(48), // 48 us per PWM period, same top speed as the old blocking loop
+    SERVO_COUNTS(4) // reach top speed in 12 PWM periods (~0.3 s)
+};
+
+typedef struct {
+    unsigned short pos; // pulse width currently in the channel's CCR
+    unsigned short target;
+    unsigned short speed; // counts moved in the last PWM period
+    unsigned short rampDist; // counts travelled while accelerating, needed again to stop
+    unsigned char state; // SERVO_IDLE, SERVO_WAITING or SERVO_MOVING
+    const ServoProfile *profile;
+} ServoState;
+
+static volatile ServoState servos[SERVO_CHANNELS];
+static volatile unsigned char servoActive = 0; // channels waiting or moving
+static unsigned char servoChannels = 0; // channels in use
+static volatile unsigned char servoPwm = SERVO_PWM_OFF;
+
+void servoInit(unsigned char channels) { // bit n set for each channel n in use, timers B3 and B2 for servo PWM
+    unsigned char channel;
+
+    servoChannels = channels;
+    for(channel = 0; channel < SERVO_CHANNELS; channel++) {
+        servos[channel].pos = SERVO_CLOSED_POS; // start in a known state with the hatch closed
+        servos[channel].target = SERVO_CLOSED_POS;
+        servos[channel].state = SERVO_IDLE;
+        servos[channel].profile = &servoHatchProfile;
+        if(channels & (1 << channel)) {
+            halPwmSet(channel, SERVO_CLOSED_POS);
+        }
+    }
+
+    // pins, PWM period and SMCLK / SERVO_TIMER_DIV; outputs held low and timers halted until a move starts,
+    // the motion interrupt is only enabled while moving
+    halPwmInit(channels, SERVO_PERIOD, SERVO_TIMER_ID);
+    servoPwm = SERVO_PWM_OFF;
+}
+
+void servoMoveTo(unsigned char channel, unsigned short target, const ServoProfile *profile) {
+    volatile ServoState *servo = &servos[channel];
+
+    halPwmPeriodIrq(0); // hold off the motion interrupt while the move is set up
+    if(servo->state != SERVO_MOVING || (target > servo->pos) != (servo->target > servo->pos)) { // start from rest unless retargeting in the same direction
+        servo->speed = 0;
+        servo->rampDist = 0;
+    }
+    servo->target = target;
+    servo->profile = profile;
+    if(servo->pos == target) { // already there
+        servo->state = SERVO_IDLE;
+        servoActive &= ~(1 << channel);
+        schedEvents |= EVENT_SERVO;
+    } else {
+        if(servo->state == SERVO_IDLE) {
+            servo->state = SERVO_WAITING; // the motion interrupt starts it when a slot is free
+        }
+        servoActive |= 1 << channel;
+    }
+    if(servoActive) {
+        schedSmclkUsers |= SMCLK_SERVO; // PWM and the motion interrupt need SMCLK
+        if(servoPwm != SERVO_PWM_ON) { // pulses again from the next period; a parking pulse just carries on
+            halPwmOutputs(servoChannels, OUTMOD_7); // CCRn reset/set
+            if(servoPwm == SERVO_PWM_OFF) {
+                halPwmRun(1);
+            }
+            servoPwm = SERVO_PWM_ON;
+        }
+        halPwmPeriodIrq(1);
+    } else if(servoPwm != SERVO_PWM_OFF) {
+        halPwmPeriodIrq(1); // the motion interrupt parks the outputs
+    }
+}
+
+void servoSetPosition(unsigned char channel, unsigned short pos) { // where a servo of an idle channel really is, e.g. after a reset
+    servos[channel].pos = pos;
+    servos[channel].target = pos;
+    halPwmSet(channel, pos);
+}
+
+unsigned char servoBusy(unsigned char channel) { // 1 while waiting for a slot or moving
+    return servos[channel].state != SERVO_IDLE;
+}
+
+unsigned short servoPosition(unsigned char channel) {
+    return servos[channel].pos;
+}
+
+unsigned short servoRemaining(unsigned char channel) { // progress of the current move, in counts still to go
+    unsigned short pos, target;
+
+    halPwmPeriodIrq(0);
+    pos = servos[channel].pos;
+    target = servos[channel].target;
+    if(servoPwm != SERVO_PWM_OFF) {
+        halPwmPeriodIrq(1);
+    }
+    return (target > pos) ? target - pos : pos - target;
+}
+
+static unsigned char servoStep(unsigned char channel) { // one PWM period of a moving servo, 1 when it arrived
+    volatile ServoState *servo = &servos[channel];
+    unsigned short remaining;
+
+    remaining = (servo->target > servo->pos) ? servo->target - servo->pos : servo->pos - servo->target;
+
+    if(remaining <= servo->rampDist) { // decelerate, it takes as far to stop as it took to get up to speed
+        servo->rampDist = (servo->rampDist > servo->speed) ? servo->rampDist - servo->speed : 0;
+        if(servo->speed > 2 * servo->profile->accel) {
+            servo->speed -= servo->profile->accel;
+        } else {
+            servo->speed = servo->profile->accel; // creep the last counts at the slowest step
+        }
+    } else if(servo->speed < servo->profile->maxSpeed) { // accelerate
+        servo->speed += servo->profile->accel;
+        if(servo->speed > servo->profile->maxSpeed) {
+            servo->speed = servo->profile->maxSpeed;
+        }
+        servo->rampDist += servo->speed;
+    }
+
+    if(servo->speed >= remaining) { // target reached this period
+        servo->pos = servo->target;
+        servo->speed = 0;
+        servo->rampDist = 0;
+        servo->state = SERVO_IDLE;
+    } else if(servo->target > servo->pos) { // rotate CW
+        servo->pos += servo->speed;
+    } else { // rotate CCW
+        servo->pos -= servo->speed;
+    }
+
+    halPwmSet(channel, servo->pos);
+    return servo->state == SERVO_IDLE;
+}
+
+HAL_ISR(TIMER3_B0_VECTOR, servoIsr) { // start of a PWM period, the CCRs can be changed without a glitch
+    unsigned char channel;
+    unsigned char moving = 0;
+
+    PROF_START(PROF_ISR_SERVO);
+    for(channel = 0; channel < SERVO_CHANNELS; channel++) {
+        if(servos[channel].state == SERVO_MOVING) {
+            if(servoStep(channel)) {
+                servoActive &= ~(1 << channel);
+                schedEvents |= EVENT_SERVO;
+                HAL_WAKE_ON_EXIT();
+            } else {
+                moving++;
+            }
+        }
+    }
+
+    // start waiting servos in channel order while there is a free slot
+    for(channel = 0; channel < SERVO_CHANNELS && moving < SERVO_MAX_MOVING; channel++) {
+        if(servos[channel].state == SERVO_WAITING) {
+            servos[channel].state = SERVO_MOVING;
+            moving++;
+        }
+    }
+
+    // SMCLK stops in LPM3 and would freeze the outputs at whatever level they have, high right after this
+    // interrupt. So once nothing moves, the pulse of this period finishes in reset mode and stays low, and only
+    // a period later, with every output low, are the timers halted and SMCLK released.
+    if(!servoActive) {
+        if(servoPwm == SERVO_PWM_ON) {
+            halPwmOutputs(servoChannels, OUTMOD_5); // reset at CCRn, never set again
+            servoPwm = SERVO_PWM_PARKING;
+        } else {
+            halPwmRun(0);
+            halPwmPeriodIrq(0);
+            servoPwm = SERVO_PWM_OFF;
+            schedSmclkUsers &= ~SMCLK_SERVO;
+        }
+    }
+    PROF_END(PROF_ISR_SERVO);
+}
@@ -0,0 +1,63 @@
+/*
+ servo.h
+ Non-blocking servo motion engine for up to SERVO_CHANNELS servos. Channels 0-5 are TB3.1-TB3.6 (P6.0-P6.5)
+ and 6-7 are TB2.1-TB2.2 (P5.0-P5.1); Timer_B2 is started together with Timer_B3 so both have the same
+ period. The Timer_B3 CCR0 interrupt, once per PWM period, steps every moving servo's pulse width towards its
+ target along a trapezoidal velocity profile: accelerate, cruise at the profile's top speed, then decelerate
+ into the target. A servo draws most current while moving, so at most SERVO_MAX_MOVING servos move at once;
+ later moves wait their turn in channel order. main() starts a move and keeps running; EVENT_SERVO is posted
+ to the scheduler each time a servo reaches its target. Timings are given in microseconds and converted to
+ timer counts from CLOCK_SMCLK_HZ (clock.h), so they hold for any clock setting.
+
+ The PWM timers run on SMCLK, which stops in LPM3, so pulses are only sent while a move is in progress. When
+ the last move ends, the outputs finish their pulse and are then held low, the timers are halted and
+ SMCLK_SERVO is released (scheduler.h); the next move restarts them from a clean period. An idle servo gets
+ no pulses and holds the hatch by its gear friction.
+ */
+
+#ifndef SERVO_H_
+#define SERVO_H_
+
+#include "clock.h"
+
+#define SERVO_CHANNELS 8
+#define SERVO_MAX_MOVING 2 // servos allowed to move at the same time, limits peak current
+#define SERVO_PERIOD_US 23260UL // PWM period
+
+// timer input divider, the smallest that fits the period in 16 bits
+#if SERVO_PERIOD_US * (CLOCK_SMCLK_HZ / 1000) / 1000 <= 65535
+#define SERVO_TIMER_DIV 1
+#define SERVO_TIMER_ID ID__1
+#elif SERVO_PERIOD_US * (CLOCK_SMCLK_HZ / 2000) / 1000 <= 65535
+#define SERVO_TIMER_DIV 2
+#define SERVO_TIMER_ID ID__2
+#elif SERVO_PERIOD_US * (CLOCK_SMCLK_HZ / 4000) / 1000 <= 65535
+#define SERVO_TIMER_DIV 4
+#define SERVO_TIMER_ID ID__4
+#else
+#define SERVO_TIMER_DIV 8
+#define SERVO_TIMER_ID ID__8
+#endif
+
+#define SERVO_TIMER_HZ (CLOCK_SMCLK_HZ / SERVO_TIMER_DIV)
+#define SERVO_COUNTS(us) ((unsigned short)((unsigned long)(us) * (SERVO_TIMER_HZ / 1000) / 1000)) // timer counts in us microseconds
+
+#define SERVO_PERIOD (SERVO_COUNTS(SERVO_PERIOD_US) - 1) // PWM period in timer counts
+#define SERVO_OPEN_POS SERVO_COUNTS(2600) // hatch open, pulse width in timer counts
+#define SERVO_CLOSED_POS SERVO_COUNTS(550) // hatch closed, less than 180 degrees because the motor gets stuck
+
+typedef struct {
+    unsigned short maxSpeed; // top speed in counts per PWM period
+    unsigned short accel; // speed change in counts per PWM period, per PWM period
+} ServoProfile;
+
+extern const ServoProfile servoHatchProfile; // about the same travel time as the old 500 cycle step delay
+
+void servoInit(unsigned char channels);
+void servoMoveTo(unsigned char channel, unsigned short target, const ServoProfile *profile);
+void servoSetPosition(unsigned char channel, unsigned short pos);
+unsigned char servoBusy(unsigned char channel);
+unsigned short servoPosition(unsigned char channel);
+unsigned short servoRemaining(unsigned char channel);
+
+#endif /* SERVO_H_ */
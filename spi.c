@@ -0,0 +1,85 @@
+#include "hal_spi.h"
+#include "spi.h"
+
+static SpiTransaction *volatile spiHead = 0; // transaction being clocked out
+static SpiTransaction *spiTail = 0;
+static volatile unsigned char spiIdx; // bytes of spiHead already clocked
+
+static void spiStart(SpiTransaction *transaction) {
+    spiIdx = 0;
+    halSpiSelect(transaction->cs); //Pull CSB line low
+    halSpiPut(transaction->txLen > 0 ? transaction->tx[0] : SPI_DUMMY);
+}
+
+unsigned short spiDivider(unsigned long smclkHz) { // UCB0BRW for an SPI clock of at most SPI_HZ
+    return (unsigned short)((smclkHz + SPI_HZ - 1) / SPI_HZ);
+}
+
+void spiInit(unsigned long smclkHz) {
+    halSpiInit(spiDivider(smclkHz)); // eUSCI_B0 as 3-pin SPI master on SMCLK, divided down to SPI_HZ or just below
+    halSpiEnable(1); // stays enabled, no UCSWRST toggling around each transaction
+    halSpiRxIrq(1);
+}
+
+void spiSubmit(SpiTransaction *transaction) {
+    unsigned short state;
+
+    transaction->next = 0;
+    state = halIrqSave(); // the interrupt also moves the head
+    if(spiHead == 0) {
+        spiHead = spiTail = transaction;
+        spiStart(transaction);
+    } else {
+        spiTail->next = transaction;
+        spiTail = transaction;
+    }
+    halIrqRestore(state);
+}
+
+unsigned char spiBusy() {
+    return spiHead != 0;
+}
+
+void spiWait() { // sleep in LPM0 until every queued transaction is done
+    halIrqOff();
+    while(spiHead != 0) {
+        halSleep(0); // SPI runs on SMCLK
+    }
+    halIrqOn();
+}
+
+HAL_ISR(EUSCI_B0_VECTOR, spiIsr) {
+    SpiTransaction *transaction = spiHead;
+    unsigned char byte;
+    unsigned char total;
+
+    switch(halSpiIv()) {
+        case USCI_SPI_UCRXIFG:
+            byte = halSpiGet();
+            if(transaction == 0) {
+                break;
+            }
+            if(spiIdx >= transaction->txLen) { // burst read phase
+                transaction->rx[spiIdx - transaction->txLen] = byte;
+            }
+            spiIdx++;
+            total = transaction->txLen + transaction->rxLen;
+            if(spiIdx < total) { // next byte of the same transaction
+                halSpiPut(spiIdx < transaction->txLen ? transaction->tx[spiIdx] : SPI_DUMMY);
+                break;
+            }
+
+            halSpiDeselect(transaction->cs); //Pull CSB line high
+            spiHead = transaction->next;
+            if(spiHead != 0) {
+                spiStart(spiHead); // keep the bus busy with the next sensor
+            }
+            if(transaction->done != 0) {
+                transaction->done(transaction);
+            }
+            HAL_WAKE_ON_EXIT();
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ spi.h
+ Queued, interrupt-driven SPI transactions on eUSCI_B0. A transaction is described rather than coded: bytes to
+ write (register address/value pairs, or a read address) followed by a burst read of rxLen bytes into a
+ caller buffer, all with one chip select held low. Transactions are run back to back from the EUSCI_B0_VECTOR
+ interrupt and each one's done callback is called from the interrupt when it finishes, so the CPU can sleep
+ in LPM0 (SPI runs on SMCLK) during a burst read and several sensors can be read in one wake-up.
+
+ spiInit() takes the SMCLK frequency of the board it runs on, since the FR2355 controller (clock.h) and the
+ FR5969 BME280 demo run SMCLK at different rates. A transaction and its buffers must stay valid until its done
+ callback has been called.
+ */
+
+#ifndef SPI_H_
+#define SPI_H_
+
+#define SPI_HZ 1000000UL // highest SPI clock, SMCLK is divided down to it
+#define SPI_DUMMY 0xAA // sent while a burst read clocks data in
+
+struct SpiTransaction;
+typedef void (*SpiDoneFn)(struct SpiTransaction *transaction);
+
+typedef struct SpiTransaction {
+    unsigned char cs; // P1 chip select pin, active low
+    const unsigned char *tx; // written first
+    unsigned char txLen;
+    unsigned char *rx; // filled by the burst read after tx, may be 0 when rxLen is 0
+    unsigned char rxLen;
+    SpiDoneFn done; // called from the interrupt, may be 0
+    struct SpiTransaction *next; // queue link, owned by spi.c
+} SpiTransaction;
+
+void spiInit(unsigned long smclkHz);
+unsigned short spiDivider(unsigned long smclkHz);
+void spiSubmit(SpiTransaction *transaction);
+unsigned char spiBusy();
+void spiWait();
+
+#endif /* SPI_H_ */
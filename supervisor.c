@@ -0,0 +1,49 @@
+#include "datalog.h"
+#include "hal.h"
+#include "supervisor.h"
+
+#define SUP_WDT_CTL (WDTSSEL__VLO | WDTCNTCL | WDTIS__32K) // clears the count when written
+
+typedef struct {
+    unsigned short resets; // resets other than power-up
+    unsigned short lastCause; // SYSRSTIV of the last reset
+} SupResetInfo;
+
+#pragma PERSISTENT(supResetInfo)
+SupResetInfo supResetInfo = {0, 0};
+
+static unsigned char supStages = 0; // stages checked in since the last service
+
+void supInit() { // after logInit(), records why the last reset happened
+    unsigned short cause = halResetCause(); // highest priority cause
+
+    supResetInfo.lastCause = cause;
+    if(cause != SYSRSTIV_BOR && cause != SYSRSTIV_NONE) { // brownout is the normal power-up
+        supResetInfo.resets++;
+        logReset(cause);
+    }
+}
+
+void supStart() { // arm the watchdog once init is done
+    supStages = 0;
+    halWatchdogSet(SUP_WDT_CTL);
+}
+
+void supCheckin(unsigned char stage) {
+    supStages |= stage;
+}
+
+void supFeed() { // services the watchdog only when the whole control cycle has run
+    if((supStages & SUP_STAGES_ALL) == SUP_STAGES_ALL) {
+        halWatchdogSet(SUP_WDT_CTL);
+        supStages = 0;
+    }
+}
+
+unsigned short supResetCount() {
+    return supResetInfo.resets;
+}
+
+unsigned short supResetCause() {
+    return supResetInfo.lastCause;
+}
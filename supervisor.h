@@ -0,0 +1,34 @@
+/*
+ supervisor.h
+ Watchdog supervision. The watchdog runs from the VLO, so it keeps counting in LPM3, and times out after
+ SUP_WDT_COUNTS VLO cycles (about 3 control cycles). It is only serviced once every stage of the control
+ cycle has checked in since the last service: the tick was handled, an ADC half was averaged and the zones
+ were updated. A hung ADC, a lost tick interrupt or a main loop stuck anywhere therefore resets the unit
+ instead of leaving it asleep with a hatch open. The pipeline has no busy-wait loops left, every wait is a
+ sleep until an interrupt, so the watchdog is the timeout for all of them.
+
+ After a reset the cause (SYSRSTIV) is logged to the FRAM log and counted. Zone state that has to survive is
+ checkpointed in FRAM by zone.c, which closes any hatch that was open when the reset happened; thresholds
+ and the reservoir estimate are already in FRAM. Init has no long waits, so a warm restart is back in the
+ control loop within milliseconds.
+ */
+
+#ifndef SUPERVISOR_H_
+#define SUPERVISOR_H_
+
+// control cycle stages that must check in before the watchdog is serviced
+#define SUP_STAGE_TICK BIT0 // control tick handled
+#define SUP_STAGE_ADC BIT1 // ADC half averaged
+#define SUP_STAGE_CONTROL BIT2 // zones updated
+#define SUP_STAGES_ALL (SUP_STAGE_TICK | SUP_STAGE_ADC | SUP_STAGE_CONTROL)
+
+#define SUP_WDT_COUNTS 32768 // VLO cycles to time out, WDTIS__32K, ~3.3 s
+
+void supInit();
+void supStart();
+void supCheckin(unsigned char stage);
+void supFeed();
+unsigned short supResetCount();
+unsigned short supResetCause();
+
+#endif /* SUPERVISOR_H_ */
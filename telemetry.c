@@ -0,0 +1,39 @@
+#include "protocol.h"
+#include "telemetry.h"
+
+static unsigned char telemetryBatch[TELEMETRY_BATCH * TELEMETRY_RECORD_LEN];
+static unsigned char telemetryCount = 0; // records waiting in telemetryBatch
+static unsigned short telemetrySeq = 0;
+
+void telemetryAdd(unsigned char zone, unsigned short moisture, short temp, unsigned char valve,
+                  unsigned char level, unsigned short hoursLeft, unsigned short cycles) {
+    unsigned char *record;
+
+    if(telemetryCount == TELEMETRY_BATCH) { // last batch is still waiting for window space
+        if(!protoSend(PROTO_TELEMETRY, telemetryBatch, sizeof telemetryBatch)) {
+            telemetrySeq++; // skip this record, the gap in seq shows it
+            return;
+        }
+        telemetryCount = 0;
+    }
+
+    record = &telemetryBatch[telemetryCount * TELEMETRY_RECORD_LEN];
+    record[0] = (unsigned char)telemetrySeq;
+    record[1] = (unsigned char)(telemetrySeq >> 8);
+    record[2] = (unsigned char)moisture;
+    record[3] = (unsigned char)(moisture >> 8);
+    record[4] = (unsigned char)temp;
+    record[5] = (unsigned char)((unsigned short)temp >> 8);
+    record[6] = (zone << 4) | (valve ? 1 : 0);
+    record[7] = level;
+    record[8] = (unsigned char)hoursLeft;
+    record[9] = (unsigned char)(hoursLeft >> 8);
+    record[10] = (unsigned char)cycles;
+    record[11] = (unsigned char)(cycles >> 8);
+    telemetrySeq++;
+    telemetryCount++;
+
+    if(telemetryCount == TELEMETRY_BATCH && protoSend(PROTO_TELEMETRY, telemetryBatch, sizeof telemetryBatch)) {
+        telemetryCount = 0; // sent, start the next batch
+    }
+}
@@ -0,0 +1,32 @@
+/*
+ telemetry.h
+ Batched telemetry records for the ESP-01 link. Each sample (sample.h) adds one record per zone; once
+ TELEMETRY_BATCH records are collected they go out as one PROTO_TELEMETRY frame (protocol.h), so the Wi-Fi
+ module only has to be awake for one burst instead of one string per cycle. Each record is TELEMETRY_RECORD_LEN bytes, multi-byte
+ fields little endian:
+
+    0-1  sequence number of the record
+    2-3  filtered moisture ADC reading
+    4-5  temperature in tenths of a degree celsius, signed
+    6    valve state in bit 0, 1 open, 0 closed; zone number (zone.h) in bits 4-6
+    7    estimated reservoir level, percent
+    8-9  predicted hours until the reservoir is empty, 0xFFFF if unknown (reservoir.h)
+    10-11  control cycles since the previous sample, the sampling interval varies
+
+ The frame header carries the node ID (protocol.h), so records from many nodes can be told apart and, with
+ the cycle counts, put on a time axis by the receiver.
+
+ If the protocol window is full the batch is held and newer records are skipped until it goes out; they are
+ still in the FRAM log.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#define TELEMETRY_BATCH 4 // records per frame
+#define TELEMETRY_RECORD_LEN 12 // bytes per record, a batch fills PROTO_PAYLOAD_MAX
+
+void telemetryAdd(unsigned char zone, unsigned short moisture, short temp, unsigned char valve,
+                  unsigned char level, unsigned short hoursLeft, unsigned short cycles);
+
+#endif /* TELEMETRY_H_ */
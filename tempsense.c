@@ -0,0 +1,43 @@
+#include "hal.h"
+#include "tempsense.h"
+
+#define CALADC_15V_30C halTlvWord(HAL_TLV_ADC_30C) // Temperature Sensor Calibration-30C //6682 // See device datasheet for TLV table memory mapping
+#define CALADC_15V_85C halTlvWord(HAL_TLV_ADC_85C) // Temperature Sensor Calibration-High Temperature (85 for Industrial, 105 for Extended)
+#define TYPICAL_ADC_30C 1950 // typical readings of a part, used when the TLV values cannot be right
+#define TYPICAL_ADC_85C 2335
+
+static short tempLut[TEMP_LUT_LEN]; // temperature in tenths of a degree at ADC = idx << TEMP_LUT_SHIFT
+
+void tempLutInit() {
+    tempLutBuild(CALADC_15V_30C, CALADC_15V_85C);
+}
+
+void tempLutBuild(unsigned short adc30, unsigned short adc85) { // table from the ADC readings at 30C and 85C
+    unsigned char idx;
+    long cal30, calSpan, scaled;
+
+    if(adc30 >= 4096 || adc85 >= 4096 || adc85 <= adc30) { // blank (0xFFFF) or corrupt TLV, both points typical
+        adc30 = TYPICAL_ADC_30C;
+        adc85 = TYPICAL_ADC_85C;
+    }
+    cal30 = adc30;
+    calSpan = (long)adc85 - cal30;
+
+    for(idx = 0; idx < TEMP_LUT_LEN; idx++) { // same formula as before, in tenths of a degree, only done at boot
+        scaled = (((long)idx << TEMP_LUT_SHIFT) - cal30) * (85-30) * 10;
+        scaled += (scaled < 0) ? -(calSpan / 2) : calSpan / 2; // round to nearest instead of towards zero
+        tempLut[idx] = (short)(scaled / calSpan + 30 * 10);
+    }
+}
+
+short tempFromAdc(unsigned short adc) {
+    unsigned short idx = adc >> TEMP_LUT_SHIFT;
+    unsigned short frac = adc & ((1 << TEMP_LUT_SHIFT) - 1);
+
+    if(idx >= TEMP_LUT_LEN - 1) { // 4096 and above is out of range for a 12-bit result
+        return tempLut[TEMP_LUT_LEN - 1];
+    }
+
+    // linear interpolation between the two table entries around adc
+    return tempLut[idx] + (short)(((long)(tempLut[idx + 1] - tempLut[idx]) * frac + (1 << (TEMP_LUT_SHIFT - 1))) >> TEMP_LUT_SHIFT);
+}
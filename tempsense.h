@@ -0,0 +1,22 @@
+/*
+ tempsense.h
+ Integer conversion of the internal temperature sensor (A12, 1.5 V reference) to tenths of a degree celsius.
+ tempLutInit() builds a small lookup table from the 30C/85C calibration values in the TLV once at boot, and
+ tempFromAdc() interpolates between table entries with a multiply and a shift, so no float runtime or
+ division is needed per sample. tempLutBuild() takes the calibration values as arguments and touches no
+ registers, like format.c and the BME280 compensation in BME280.c, so host/test/test_sensor.c checks it
+ off-target against the TLV formula. Readings outside the 12-bit range or a 85C reading not above the 30C one
+ (a blank TLV reads 0xFFFF) are replaced by typical values, so the table always stays monotonic and in range.
+ */
+
+#ifndef TEMPSENSE_H_
+#define TEMPSENSE_H_
+
+#define TEMP_LUT_SHIFT 7 // ADC counts between table entries is 2^TEMP_LUT_SHIFT
+#define TEMP_LUT_LEN ((4096 >> TEMP_LUT_SHIFT) + 1) // entries covering the full 12-bit range
+
+void tempLutInit();
+void tempLutBuild(unsigned short adc30, unsigned short adc85);
+short tempFromAdc(unsigned short adc);
+
+#endif /* TEMPSENSE_H_ */
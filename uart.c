@@ -0,0 +1,137 @@
+#include "clock.h"
+#include "hal.h"
+#include "prof.h"
+#include "scheduler.h"
+#include "uart.h"
+
+// below 4 SMCLK cycles per bit, a bit edge can be a third of a bit off however the modulation is set
+#if CLOCK_SMCLK_HZ < 4 * UART_BAUD
+#error "SMCLK is too slow for UART_BAUD, CLOCK_FAST_HZ (clock.h) has to be 4 MHz or more"
+#endif
+
+static char uartTxRing[UART_TX_RING_LEN];
+static volatile unsigned char uartTxHead = 0; // next free slot, written by main()
+static volatile unsigned char uartTxTail = 0; // next byte to send, written by the interrupt or by main() while idle
+static volatile unsigned char uartTxIdle = 1; // transmit interrupt off and UCTXIFG used up, main() sends the first byte
+
+static unsigned char uartRxRing[UART_RX_RING_LEN];
+static volatile unsigned char uartRxHead = 0; // next free slot, written by the interrupt
+static volatile unsigned char uartRxTail = 0; // next byte to read, written by main()
+
+// UCBRSx for the fractional part of clock/baud, in 1/10000; user's guide table "UCBRSx settings"
+static const struct {
+    unsigned short frac; // lowest fraction the setting is used for
+    unsigned char brs;
+} uartBrsTable[] = {
+    {0, 0x00}, {529, 0x01}, {715, 0x02}, {835, 0x04}, {1001, 0x08}, {1252, 0x10}, {1430, 0x20}, {1670, 0x11},
+    {2147, 0x21}, {2224, 0x22}, {2503, 0x44}, {3000, 0x25}, {3335, 0x49}, {3575, 0x4A}, {3753, 0x52},
+    {4003, 0x92}, {4286, 0x53}, {4378, 0x55}, {5002, 0xAA}, {5715, 0x6B}, {6003, 0xAD}, {6254, 0xB5},
+    {6432, 0xB6}, {6667, 0xD6}, {7001, 0xB7}, {7147, 0xBB}, {7503, 0xDD}, {7861, 0xED}, {8004, 0xEE},
+    {8333, 0xBF}, {8464, 0xDF}, {8572, 0xEF}, {8751, 0xF7}, {9004, 0xFB}, {9170, 0xFD}, {9288, 0xFE}
+};
+
+void uartDividers(unsigned long clockHz, unsigned long baud, unsigned short *brw, unsigned short *mctlw) {
+    unsigned long n = clockHz / baud; // integer part of the division factor
+    unsigned short frac = (unsigned short)((clockHz % baud) * 10000 / baud);
+    unsigned char idx;
+    unsigned char brs = 0;
+
+    for(idx = 0; idx < sizeof uartBrsTable / sizeof uartBrsTable[0] && uartBrsTable[idx].frac <= frac; idx++) {
+        brs = uartBrsTable[idx].brs;
+    }
+    if(n >= 16) { // oversampling, UCBRFx takes the fraction of n / 16
+        *brw = (unsigned short)(n >> 4);
+        *mctlw = ((unsigned short)brs << 8) | ((unsigned short)(n & 0x0F) << 4) | UCOS16;
+    } else {
+        *brw = (unsigned short)n;
+        *mctlw = (unsigned short)brs << 8;
+    }
+}
+
+void uartInit() {
+    unsigned short brw;
+    unsigned short mctlw;
+
+    uartDividers(CLOCK_SMCLK_HZ, UART_BAUD, &brw, &mctlw); // 8 and 0xD600 at 1 MHz
+    halUartInit(brw, mctlw); // pins, eUSCI_A1 on SMCLK, RX interrupt
+
+}
+
+unsigned char uartTxFree() {
+    return (UART_TX_RING_LEN - 1) - ((uartTxHead - uartTxTail) & (UART_TX_RING_LEN - 1));
+}
+
+unsigned char uartWrite(const char *data, unsigned char len) { // queue len bytes, all or nothing
+    unsigned char head = uartTxHead;
+    unsigned char idx;
+
+    if(len > uartTxFree()) {
+        return 0; // caller decides whether to drop or retry
+    }
+    for(idx = 0; idx < len; idx++) {
+        uartTxRing[head] = data[idx];
+        head = (head + 1) & (UART_TX_RING_LEN - 1);
+    }
+    uartTxHead = head; // publish the bytes to the interrupt in one write
+
+    schedSmclkUsers |= SMCLK_UART; // UART clock has to keep running until the ring drains
+    halUartTxDoneIrq(0);
+    if(uartTxIdle) { // reading UCA1IV cleared UCTXIFG when the ring ran dry, nothing would raise it again
+        uartTxIdle = 0;
+        halUartPut(uartTxRing[uartTxTail]); // the buffer is empty, the interrupt takes over from the next byte
+        uartTxTail = (uartTxTail + 1) & (UART_TX_RING_LEN - 1);
+    }
+    halUartTxIrq(1);
+    return len;
+}
+
+unsigned char uartRead(unsigned char *byte) { // 1 if a received byte was returned
+    unsigned char tail = uartRxTail;
+
+    if(tail == uartRxHead) {
+        return 0;
+    }
+    *byte = uartRxRing[tail];
+    uartRxTail = (tail + 1) & (UART_RX_RING_LEN - 1);
+    return 1;
+}
+
+HAL_ISR(EUSCI_A1_VECTOR, uartIsr) {
+    unsigned char next;
+
+    PROF_START(PROF_ISR_UART);
+    switch(halUartIv()) {
+        case USCI_UART_UCRXIFG:
+            next = (uartRxHead + 1) & (UART_RX_RING_LEN - 1);
+            if(next != uartRxTail) { // drop the byte if main() has fallen behind
+                uartRxRing[uartRxHead] = halUartGet();
+                uartRxHead = next;
+            } else {
+                (void)halUartGet(); // reading clears the flag
+            }
+            schedEvents |= EVENT_UART_RX;
+            HAL_WAKE_ON_EXIT();
+            break;
+        case USCI_UART_UCTXIFG:
+            if(uartTxTail != uartTxHead) {
+                halUartPut(uartTxRing[uartTxTail]); // send next byte
+                uartTxTail = (uartTxTail + 1) & (UART_TX_RING_LEN - 1);
+            } else { // ring empty, wait for the last byte to leave the shift register
+                halUartTxIrq(0);
+                uartTxIdle = 1;
+                halUartTxDoneIrq(1);
+            }
+            break;
+        case USCI_UART_UCTXCPTIFG:
+            halUartTxDoneIrq(0);
+            if(uartTxTail == uartTxHead) { // nothing queued since, SMCLK can stop now
+                schedSmclkUsers &= ~SMCLK_UART;
+                schedEvents |= EVENT_UART_TX;
+                HAL_WAKE_ON_EXIT();
+            }
+            break;
+        default:
+            break;
+    }
+    PROF_END(PROF_ISR_UART);
+}
@@ -0,0 +1,26 @@
+/*
+ uart.h
+ Interrupt-driven eUSCI_A1 UART (P4.2, P4.3) to the ESP-01 at 115200 baud. Transmit and receive each use a
+ lock-free single-producer/single-consumer ring: main() only moves the TX head and the RX tail, the
+ EUSCI_A1_VECTOR interrupt only moves the TX tail and the RX head, and the 8-bit indexes are written in one
+ instruction so neither side needs to disable interrupts. The one exception is the first byte of a burst:
+ reading UCA1IV clears UCTXIFG, so once the ring has drained and the transmit interrupt is off, uartWrite()
+ puts that byte in the buffer itself, while the interrupt cannot touch the TX tail. EVENT_UART_TX is posted
+ when the TX ring has drained and EVENT_UART_RX when a byte arrives. The baud rate dividers are worked out
+ from CLOCK_SMCLK_HZ (clock.h) at init, the way the user's guide baud rate table is calculated.
+ */
+
+#ifndef UART_H_
+#define UART_H_
+
+#define UART_BAUD 115200UL
+#define UART_TX_RING_LEN 128 // must be a power of two
+#define UART_RX_RING_LEN 16 // must be a power of two
+
+void uartInit();
+void uartDividers(unsigned long clockHz, unsigned long baud, unsigned short *brw, unsigned short *mctlw);
+unsigned char uartTxFree();
+unsigned char uartWrite(const char *data, unsigned char len);
+unsigned char uartRead(unsigned char *byte);
+
+#endif /* UART_H_ */
@@ -0,0 +1,147 @@
+#include "datalog.h"
+#include "hal.h"
+#include "servo.h"
+#include "zone.h"
+
+const ZoneConfig zoneConfig[ZONE_COUNT] = {
+    {ADCSREF_0 | ADCINCH_1, 3}, // A1, Vref=AVCC; TB3.4 on P6.3
+#if ZONE_COUNT > 1
+    {ADCSREF_0 | ADCINCH_2, 0}, // P1.2; TB3.1 on P6.0
+#endif
+#if ZONE_COUNT > 2
+    {ADCSREF_0 | ADCINCH_3, 1}, // P1.3; TB3.2 on P6.1
+#endif
+#if ZONE_COUNT > 3
+    {ADCSREF_0 | ADCINCH_4, 2}, // P1.4; TB3.3 on P6.2
+#endif
+#if ZONE_COUNT > 4
+    {ADCSREF_0 | ADCINCH_5, 4}, // P1.5; TB3.5 on P6.4
+#endif
+#if ZONE_COUNT > 5
+    {ADCSREF_0 | ADCINCH_6, 5}, // P1.6; TB3.6 on P6.5
+#endif
+#if ZONE_COUNT > 6
+    {ADCSREF_0 | ADCINCH_7, 6}, // P1.7; TB2.1 on P5.0
+#endif
+#if ZONE_COUNT > 7
+    {ADCSREF_0 | ADCINCH_10, 7}, // P5.2; TB2.2 on P5.1
+#endif
+};
+
+Zone zones[ZONE_COUNT];
+
+#pragma PERSISTENT(zoneSavedThres)
+unsigned short zoneSavedThres[ZONE_MAX] = {1200, 1200, 1200, 1200, 1200, 1200, 1200, 1200}; // kept in FRAM by a long press of the P2.3 button
+
+typedef struct {
+    char valveOpen; // hatch was commanded open
+    short gain; // learned soil response, 0 until the dose controller has run
+    unsigned short lag;
+} ZoneCheckpoint;
+
+// State a reset must not lose, written as it changes
+#pragma PERSISTENT(zoneCheckpoint)
+ZoneCheckpoint zoneCheckpoint[ZONE_MAX] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+                                           {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+
+static void zoneValve(unsigned char zone, char open) {
+    if(open) { // rotate servo CW to open the hatch
+        servoMoveTo(zoneConfig[zone].servo, SERVO_OPEN_POS, &servoHatchProfile);
+    } else { // rotate servo CCW to close it
+        servoMoveTo(zoneConfig[zone].servo, SERVO_CLOSED_POS, &servoHatchProfile);
+    }
+    zones[zone].valveOpen = open; // the servo keeps moving in the background
+    zoneCheckpoint[zone].valveOpen = open;
+    logValve(zone, open);
+}
+
+void zoneInit() { // after logInit(), a hatch left open by a reset is closed and logged
+    unsigned char zone;
+    unsigned char channels = 0;
+
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        zones[zone].thres = zoneSavedThres[zone];
+        zones[zone].setThres = 0;
+        zones[zone].valveOpen = 0;
+        filterInit(&zones[zone].filter);
+        doseInit(&zones[zone].dose);
+        if(zoneCheckpoint[zone].gain != 0) { // keep what was learned before the reset
+            zones[zone].dose.gain = zoneCheckpoint[zone].gain;
+            zones[zone].dose.lag = zoneCheckpoint[zone].lag;
+        }
+        channels |= 1 << zoneConfig[zone].servo;
+    }
+    servoInit(channels);
+
+    // the pour that was going on is lost, so close the hatch from where it was rather than snapping it shut
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        if(zoneCheckpoint[zone].valveOpen) {
+            servoSetPosition(zoneConfig[zone].servo, SERVO_OPEN_POS);
+            zoneValve(zone, 0);
+        }
+    }
+}
+
+void zoneUpdate(unsigned char zone, unsigned short reading) { // once per control cycle with the averaged probe reading
+    Zone *z = &zones[zone];
+    char dry;
+
+    z->moisture = filterUpdate(&z->filter, &moistureFilterConfig, reading); // spike rejection and smoothing
+
+    if(z->setThres) {
+        z->thres = z->moisture;
+        z->setThres = 0;
+    }
+
+    // water in fixed pulses and let the soil settle, the controller says when the hatch should be open
+    dry = filterDry(&z->filter, &moistureFilterConfig, z->moisture, z->thres); // lower values is more moist, so a reading past the band above threshold is too dry
+#ifdef ZONE_BANG_BANG // the open-while-dry logic dose.h replaced, only built for watersim to compare against
+    if(dry != z->valveOpen) {
+        zoneValve(zone, dry);
+    }
+#else
+    if(doseUpdate(&z->dose, &doseConfig, z->moisture, z->thres, dry,
+                  z->valveOpen && !servoBusy(zoneConfig[zone].servo)) != z->valveOpen) {
+        zoneValve(zone, !z->valveOpen); // open or close
+    }
+#endif
+    if(zoneCheckpoint[zone].gain != z->dose.gain || zoneCheckpoint[zone].lag != z->dose.lag) { // only after a settled pulse
+        zoneCheckpoint[zone].gain = z->dose.gain;
+        zoneCheckpoint[zone].lag = z->dose.lag;
+    }
+}
+
+unsigned char zoneOpenCount() { // hatches open, for the reservoir estimate
+    unsigned char zone;
+    unsigned char open = 0;
+
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        open += zones[zone].valveOpen;
+    }
+    return open;
+}
+
+void zoneThresNext() { // each zone's next reading becomes its threshold
+    unsigned char zone;
+
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        zones[zone].setThres = 1;
+    }
+}
+
+void zoneThresSave() { // keep the current thresholds across resets
+    unsigned char zone;
+
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        zoneSavedThres[zone] = zones[zone].thres;
+    }
+}
+
+void zoneRelearn() { // pots or soil changed, learn their response to water again
+    unsigned char zone;
+
+    for(zone = 0; zone < ZONE_COUNT; zone++) {
+        doseInit(&zones[zone].dose);
+        zoneCheckpoint[zone].gain = 0;
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ zone.h
+ Watering zones, one pot each, with their own moisture probe, hatch servo, threshold, filter, dose controller
+ and valve state. ZONE_COUNT is set at build time, 1 to ZONE_MAX, and zoneConfig in zone.c says which ADC
+ channel and servo channel each zone uses. All probes are converted in the same ADC sequence (adc.h) and all
+ hatches are moved by the servo engine, which limits how many move at once (servo.h). Each logged sample holds
+ the moisture of every zone (datalog.h).
+
+ Default wiring, zone n:
+    probe  A1 - A7 (P1.1 - P1.7), then A10 (P5.2); A8 and A9 share P5.0 and P5.1 with servo channels 6 and 7
+    servo  channel 3 (P6.3) for zone 0, then channels 0, 1, 2, 4, 5, 6, 7
+
+ The threshold button acts on every zone: a short press takes each zone's next reading as its threshold, a
+ long press saves all thresholds in FRAM and a double press makes every zone learn its soil response again.
+ */
+
+#ifndef ZONE_H_
+#define ZONE_H_
+
+#include "dose.h"
+#include "filter.h"
+
+#define ZONE_MAX 8
+#ifndef ZONE_COUNT // -DZONE_COUNT=n builds for more zones, the host build also builds ZONE_MAX
+#define ZONE_COUNT 1 // zones wired to this controller, 1 to ZONE_MAX
+#endif
+#if ZONE_COUNT < 1 || ZONE_COUNT > ZONE_MAX
+#error "ZONE_COUNT must be 1 to ZONE_MAX"
+#endif
+
+typedef struct {
+    unsigned short adcChannel; // ADCMCTL0 bits of the probe, reference and input channel
+    unsigned char servo; // servo channel of the hatch
+} ZoneConfig;
+
+typedef struct {
+    unsigned short moisture; // last filtered reading
+    unsigned short thres; // moisture threshold
+    char setThres; // take the next reading as the threshold
+    char valveOpen; // 0 for closed, 1 for opened
+    FilterState filter;
+    DoseState dose;
+} Zone;
+
+extern const ZoneConfig zoneConfig[ZONE_COUNT];
+extern Zone zones[ZONE_COUNT];
+
+void zoneInit();
+void zoneUpdate(unsigned char zone, unsigned short reading);
+unsigned char zoneOpenCount();
+void zoneThresNext();
+void zoneThresSave();
+void zoneRelearn();
+
+#endif /* ZONE_H_ */